@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""Append-only benchmark history and regression check.
+
+  record   append one record for the latest run_bench.sh outputs
+  compare  test the newest record against a window of earlier ones
+  export   write viz/bench_history.js for viz/history.html
+
+Records are JSON lines in benchmarks/history/results.jsonl; nothing here
+needs network access.
+"""
+import argparse
+import json
+import math
+import platform
+import re
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parents[1]
+STORE = ROOT / "benchmarks" / "history" / "results.jsonl"
+VIZ_OUT = ROOT / "viz" / "bench_history.js"
+SOURCES = (
+    ("triple_deref", ROOT / "viz" / "bench_data.js"),
+    ("triple_deref_ssa", ROOT / "viz" / "bench_data_ssa.js"),
+)
+MATRIX = ROOT / "viz" / "bench_matrix.js"
+SOURCE_DIRS = ["runtime", "programs", "checker", "driver", "llvm_pass", "CMakeLists.txt"]
+
+
+def load_js(path: Path) -> dict:
+    text = path.read_text(encoding="utf-8").strip()
+    text = re.sub(r"^\s*window\.[A-Z_]+\s*=\s*", "", text)
+    if text.endswith(";"):
+        text = text[:-1]
+    return json.loads(text)
+
+
+def run(cmd):
+    try:
+        return subprocess.run(cmd, cwd=ROOT, capture_output=True, text=True, check=False)
+    except OSError:
+        return None
+
+
+def git_info() -> dict:
+    head = run(["git", "rev-parse", "HEAD"])
+    # run outputs under viz/ and out/ are rewritten by every run, so only
+    # source changes count as dirty
+    diff = run(["git", "diff", "--quiet", "HEAD", "--"] + SOURCE_DIRS)
+    return {
+        "commit": head.stdout.strip() if head and head.returncode == 0 else None,
+        "dirty": bool(diff and diff.returncode == 1),
+    }
+
+
+def cpu_model() -> str:
+    cpuinfo = Path("/proc/cpuinfo")
+    if cpuinfo.exists():
+        for line in cpuinfo.read_text(encoding="utf-8", errors="replace").splitlines():
+            if line.startswith("model name"):
+                return line.split(":", 1)[1].strip()
+    sysctl = run(["sysctl", "-n", "machdep.cpu.brand_string"])
+    if sysctl and sysctl.returncode == 0 and sysctl.stdout.strip():
+        return sysctl.stdout.strip()
+    return platform.processor() or platform.machine()
+
+
+def compiler_version(cc: str) -> str:
+    out = run([cc, "--version"])
+    if not out or out.returncode != 0:
+        return cc
+    return out.stdout.splitlines()[0].strip() if out.stdout else cc
+
+
+def summarize(samples):
+    xs = sorted(samples)
+    n = len(xs)
+    if n == 0:
+        return {}
+    med = xs[n // 2] if n % 2 else (xs[n // 2 - 1] + xs[n // 2]) / 2
+    dev = sorted(abs(x - med) for x in xs)
+    mad = dev[n // 2] if n % 2 else (dev[n // 2 - 1] + dev[n // 2]) / 2
+    return {"n": n, "median": med, "mad": mad, "min": xs[0], "max": xs[-1]}
+
+
+def collect_benchmarks() -> tuple:
+    benches = {}
+    config = {}
+    for name, path in SOURCES:
+        if not path.exists():
+            continue
+        data = load_js(path)
+        config[name] = data.get("config", {})
+        for side in ("baseline", "optimized"):
+            samples = data.get(side, {}).get("ns_per_iter", []) or []
+            if samples:
+                benches[f"{name}/{side}"] = {"samples": samples, **summarize(samples)}
+    if MATRIX.exists():
+        for row in load_js(MATRIX).get("rows", []):
+            samples = row.get("ns_per_iter") or []
+            key = f"matrix/{row.get('kernel')}/{row.get('form')}"
+            if samples:
+                benches[key] = {"samples": samples, **summarize(samples)}
+    return benches, config
+
+
+def read_store(path: Path) -> list:
+    if not path.exists():
+        return []
+    records = []
+    with path.open(encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if line:
+                records.append(json.loads(line))
+    return records
+
+
+def cmd_record(args) -> int:
+    benches, config = collect_benchmarks()
+    if not benches:
+        print("no benchmark data in viz/, run ./run_bench.sh first", file=sys.stderr)
+        return 1
+    record = {
+        "timestamp": time.strftime("%Y-%m-%dT%H:%M:%S%z"),
+        "git": git_info(),
+        "compiler": compiler_version(args.cc),
+        "cpu": cpu_model(),
+        "host": platform.node(),
+        "config": config,
+        "note": args.note,
+        "benchmarks": benches,
+    }
+    args.store.parent.mkdir(parents=True, exist_ok=True)
+    with args.store.open("a", encoding="utf-8") as f:
+        f.write(json.dumps(record, separators=(",", ":")) + "\n")
+    print(f"recorded {len(benches)} benchmarks to {args.store}")
+    return 0
+
+
+def mann_whitney_greater(new, base) -> float:
+    """One-sided p-value that `new` tends to be larger than `base`
+    (normal approximation with tie correction)."""
+    n1, n2 = len(new), len(base)
+    if n1 == 0 or n2 == 0:
+        return 1.0
+    pooled = sorted([(x, 0) for x in new] + [(x, 1) for x in base])
+    ranks = [0.0] * len(pooled)
+    ties = 0.0
+    i = 0
+    while i < len(pooled):
+        j = i
+        while j + 1 < len(pooled) and pooled[j + 1][0] == pooled[i][0]:
+            j += 1
+        rank = (i + j) / 2 + 1
+        for k in range(i, j + 1):
+            ranks[k] = rank
+        t = j - i + 1
+        ties += t ** 3 - t
+        i = j + 1
+    r1 = sum(r for r, (_, g) in zip(ranks, pooled) if g == 0)
+    u1 = r1 - n1 * (n1 + 1) / 2
+    n = n1 + n2
+    var = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)))
+    if var <= 0:
+        return 1.0
+    z = (u1 - n1 * n2 / 2 - 0.5) / math.sqrt(var)
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+
+def compare_record(record, window, threshold, alpha) -> list:
+    results = []
+    for name, bench in sorted(record.get("benchmarks", {}).items()):
+        base = []
+        for old in window:
+            base.extend(old.get("benchmarks", {}).get(name, {}).get("samples", []))
+        if not base or not bench.get("samples"):
+            continue
+        base_med = summarize(base)["median"]
+        new_med = bench["median"]
+        if base_med <= 0:
+            continue
+        change = (new_med - base_med) / base_med
+        p_slower = mann_whitney_greater(bench["samples"], base)
+        p_faster = mann_whitney_greater(base, bench["samples"])
+        status = "ok"
+        if change > threshold and p_slower < alpha:
+            status = "regression"
+        elif change < -threshold and p_faster < alpha:
+            status = "improvement"
+        results.append({
+            "name": name,
+            "base_median": base_med,
+            "median": new_med,
+            "change": change,
+            "p": p_slower if change >= 0 else p_faster,
+            "status": status,
+        })
+    return results
+
+
+def comparable(a, b) -> bool:
+    # only compare runs taken on the same kind of machine and compiler
+    return a.get("cpu") == b.get("cpu") and a.get("compiler") == b.get("compiler")
+
+
+def window_for(records, index, size) -> list:
+    target = records[index]
+    earlier = [r for r in records[:index] if comparable(r, target)]
+    return earlier[-size:]
+
+
+def cmd_compare(args) -> int:
+    records = read_store(args.store)
+    if len(records) < 2:
+        print("need at least two records to compare")
+        return 0
+    window = window_for(records, len(records) - 1, args.window)
+    if not window:
+        print("no earlier record from the same cpu/compiler")
+        return 0
+    results = compare_record(records[-1], window, args.threshold, args.alpha)
+    regressions = 0
+    for r in results:
+        flag = {"regression": "REGRESSION", "improvement": "improved"}.get(r["status"], "")
+        print(f"{r['name']:<36} {r['base_median']:10.3f} -> {r['median']:10.3f} ns/iter "
+              f"{r['change'] * 100:+6.2f}% p={r['p']:.4f} {flag}")
+        regressions += r["status"] == "regression"
+    print(f"{regressions} regression(s) beyond {args.threshold * 100:.1f}% at alpha={args.alpha} "
+          f"against the last {len(window)} run(s)")
+    return 1 if regressions else 0
+
+
+def cmd_export(args) -> int:
+    records = read_store(args.store)
+    series = {}
+    runs = []
+    for i, record in enumerate(records):
+        window = window_for(records, i, args.window)
+        flags = {r["name"]: r for r in compare_record(record, window, args.threshold, args.alpha)} if window else {}
+        runs.append({
+            "timestamp": record.get("timestamp"),
+            "commit": (record.get("git") or {}).get("commit"),
+            "dirty": (record.get("git") or {}).get("dirty"),
+            "compiler": record.get("compiler"),
+            "cpu": record.get("cpu"),
+        })
+        for name, bench in record.get("benchmarks", {}).items():
+            series.setdefault(name, []).append({
+                "run": i,
+                "median": bench.get("median"),
+                "mad": bench.get("mad"),
+                "status": flags.get(name, {}).get("status", "ok"),
+                "change": flags.get(name, {}).get("change"),
+            })
+    data = {
+        "threshold": args.threshold,
+        "alpha": args.alpha,
+        "window": args.window,
+        "runs": runs,
+        "series": series,
+    }
+    args.out.parent.mkdir(parents=True, exist_ok=True)
+    with args.out.open("w", encoding="utf-8") as f:
+        f.write("window.BENCH_HISTORY = ")
+        json.dump(data, f, indent=1)
+        f.write(";\n")
+    print(f"wrote {len(series)} series over {len(runs)} runs to {args.out}")
+    return 0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--store", type=Path, default=STORE)
+    parser.add_argument("--window", type=int, default=5, help="earlier runs pooled as the baseline")
+    parser.add_argument("--threshold", type=float, default=0.03, help="relative median change to flag")
+    parser.add_argument("--alpha", type=float, default=0.01, help="significance level of the rank test")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    rec = sub.add_parser("record")
+    rec.add_argument("--cc", default="clang", help="compiler whose --version is stored")
+    rec.add_argument("--note", default="")
+    sub.add_parser("compare")
+    exp = sub.add_parser("export")
+    exp.add_argument("--out", type=Path, default=VIZ_OUT)
+
+    args = parser.parse_args()
+    return {"record": cmd_record, "compare": cmd_compare, "export": cmd_export}[args.cmd](args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -7,9 +7,11 @@ from pathlib import Path
 ROOT = Path(__file__).resolve().parents[1]
 BASE_PATH = ROOT / "viz" / "bench_data.js"
 SSA_PATH = ROOT / "viz" / "bench_data_ssa.js"
+MATRIX_PATH = ROOT / "viz" / "bench_matrix.js"
 OUT_DIR = ROOT / "out"
 SUMMARY_CSV = OUT_DIR / "bench_results_summary.csv"
 RUNS_CSV = OUT_DIR / "bench_results_runs.csv"
+MATRIX_CSV = OUT_DIR / "bench_matrix.csv"
 
 
 def load_js(path: Path) -> dict:
@@ -93,13 +95,62 @@ def write_runs(rows):
         writer.writerows(rows)
 
 
+def write_matrix(data):
+    fields = [
+        "kernel",
+        "form",
+        "outcome",
+        "heap_shape",
+        "heap_objs",
+        "heap_seed",
+        "iters_per_sample",
+        "samples",
+        "median_ns_per_iter",
+        "mad_ns_per_iter",
+        "p5_ns_per_iter",
+        "p95_ns_per_iter",
+        "mean_ns_per_iter",
+        "ir_calls",
+    ]
+    calls = data.get("ir_call_count", {})
+    rows = []
+    for row in data.get("rows", []):
+        stats = row.get("stats_ns_per_iter", {})
+        heap = row.get("heap", {})
+        rows.append(
+            {
+                "kernel": row.get("kernel"),
+                "form": row.get("form"),
+                "outcome": row.get("outcome"),
+                "heap_shape": heap.get("shape"),
+                "heap_objs": heap.get("objs"),
+                "heap_seed": heap.get("seed"),
+                "iters_per_sample": row.get("iters_per_sample"),
+                "samples": get_stat(stats, "n"),
+                "median_ns_per_iter": get_stat(stats, "median"),
+                "mad_ns_per_iter": get_stat(stats, "mad"),
+                "p5_ns_per_iter": get_stat(stats, "p5"),
+                "p95_ns_per_iter": get_stat(stats, "p95"),
+                "mean_ns_per_iter": get_stat(stats, "mean"),
+                "ir_calls": calls.get(row.get("kernel"), {}).get(row.get("form")),
+            }
+        )
+    with MATRIX_CSV.open("w", newline="", encoding="utf-8") as f:
+        writer = csv.DictWriter(f, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(rows)
+
+
 def main():
     variants = load_variants()
-    if not variants:
+    if not variants and not MATRIX_PATH.exists():
         raise SystemExit("No benchmark data found in viz/bench_data*.js")
 
     OUT_DIR.mkdir(parents=True, exist_ok=True)
 
+    if MATRIX_PATH.exists():
+        write_matrix(load_js(MATRIX_PATH))
+
     summary_rows = []
     run_rows = []
 
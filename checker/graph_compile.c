@@ -0,0 +1,261 @@
+#include "graph_compile.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    CG_CONST = 0,
+    CG_INPUT_P,
+    CG_INPUT_Q,
+    CG_IS_NONNULL,
+    CG_GUARD_PTR,
+    CG_GUARD_NONNULL,
+    CG_GUARD_EQ,
+    CG_LOAD_PTR,
+    CG_LOAD_INT,
+    CG_GETFIELD,
+    CG_GETFIELD_INT,
+    CG_SELECT,
+    CG_ADD,
+    CG_TRUTHY,
+    CG_LOOP_CHAIN
+} CgOp;
+
+typedef struct {
+    CgOp op;
+    int a;     /* operand slots */
+    int b;
+    int c;
+    int field;
+    int count; /* CG_LOOP_CHAIN */
+    Eval k;    /* CG_CONST */
+} CgInsn;
+
+struct CompiledGraph {
+    int num_insns;
+    CgInsn* insns; /* result of insns[i] lands in slot i */
+    int output;    /* slot holding the graph output */
+};
+
+typedef struct {
+    const Graph* graph;
+    CompiledGraph* cg;
+    int* slot_of;          /* node id -> slot, -1 while unassigned */
+    unsigned char* state;  /* 0 = new, 1 = on stack, 2 = emitted */
+    int invalid_slot;      /* shared ERR_INVALID constant, -1 until needed */
+} Compiler;
+
+static int emit(Compiler* c, CgInsn insn) {
+    c->cg->insns[c->cg->num_insns] = insn;
+    return c->cg->num_insns++;
+}
+
+static int emit_const(Compiler* c, Eval k) {
+    CgInsn insn;
+    memset(&insn, 0, sizeof(insn));
+    insn.op = CG_CONST;
+    insn.k = k;
+    return emit(c, insn);
+}
+
+static int invalid_slot(Compiler* c) {
+    if (c->invalid_slot < 0) {
+        c->invalid_slot = emit_const(c, (Eval){0, ERR_INVALID, 0});
+    }
+    return c->invalid_slot;
+}
+
+/* Post-order walk: operands are emitted before the node that reads them.
+   Returns the node's slot, or -2 when a cycle is found. */
+static int compile_node(Compiler* c, int id) {
+    GraphNodeInfo info;
+    CgInsn insn;
+    int slot;
+
+    if (!graph_node_info(c->graph, id, &info)) {
+        return invalid_slot(c);
+    }
+    if (c->state[id] == 2) {
+        return c->slot_of[id];
+    }
+    if (c->state[id] == 1) {
+        return -2;
+    }
+    c->state[id] = 1;
+    memset(&insn, 0, sizeof(insn));
+    insn.field = info.field;
+    insn.count = info.value;
+
+    if (strcmp(info.kind, "input") == 0) {
+        if (strcmp(info.name, "p") == 0) {
+            insn.op = CG_INPUT_P;
+        } else if (strcmp(info.name, "q") == 0) {
+            insn.op = CG_INPUT_Q;
+        } else {
+            insn.op = CG_CONST;
+            insn.k = ck_input(info.name, VAL_NULL);
+        }
+    } else if (strcmp(info.kind, "const_int") == 0) {
+        insn.op = CG_CONST;
+        insn.k = ck_const_int(info.value);
+    } else if (strcmp(info.kind, "const_null") == 0) {
+        insn.op = CG_CONST;
+        insn.k = ck_const_null();
+    } else {
+        static const struct { const char* kind; CgOp op; int arity; } ops[] = {
+            {"is_nonnull", CG_IS_NONNULL, 1},
+            {"guard_ptr", CG_GUARD_PTR, 1},
+            {"guard_nonnull", CG_GUARD_NONNULL, 1},
+            {"guard_eq", CG_GUARD_EQ, 2},
+            {"load_ptr", CG_LOAD_PTR, 1},
+            {"load_int", CG_LOAD_INT, 1},
+            {"getfield", CG_GETFIELD, 1},
+            {"getfield_int", CG_GETFIELD_INT, 1},
+            {"select", CG_SELECT, 3},
+            {"add", CG_ADD, 2},
+            {"truthy", CG_TRUTHY, 1},
+            {"loop_chain", CG_LOOP_CHAIN, 1},
+        };
+        size_t i;
+        int found = 0;
+        for (i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+            if (strcmp(info.kind, ops[i].kind) == 0) {
+                found = 1;
+                insn.op = ops[i].op;
+                if (ops[i].arity == 3) {
+                    insn.a = compile_node(c, info.cond);
+                    insn.b = compile_node(c, info.then_id);
+                    insn.c = compile_node(c, info.else_id);
+                } else {
+                    insn.a = compile_node(c, info.x);
+                    insn.b = ops[i].arity == 2 ? compile_node(c, info.y) : 0;
+                }
+                break;
+            }
+        }
+        if (!found) {
+            insn.op = CG_CONST;
+            insn.k = (Eval){0, ERR_INVALID, 0};
+        }
+        if (insn.a == -2 || insn.b == -2 || insn.c == -2) {
+            return -2;
+        }
+    }
+
+    slot = emit(c, insn);
+    c->slot_of[id] = slot;
+    c->state[id] = 2;
+    return slot;
+}
+
+CompiledGraph* graph_compile(const Graph* graph) {
+    Compiler c;
+    int n = graph_num_nodes(graph);
+
+    if (!graph || graph_output(graph) <= 0) {
+        return NULL;
+    }
+    memset(&c, 0, sizeof(c));
+    c.graph = graph;
+    c.invalid_slot = -1;
+    c.cg = (CompiledGraph*)calloc(1, sizeof(CompiledGraph));
+    if (c.cg) {
+        /* every node plus the shared invalid constant */
+        c.cg->insns = (CgInsn*)calloc((size_t)n + 1, sizeof(CgInsn));
+    }
+    c.slot_of = (int*)malloc(((size_t)n + 1) * sizeof(int));
+    c.state = (unsigned char*)calloc((size_t)n + 1, 1);
+    if (!c.cg || !c.cg->insns || !c.slot_of || !c.state) {
+        compiled_graph_free(c.cg);
+        free(c.slot_of);
+        free(c.state);
+        return NULL;
+    }
+
+    c.cg->output = compile_node(&c, graph_output(graph));
+    free(c.slot_of);
+    free(c.state);
+    if (c.cg->output < 0) {
+        compiled_graph_free(c.cg);
+        return NULL;
+    }
+    return c.cg;
+}
+
+void compiled_graph_free(CompiledGraph* cg) {
+    if (!cg) {
+        return;
+    }
+    free(cg->insns);
+    free(cg);
+}
+
+int compiled_graph_num_slots(const CompiledGraph* cg) {
+    return cg ? cg->num_insns : 0;
+}
+
+Eval compiled_graph_eval(const CompiledGraph* cg, const Heap* heap, const Env* env, Eval* slots) {
+    int i;
+    if (!cg || !slots) {
+        return (Eval){0, ERR_INVALID, 0};
+    }
+    for (i = 0; i < cg->num_insns; ++i) {
+        const CgInsn* in = &cg->insns[i];
+        switch (in->op) {
+            case CG_CONST:
+                slots[i] = in->k;
+                break;
+            case CG_INPUT_P:
+                slots[i] = ck_input("p", env->p);
+                break;
+            case CG_INPUT_Q:
+                slots[i] = ck_input("q", env->q);
+                break;
+            case CG_IS_NONNULL:
+                slots[i] = ck_guard_nonnull(slots[in->a]);
+                break;
+            case CG_GUARD_PTR: {
+                Eval v = slots[in->a];
+                slots[i] = (v.ok && VAL_IS_INT(v.value)) ? (Eval){0, ERR_TYPE, 0} : v;
+                break;
+            }
+            case CG_GUARD_NONNULL: {
+                Eval v = slots[in->a];
+                if (v.ok && VAL_IS_INT(v.value)) {
+                    v = (Eval){0, ERR_TYPE, 0};
+                } else if (v.ok && v.value == VAL_NULL) {
+                    v = (Eval){0, ERR_NULL, 0};
+                }
+                slots[i] = v;
+                break;
+            }
+            case CG_GUARD_EQ:
+                slots[i] = ck_guard_eq(slots[in->a], slots[in->b]);
+                break;
+            case CG_LOAD_PTR:
+                slots[i] = ck_load_ptr((Heap*)heap, slots[in->a]);
+                break;
+            case CG_LOAD_INT:
+                slots[i] = ck_load_int((Heap*)heap, slots[in->a]);
+                break;
+            case CG_GETFIELD:
+                slots[i] = ck_getfield((Heap*)heap, slots[in->a], in->field);
+                break;
+            case CG_GETFIELD_INT:
+                slots[i] = ck_getfield_int((Heap*)heap, slots[in->a], in->field);
+                break;
+            case CG_SELECT:
+                slots[i] = ck_select(slots[in->a], slots[in->b], slots[in->c]);
+                break;
+            case CG_ADD:
+                slots[i] = ck_add(slots[in->a], slots[in->b]);
+                break;
+            case CG_TRUTHY:
+                slots[i] = ck_const_int(ck_truthy(slots[in->a]));
+                break;
+            case CG_LOOP_CHAIN:
+                slots[i] = ck_load_chain((Heap*)heap, slots[in->a], in->field, in->count);
+                break;
+        }
+    }
+    return slots[cg->output];
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef GRAPH_COMPILE_H
+#define GRAPH_COMPILE_H
+
+#include "graph_eval.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A graph flattened into a straight-line program: the nodes reachable from
+   the output in topological order, operands resolved to slot indices and
+   constants/inputs pre-bound, so evaluation is a single forward pass with
+   no recursion or memo lookups. Same results as graph_eval. */
+typedef struct CompiledGraph CompiledGraph;
+
+/* Returns NULL for a cyclic graph or on allocation failure. */
+CompiledGraph* graph_compile(const Graph* graph);
+void compiled_graph_free(CompiledGraph* cg);
+int compiled_graph_num_slots(const CompiledGraph* cg);
+/* slots: caller-owned buffer of compiled_graph_num_slots() entries. */
+Eval compiled_graph_eval(const CompiledGraph* cg, const Heap* heap, const Env* env, Eval* slots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
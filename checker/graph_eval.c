@@ -2,6 +2,13 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef GRAPH_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
 
 typedef enum {
     TK_EOF,
@@ -25,8 +32,28 @@ typedef struct {
     long num;
 } Token;
 
+typedef enum {
+    OP_INVALID = 0,
+    OP_INPUT,
+    OP_CONST_INT,
+    OP_CONST_NULL,
+    OP_IS_NONNULL,
+    OP_GUARD_PTR,
+    OP_GUARD_NONNULL,
+    OP_GUARD_EQ,
+    OP_LOAD_PTR,
+    OP_LOAD_INT,
+    OP_GETFIELD,
+    OP_GETFIELD_INT,
+    OP_SELECT,
+    OP_ADD,
+    OP_TRUTHY,
+    OP_LOOP_CHAIN
+} NodeOp;
+
 typedef struct {
     int id;
+    NodeOp op; /* resolved from kind at load time */
     char kind[24];
     char name[32];
     int x;
@@ -38,10 +65,34 @@ typedef struct {
     int else_id;
 } Node;
 
+#ifdef GRAPH_PROFILE
+typedef struct {
+    unsigned long long evals;
+    unsigned long long* hits;        /* per node */
+    unsigned long long* self_cycles; /* per node, children excluded */
+    unsigned long long* err_origin;  /* per node x Err: errors raised (not propagated) here */
+} GraphProfile;
+
+/* Counters are shared by every thread evaluating the graph (driver
+   --exhaustive --threads), so they are bumped with relaxed atomic adds;
+   the child cycles belong to one evaluation and stay per thread. */
+#if defined(__GNUC__) || defined(__clang__)
+#define PROF_ADD(counter, n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+static __thread unsigned long long child_acc; /* cycles spent in children of the node being timed */
+#else
+#define PROF_ADD(counter, n) ((counter) += (n))
+static unsigned long long child_acc;
+#endif
+#endif
+
 struct Graph {
     int num_nodes;
     Node* nodes; /* 1-based index */
     int output;
+    char function[64];
+#ifdef GRAPH_PROFILE
+    GraphProfile* prof;
+#endif
 };
 
 static void skip_ws(const char** p) {
@@ -194,6 +245,33 @@ static void parse_skip_value(const char** p) {
     }
 }
 
+static NodeOp op_from_kind(const char* kind) {
+    static const struct { const char* kind; NodeOp op; } ops[] = {
+        {"input", OP_INPUT},
+        {"const_int", OP_CONST_INT},
+        {"const_null", OP_CONST_NULL},
+        {"is_nonnull", OP_IS_NONNULL},
+        {"guard_ptr", OP_GUARD_PTR},
+        {"guard_nonnull", OP_GUARD_NONNULL},
+        {"guard_eq", OP_GUARD_EQ},
+        {"load_ptr", OP_LOAD_PTR},
+        {"load_int", OP_LOAD_INT},
+        {"getfield", OP_GETFIELD},
+        {"getfield_int", OP_GETFIELD_INT},
+        {"select", OP_SELECT},
+        {"add", OP_ADD},
+        {"truthy", OP_TRUTHY},
+        {"loop_chain", OP_LOOP_CHAIN},
+    };
+    size_t i;
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+        if (strcmp(kind, ops[i].kind) == 0) {
+            return ops[i].op;
+        }
+    }
+    return OP_INVALID;
+}
+
 static int ensure_capacity(Node** nodes, int* cap, int id) {
     int new_cap;
     Node* new_nodes;
@@ -307,6 +385,7 @@ static void parse_nodes_array(const char** p, Graph* graph) {
         }
 
         if (id > 0 && ensure_capacity(&nodes, &cap, id + 1)) {
+            node.op = op_from_kind(node.kind);
             nodes[id] = node;
             if (id > graph->num_nodes) {
                 graph->num_nodes = id;
@@ -367,6 +446,13 @@ Graph* graph_load_json(const char* path) {
         parse_expect(&p, TK_COLON);
         if (token_equals(&key, "nodes")) {
             parse_nodes_array(&p, graph);
+        } else if (token_equals(&key, "function")) {
+            Token v = next_token(&p);
+            if (v.kind == TK_STRING) {
+                int n = v.len < (int)sizeof(graph->function) - 1 ? v.len : (int)sizeof(graph->function) - 1;
+                memcpy(graph->function, v.start, (size_t)n);
+                graph->function[n] = '\0';
+            }
         } else if (token_equals(&key, "output")) {
             Token v = next_token(&p);
             if (v.kind == TK_NUMBER) {
@@ -382,6 +468,19 @@ Graph* graph_load_json(const char* path) {
     }
 
     free(buf);
+#ifdef GRAPH_PROFILE
+    graph->prof = (GraphProfile*)calloc(1, sizeof(GraphProfile));
+    if (graph->prof) {
+        size_t n = (size_t)graph->num_nodes + 1;
+        graph->prof->hits = (unsigned long long*)calloc(n, sizeof(unsigned long long));
+        graph->prof->self_cycles = (unsigned long long*)calloc(n, sizeof(unsigned long long));
+        graph->prof->err_origin = (unsigned long long*)calloc(n * 5, sizeof(unsigned long long));
+        if (!graph->prof->hits || !graph->prof->self_cycles || !graph->prof->err_origin) {
+            graph_free(graph);
+            return NULL;
+        }
+    }
+#endif
     return graph;
 }
 
@@ -389,6 +488,14 @@ void graph_free(Graph* graph) {
     if (!graph) {
         return;
     }
+#ifdef GRAPH_PROFILE
+    if (graph->prof) {
+        free(graph->prof->hits);
+        free(graph->prof->self_cycles);
+        free(graph->prof->err_origin);
+        free(graph->prof);
+    }
+#endif
     free(graph->nodes);
     free(graph);
 }
@@ -403,8 +510,44 @@ static int env_lookup(const Env* env, const char* name) {
     return VAL_NULL;
 }
 
+#ifdef GRAPH_PROFILE
+static unsigned long long profile_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (unsigned long long)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+static int operand_failed(const Eval* memo, const unsigned char* seen, int id) {
+    return id > 0 && seen[id] && !memo[id].ok;
+}
+
+static void profile_node(const Graph* graph, const Node* node, const Eval* memo, const unsigned char* seen,
+                         unsigned long long start, unsigned long long saved_acc) {
+    GraphProfile* prof = graph->prof;
+    unsigned long long total = profile_clock() - start;
+    Eval r = memo[node->id];
+    PROF_ADD(prof->hits[node->id], 1ull);
+    PROF_ADD(prof->self_cycles[node->id], total > child_acc ? total - child_acc : 0ull);
+    child_acc = saved_acc + total;
+    if (!r.ok && (int)r.err > 0 && (int)r.err < 5 &&
+        !operand_failed(memo, seen, node->x) && !operand_failed(memo, seen, node->y) &&
+        !operand_failed(memo, seen, node->cond) && !operand_failed(memo, seen, node->then_id) &&
+        !operand_failed(memo, seen, node->else_id)) {
+        PROF_ADD(prof->err_origin[(size_t)node->id * 5 + (size_t)r.err], 1ull);
+    }
+}
+#endif
+
 static Eval eval_node(const Graph* graph, const Heap* heap, const Env* env, int id, Eval* memo, unsigned char* seen) {
     Node* node;
+#ifdef GRAPH_PROFILE
+    unsigned long long prof_start = 0;
+    unsigned long long prof_saved = 0;
+#endif
     if (id <= 0 || id > graph->num_nodes) {
         return (Eval){0, ERR_INVALID, 0};
     }
@@ -413,63 +556,187 @@ static Eval eval_node(const Graph* graph, const Heap* heap, const Env* env, int
     }
     seen[id] = 1;
     node = &graph->nodes[id];
+#ifdef GRAPH_PROFILE
+    if (graph->prof) {
+        prof_saved = child_acc;
+        child_acc = 0;
+        prof_start = profile_clock();
+    }
+#endif
 
-    if (strcmp(node->kind, "input") == 0) {
-        memo[id] = ck_input(node->name, env_lookup(env, node->name));
-    } else if (strcmp(node->kind, "const_int") == 0) {
-        memo[id] = ck_const_int(node->value);
-    } else if (strcmp(node->kind, "const_null") == 0) {
-        memo[id] = ck_const_null();
-    } else if (strcmp(node->kind, "is_nonnull") == 0) {
-        memo[id] = ck_guard_nonnull(eval_node(graph, heap, env, node->x, memo, seen));
-    } else if (strcmp(node->kind, "guard_ptr") == 0) {
-        Eval v = eval_node(graph, heap, env, node->x, memo, seen);
-        if (!v.ok) {
-            memo[id] = v;
-        } else if (VAL_IS_INT(v.value)) {
-            memo[id] = (Eval){0, ERR_TYPE, 0};
-        } else {
-            memo[id] = v;
+    switch (node->op) {
+        case OP_INPUT:
+            memo[id] = ck_input(node->name, env_lookup(env, node->name));
+            break;
+        case OP_CONST_INT:
+            memo[id] = ck_const_int(node->value);
+            break;
+        case OP_CONST_NULL:
+            memo[id] = ck_const_null();
+            break;
+        case OP_IS_NONNULL:
+            memo[id] = ck_guard_nonnull(eval_node(graph, heap, env, node->x, memo, seen));
+            break;
+        case OP_GUARD_PTR: {
+            Eval v = eval_node(graph, heap, env, node->x, memo, seen);
+            if (!v.ok) {
+                memo[id] = v;
+            } else if (VAL_IS_INT(v.value)) {
+                memo[id] = (Eval){0, ERR_TYPE, 0};
+            } else {
+                memo[id] = v;
+            }
+            break;
         }
-    } else if (strcmp(node->kind, "guard_nonnull") == 0) {
-        Eval v = eval_node(graph, heap, env, node->x, memo, seen);
-        if (!v.ok) {
-            memo[id] = v;
-        } else if (VAL_IS_INT(v.value)) {
-            memo[id] = (Eval){0, ERR_TYPE, 0};
-        } else if (v.value == VAL_NULL) {
-            memo[id] = (Eval){0, ERR_NULL, 0};
-        } else {
-            memo[id] = v;
+        case OP_GUARD_NONNULL: {
+            Eval v = eval_node(graph, heap, env, node->x, memo, seen);
+            if (!v.ok) {
+                memo[id] = v;
+            } else if (VAL_IS_INT(v.value)) {
+                memo[id] = (Eval){0, ERR_TYPE, 0};
+            } else if (v.value == VAL_NULL) {
+                memo[id] = (Eval){0, ERR_NULL, 0};
+            } else {
+                memo[id] = v;
+            }
+            break;
         }
-    } else if (strcmp(node->kind, "guard_eq") == 0) {
-        memo[id] = ck_guard_eq(
-            eval_node(graph, heap, env, node->x, memo, seen),
-            eval_node(graph, heap, env, node->y, memo, seen));
-    } else if (strcmp(node->kind, "load_ptr") == 0) {
-        memo[id] = ck_load_ptr((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen));
-    } else if (strcmp(node->kind, "load_int") == 0) {
-        memo[id] = ck_load_int((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen));
-    } else if (strcmp(node->kind, "getfield") == 0) {
-        memo[id] = ck_getfield((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen), node->field);
-    } else if (strcmp(node->kind, "getfield_int") == 0) {
-        memo[id] = ck_getfield_int((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen), node->field);
-    } else if (strcmp(node->kind, "select") == 0) {
-        memo[id] = ck_select(
-            eval_node(graph, heap, env, node->cond, memo, seen),
-            eval_node(graph, heap, env, node->then_id, memo, seen),
-            eval_node(graph, heap, env, node->else_id, memo, seen));
-    } else if (strcmp(node->kind, "add") == 0) {
-        memo[id] = ck_add(
-            eval_node(graph, heap, env, node->x, memo, seen),
-            eval_node(graph, heap, env, node->y, memo, seen));
-    } else {
-        memo[id] = (Eval){0, ERR_INVALID, 0};
+        case OP_GUARD_EQ:
+            memo[id] = ck_guard_eq(
+                eval_node(graph, heap, env, node->x, memo, seen),
+                eval_node(graph, heap, env, node->y, memo, seen));
+            break;
+        case OP_LOAD_PTR:
+            memo[id] = ck_load_ptr((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen));
+            break;
+        case OP_LOAD_INT:
+            memo[id] = ck_load_int((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen));
+            break;
+        case OP_GETFIELD:
+            memo[id] = ck_getfield((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen), node->field);
+            break;
+        case OP_GETFIELD_INT:
+            memo[id] = ck_getfield_int((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen), node->field);
+            break;
+        case OP_SELECT:
+            memo[id] = ck_select(
+                eval_node(graph, heap, env, node->cond, memo, seen),
+                eval_node(graph, heap, env, node->then_id, memo, seen),
+                eval_node(graph, heap, env, node->else_id, memo, seen));
+            break;
+        case OP_ADD:
+            memo[id] = ck_add(
+                eval_node(graph, heap, env, node->x, memo, seen),
+                eval_node(graph, heap, env, node->y, memo, seen));
+            break;
+        case OP_TRUTHY:
+            memo[id] = ck_const_int(ck_truthy(eval_node(graph, heap, env, node->x, memo, seen)));
+            break;
+        case OP_LOOP_CHAIN:
+            /* value loads of field along the chain */
+            memo[id] = ck_load_chain((Heap*)heap, eval_node(graph, heap, env, node->x, memo, seen), node->field,
+                                     node->value);
+            break;
+        default:
+            memo[id] = (Eval){0, ERR_INVALID, 0};
+            break;
     }
 
+#ifdef GRAPH_PROFILE
+    if (graph->prof) {
+        profile_node(graph, node, memo, seen, prof_start, prof_saved);
+    }
+#endif
     return memo[id];
 }
 
+int graph_num_nodes(const Graph* graph) {
+    return graph ? graph->num_nodes : 0;
+}
+
+const char* graph_node_kind(const Graph* graph, int id) {
+    if (!graph || id <= 0 || id > graph->num_nodes) {
+        return NULL;
+    }
+    return graph->nodes[id].kind;
+}
+
+int graph_node_info(const Graph* graph, int id, GraphNodeInfo* out) {
+    const Node* node;
+    if (!graph || !out || id <= 0 || id > graph->num_nodes) {
+        return 0;
+    }
+    node = &graph->nodes[id];
+    out->kind = node->kind;
+    out->name = node->name;
+    out->x = node->x;
+    out->y = node->y;
+    out->field = node->field;
+    out->value = node->value;
+    out->cond = node->cond;
+    out->then_id = node->then_id;
+    out->else_id = node->else_id;
+    return 1;
+}
+
+int graph_output(const Graph* graph) {
+    return graph ? graph->output : 0;
+}
+
+unsigned graph_field_mask(const Graph* graph) {
+    unsigned mask = 0;
+    int id;
+    if (!graph) {
+        return 0;
+    }
+    for (id = 1; id <= graph->num_nodes; ++id) {
+        const Node* node = &graph->nodes[id];
+        switch (node->op) {
+            case OP_LOAD_PTR:
+            case OP_LOAD_INT:
+                mask |= 1u << FIELD_DEREF;
+                break;
+            case OP_GETFIELD:
+            case OP_GETFIELD_INT:
+            case OP_LOOP_CHAIN:
+                if (node->field >= 0 && node->field < MAX_FIELDS) {
+                    mask |= 1u << node->field;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return mask;
+}
+
+int graph_has_input(const Graph* graph, const char* name) {
+    int id;
+    if (!graph || !name) {
+        return 0;
+    }
+    for (id = 1; id <= graph->num_nodes; ++id) {
+        if (graph->nodes[id].op == OP_INPUT && strcmp(graph->nodes[id].name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+Eval graph_eval_trace(const Graph* graph, const Heap* heap, const Env* env, Eval* nodes, unsigned char* seen) {
+    if (!graph || graph->output <= 0 || !nodes || !seen) {
+        return (Eval){0, ERR_INVALID, 0};
+    }
+    memset(seen, 0, (size_t)graph->num_nodes + 1);
+#ifdef GRAPH_PROFILE
+    if (graph->prof) {
+        PROF_ADD(graph->prof->evals, 1ull);
+        child_acc = 0;
+    }
+#endif
+    return eval_node(graph, heap, env, graph->output, nodes, seen);
+}
+
 Eval graph_eval(const Graph* graph, const Heap* heap, const Env* env) {
     Eval* memo;
     unsigned char* seen;
@@ -484,8 +751,110 @@ Eval graph_eval(const Graph* graph, const Heap* heap, const Env* env) {
         free(seen);
         return (Eval){0, ERR_INVALID, 0};
     }
+#ifdef GRAPH_PROFILE
+    if (graph->prof) {
+        PROF_ADD(graph->prof->evals, 1ull);
+        child_acc = 0;
+    }
+#endif
     out = eval_node(graph, heap, env, graph->output, memo, seen);
     free(memo);
     free(seen);
     return out;
 }
+
+int graph_profile_enabled(void) {
+#ifdef GRAPH_PROFILE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void graph_profile_reset(Graph* graph) {
+#ifdef GRAPH_PROFILE
+    size_t n;
+    if (!graph || !graph->prof) {
+        return;
+    }
+    n = (size_t)graph->num_nodes + 1;
+    graph->prof->evals = 0;
+    memset(graph->prof->hits, 0, n * sizeof(unsigned long long));
+    memset(graph->prof->self_cycles, 0, n * sizeof(unsigned long long));
+    memset(graph->prof->err_origin, 0, n * 5 * sizeof(unsigned long long));
+#else
+    (void)graph;
+#endif
+}
+
+#ifdef GRAPH_PROFILE
+static void write_edge(FILE* f, int from, int to, int* first) {
+    if (from <= 0) {
+        return;
+    }
+    fprintf(f, "%s[%d,%d]", *first ? "" : ",", from, to);
+    *first = 0;
+}
+#endif
+
+int graph_profile_write_json(const Graph* graph, FILE* f) {
+#ifdef GRAPH_PROFILE
+    static const char* const err_names[5] = {"ok", "null", "invalid", "type", "missing_field"};
+    const GraphProfile* prof;
+    int id;
+    int first = 1;
+    if (!graph || !graph->prof || !f) {
+        return 0;
+    }
+    prof = graph->prof;
+    fprintf(f, "{\n  \"function\": \"%s\",\n", graph->function);
+    fprintf(f, "  \"clock\": \"%s\",\n",
+#if defined(__x86_64__) || defined(__i386__)
+            "rdtsc"
+#else
+            "ns"
+#endif
+    );
+    fprintf(f, "  \"evals\": %llu,\n  \"output\": %d,\n  \"nodes\": [\n", prof->evals, graph->output);
+    for (id = 1; id <= graph->num_nodes; ++id) {
+        const Node* node = &graph->nodes[id];
+        int e;
+        if (node->id == 0) {
+            continue;
+        }
+        fprintf(f, "%s    {\"id\":%d,\"kind\":\"%s\"", first ? "" : ",\n", node->id, node->kind);
+        first = 0;
+        if (node->name[0]) {
+            fprintf(f, ",\"name\":\"%s\"", node->name);
+        }
+        if (node->op == OP_GETFIELD || node->op == OP_GETFIELD_INT || node->op == OP_LOOP_CHAIN) {
+            fprintf(f, ",\"field\":%d", node->field);
+        }
+        if (node->op == OP_LOOP_CHAIN) {
+            fprintf(f, ",\"value\":%d", node->value);
+        }
+        fprintf(f, ",\"hits\":%llu,\"self_cycles\":%llu,\"errors\":{",
+                prof->hits[id], prof->self_cycles[id]);
+        for (e = 1; e < 5; ++e) {
+            fprintf(f, "%s\"%s\":%llu", e > 1 ? "," : "", err_names[e], prof->err_origin[(size_t)id * 5 + (size_t)e]);
+        }
+        fprintf(f, "}}");
+    }
+    fprintf(f, "%s  ],\n  \"edges\": [", first ? "" : "\n");
+    first = 1;
+    for (id = 1; id <= graph->num_nodes; ++id) {
+        const Node* node = &graph->nodes[id];
+        write_edge(f, node->x, id, &first);
+        write_edge(f, node->y, id, &first);
+        write_edge(f, node->cond, id, &first);
+        write_edge(f, node->then_id, id, &first);
+        write_edge(f, node->else_id, id, &first);
+    }
+    fprintf(f, "]\n}\n");
+    return 1;
+#else
+    (void)graph;
+    (void)f;
+    return 0;
+#endif
+}
\ No newline at end of file
@@ -9,10 +9,44 @@ extern "C" {
 
 typedef struct Graph Graph;
 
+/* Read-only view of one node; operand ids are 0 when absent. */
+typedef struct {
+    const char* kind;
+    const char* name;
+    int x;
+    int y;
+    int field;
+    int value;
+    int cond;
+    int then_id;
+    int else_id;
+} GraphNodeInfo;
+
 Graph* graph_load_json(const char* path);
 void graph_free(Graph* graph);
 Eval graph_eval(const Graph* graph, const Heap* heap, const Env* env);
 
+int graph_num_nodes(const Graph* graph);
+const char* graph_node_kind(const Graph* graph, int id);
+int graph_node_info(const Graph* graph, int id, GraphNodeInfo* out);
+int graph_output(const Graph* graph);
+/* Bit f is set when a load or getfield node of the graph reads field f. */
+unsigned graph_field_mask(const Graph* graph);
+int graph_has_input(const Graph* graph, const char* name);
+/* Evaluate into caller-owned buffers of graph_num_nodes()+1 entries; on return
+   seen[id] marks the nodes that were evaluated and nodes[id] holds their result.
+   No allocation, so it is the cheap entry point for repeated evaluation. */
+Eval graph_eval_trace(const Graph* graph, const Heap* heap, const Env* env, Eval* nodes, unsigned char* seen);
+
+/* Per-node profile (hit counts, self cycles via rdtsc, error origins) collected
+   when the checker is built with GRAPH_PROFILE; otherwise the evaluator carries
+   no instrumentation and these report "disabled" / write nothing.
+   Counters live in the Graph and add up across threads evaluating it at
+   once; reset and write them while none is. */
+int graph_profile_enabled(void);
+void graph_profile_reset(Graph* graph);
+int graph_profile_write_json(const Graph* graph, FILE* f);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,248 @@
+#include "manifest.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Just enough JSON for the manifest: objects, arrays, strings without
+   escapes and integers. Unknown keys are skipped. */
+
+static void skip_ws(const char** p) {
+    while (**p && isspace((unsigned char)**p)) {
+        (*p)++;
+    }
+}
+
+static int accept(const char** p, char c) {
+    skip_ws(p);
+    if (**p == c) {
+        (*p)++;
+        return 1;
+    }
+    return 0;
+}
+
+/* Copy a string token into buf (truncating); 0 if the next token is not a string. */
+static int parse_string(const char** p, char* buf, size_t n) {
+    const char* start;
+    size_t len;
+    if (!accept(p, '"')) {
+        return 0;
+    }
+    start = *p;
+    while (**p && **p != '"') {
+        (*p)++;
+    }
+    len = (size_t)(*p - start);
+    if (**p == '"') {
+        (*p)++;
+    }
+    if (buf && n) {
+        if (len >= n) {
+            len = n - 1;
+        }
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+    }
+    return 1;
+}
+
+/* Skip one value of any kind: stop at the first separator outside it. */
+static void skip_value(const char** p) {
+    int depth = 0;
+    skip_ws(p);
+    while (**p) {
+        char c = **p;
+        if (c == '"') {
+            parse_string(p, NULL, 0);
+            continue;
+        }
+        if (depth == 0 && (c == ',' || c == '}' || c == ']')) {
+            return;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+        (*p)++;
+    }
+}
+
+static void parse_inputs(const char** p, ManifestKernel* k) {
+    if (!accept(p, '[')) {
+        skip_value(p);
+        return;
+    }
+    if (accept(p, ']')) {
+        return;
+    }
+    do {
+        char name[32];
+        if (!parse_string(p, name, sizeof(name))) {
+            skip_value(p);
+        } else if (k->num_inputs < MANIFEST_MAX_INPUTS) {
+            memcpy(k->inputs[k->num_inputs++], name, sizeof(name));
+        }
+    } while (accept(p, ','));
+    accept(p, ']');
+}
+
+static void parse_fields(const char** p, ManifestKernel* k) {
+    if (!accept(p, '[')) {
+        skip_value(p);
+        return;
+    }
+    if (accept(p, ']')) {
+        return;
+    }
+    do {
+        char* endp;
+        long field;
+        skip_ws(p);
+        field = strtol(*p, &endp, 10);
+        if (endp == *p) {
+            skip_value(p);
+            continue;
+        }
+        *p = endp;
+        if (field >= 0 && field < MAX_FIELDS && k->num_fields < MAX_FIELDS) {
+            k->fields[k->num_fields++] = (int)field;
+        }
+    } while (accept(p, ','));
+    accept(p, ']');
+}
+
+static int parse_kernel(const char** p, ManifestKernel* k) {
+    memset(k, 0, sizeof(*k));
+    if (!accept(p, '{')) {
+        return 0;
+    }
+    if (accept(p, '}')) {
+        return 1;
+    }
+    do {
+        char key[32];
+        if (!parse_string(p, key, sizeof(key)) || !accept(p, ':')) {
+            return 0;
+        }
+        if (strcmp(key, "name") == 0) {
+            parse_string(p, k->name, sizeof(k->name));
+        } else if (strcmp(key, "graph") == 0) {
+            parse_string(p, k->graph, sizeof(k->graph));
+        } else if (strcmp(key, "inputs") == 0) {
+            parse_inputs(p, k);
+        } else if (strcmp(key, "fields") == 0) {
+            parse_fields(p, k);
+        } else {
+            skip_value(p);
+        }
+    } while (accept(p, ','));
+    return accept(p, '}');
+}
+
+static int parse_kernels(const char** p, Manifest* manifest) {
+    int cap = 0;
+    if (!accept(p, '[')) {
+        return 0;
+    }
+    if (accept(p, ']')) {
+        return 1;
+    }
+    do {
+        ManifestKernel k;
+        if (!parse_kernel(p, &k)) {
+            return 0;
+        }
+        if (!k.name[0]) {
+            continue;
+        }
+        if (!k.graph[0]) {
+            snprintf(k.graph, sizeof(k.graph), "%s.json", k.name);
+        }
+        if (manifest->num_kernels == cap) {
+            int new_cap = cap ? cap * 2 : 16;
+            ManifestKernel* grown = (ManifestKernel*)realloc(manifest->kernels, (size_t)new_cap * sizeof(ManifestKernel));
+            if (!grown) {
+                return 0;
+            }
+            manifest->kernels = grown;
+            cap = new_cap;
+        }
+        manifest->kernels[manifest->num_kernels++] = k;
+    } while (accept(p, ','));
+    return accept(p, ']');
+}
+
+Manifest* manifest_load_json(const char* path) {
+    FILE* f = fopen(path, "rb");
+    long size;
+    char* buf;
+    const char* p;
+    Manifest* manifest;
+    int ok = 1;
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (char*)malloc((size_t)size + 1);
+    if (!buf) {
+        fclose(f);
+        return NULL;
+    }
+    size = (long)fread(buf, 1, (size_t)size, f);
+    buf[size] = '\0';
+    fclose(f);
+
+    manifest = (Manifest*)calloc(1, sizeof(Manifest));
+    if (!manifest) {
+        free(buf);
+        return NULL;
+    }
+    p = buf;
+    if (!accept(&p, '{')) {
+        ok = 0;
+    } else if (!accept(&p, '}')) {
+        do {
+            char key[32];
+            if (!parse_string(&p, key, sizeof(key)) || !accept(&p, ':')) {
+                ok = 0;
+                break;
+            }
+            if (strcmp(key, "kernels") == 0) {
+                if (!parse_kernels(&p, manifest)) {
+                    ok = 0;
+                    break;
+                }
+            } else {
+                skip_value(&p);
+            }
+        } while (accept(&p, ','));
+    }
+    free(buf);
+    if (!ok) {
+        manifest_free(manifest);
+        return NULL;
+    }
+    return manifest;
+}
+
+void manifest_free(Manifest* manifest) {
+    if (!manifest) {
+        return;
+    }
+    free(manifest->kernels);
+    free(manifest);
+}
+
+int manifest_kernel_has_input(const ManifestKernel* kernel, const char* name) {
+    int i;
+    for (i = 0; i < kernel->num_inputs; ++i) {
+        if (strcmp(kernel->inputs[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
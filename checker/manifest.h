@@ -0,0 +1,39 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "checked_ptr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MANIFEST_MAX_INPUTS 4
+
+/* One kernel as listed by the guarded-graph pass in manifest.json:
+   {"kernels":[{"name":..., "graph":..., "inputs":[...], "fields":[...]}]}.
+   graph is relative to the graph directory; fields are the fields the graph
+   reads, in order of first use. */
+typedef struct {
+    char name[64];
+    char graph[256];
+    char inputs[MANIFEST_MAX_INPUTS][32];
+    int num_inputs;
+    int fields[MAX_FIELDS];
+    int num_fields;
+} ManifestKernel;
+
+typedef struct {
+    int num_kernels;
+    ManifestKernel* kernels;
+} Manifest;
+
+/* NULL when the file is missing or is not a JSON object. */
+Manifest* manifest_load_json(const char* path);
+void manifest_free(Manifest* manifest);
+int manifest_kernel_has_input(const ManifestKernel* kernel, const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "bench_harness.h"
+#include "checked_ptr.h"
+#include "heap_arena.h"
+#include "heap_gen.h"
+#include "kernels.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Arena vs calloc heaps.
+
+   build: one per-request heap of --objs objects (a list ending in an int)
+   built and thrown away per iteration, with heap_create/heap_free, with an
+   arena reset + one alloc_n, and with an arena reset + one alloc per
+   object.
+   walk: triple_deref over chains scattered through a --walk_objs heap, on
+   a calloc'd heap and on an arena heap of the same layout. */
+
+typedef struct {
+    HeapArena* arena;
+    int objs;
+} BuildCtx;
+
+static void fill_list(Heap* heap, int first, int n) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        Obj* obj = &heap->objs[first - 1 + i];
+        obj->has_field[FIELD_DEREF] = 1;
+        obj->value[FIELD_DEREF] = i + 1 < n ? VAL_PTR(first + i + 1) : VAL_INT(i);
+    }
+}
+
+static uint64_t build_malloc(void* arg, uint64_t iters) {
+    const BuildCtx* ctx = (const BuildCtx*)arg;
+    uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        Heap* heap = heap_create(ctx->objs);
+        if (!heap) {
+            continue;
+        }
+        fill_list(heap, 1, ctx->objs);
+        sink += (uint64_t)triple_deref(heap, VAL_PTR(1), VAL_NULL).value;
+        heap_free(heap);
+    }
+    return sink;
+}
+
+static uint64_t build_arena_bulk(void* arg, uint64_t iters) {
+    const BuildCtx* ctx = (const BuildCtx*)arg;
+    Heap* heap = heap_arena_heap(ctx->arena);
+    uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        int first;
+        heap_arena_reset(ctx->arena);
+        first = heap_arena_alloc_n(ctx->arena, ctx->objs);
+        fill_list(heap, first, ctx->objs);
+        sink += (uint64_t)triple_deref(heap, VAL_PTR(first), VAL_NULL).value;
+    }
+    return sink;
+}
+
+static uint64_t build_arena_each(void* arg, uint64_t iters) {
+    const BuildCtx* ctx = (const BuildCtx*)arg;
+    Heap* heap = heap_arena_heap(ctx->arena);
+    uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        int first;
+        int i;
+        heap_arena_reset(ctx->arena);
+        first = heap_arena_alloc(ctx->arena);
+        for (i = 1; i < ctx->objs; ++i) {
+            heap_arena_alloc(ctx->arena);
+        }
+        fill_list(heap, first, ctx->objs);
+        sink += (uint64_t)triple_deref(heap, VAL_PTR(first), VAL_NULL).value;
+    }
+    return sink;
+}
+
+typedef struct {
+    Heap* heap;
+    int* starts;
+    int num_starts;
+} WalkCtx;
+
+static uint64_t walk_loop(void* arg, uint64_t iters) {
+    const WalkCtx* ctx = (const WalkCtx*)arg;
+    Heap* heap = ctx->heap;
+    int idx = 0;
+    uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        sink += (uint64_t)triple_deref(heap, ctx->starts[idx], VAL_NULL).value;
+        if (++idx == ctx->num_starts) {
+            idx = 0;
+        }
+    }
+    return sink;
+}
+
+/* Three-object chains at shuffled addresses; starts[] in chain order. */
+static int fill_chains(Heap* heap, int* starts, int num_chains, unsigned seed) {
+    int objs = num_chains * 3;
+    int* perm = (int*)malloc((size_t)objs * sizeof(int));
+    Rng rng;
+    int c;
+    int i;
+    if (!perm) {
+        return 0;
+    }
+    rng_seed(&rng, seed);
+    for (i = 0; i < objs; ++i) {
+        perm[i] = i + 1;
+    }
+    for (i = objs - 1; i > 0; --i) {
+        int j = rng_range(&rng, 0, i);
+        int t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+    for (c = 0; c < num_chains; ++c) {
+        for (i = 0; i < 3; ++i) {
+            Obj* obj = heap_get_obj(heap, perm[c * 3 + i]);
+            obj->has_field[FIELD_DEREF] = 1;
+            obj->value[FIELD_DEREF] = i < 2 ? VAL_PTR(perm[c * 3 + i + 1]) : VAL_INT(c);
+        }
+        starts[c] = VAL_PTR(perm[c * 3]);
+    }
+    free(perm);
+    return 1;
+}
+
+static int run_one(const char* label, BenchBodyFn body, void* ctx, const BenchConfig* cfg) {
+    BenchResult res;
+    if (!bench_run(label, body, ctx, cfg, &res)) {
+        fprintf(stderr, "%s failed\n", label);
+        return 0;
+    }
+    printf("%-12s ", label);
+    bench_report(&res, cfg, stdout);
+    bench_result_free(&res);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    BuildCtx build;
+    WalkCtx walk;
+    HeapArena* walk_arena = NULL;
+    Heap* walk_heap = NULL;
+    int objs = 256;
+    int walk_objs = 1 << 22;
+    int num_chains;
+    unsigned seed = 1234;
+    int status = 0;
+    int i;
+
+    bench_config_default(&cfg);
+    cfg.samples = 20;
+
+    for (i = 1; i < argc; ++i) {
+        if (bench_parse_arg(&cfg, argc, argv, &i)) {
+            continue;
+        } else if (strcmp(argv[i], "--objs") == 0 && i + 1 < argc) {
+            objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--walk_objs") == 0 && i + 1 < argc) {
+            walk_objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        }
+    }
+    /* one result per line; a single --json file would only keep the last */
+    cfg.json_path = NULL;
+    num_chains = walk_objs / 3;
+    if (objs < 1 || num_chains < 1) {
+        fprintf(stderr, "objs must be >= 1 and walk_objs >= 3\n");
+        return 1;
+    }
+
+    build.objs = objs;
+    build.arena = heap_arena_create(objs);
+    if (!build.arena) {
+        fprintf(stderr, "failed to create arena\n");
+        return 1;
+    }
+    printf("build objs=%d\n", objs);
+    status |= !run_one("malloc", build_malloc, &build, &cfg);
+    status |= !run_one("arena_bulk", build_arena_bulk, &build, &cfg);
+    status |= !run_one("arena_each", build_arena_each, &build, &cfg);
+    heap_arena_destroy(build.arena);
+
+    walk.starts = (int*)malloc((size_t)num_chains * sizeof(int));
+    walk.num_starts = num_chains;
+    walk_heap = heap_create(num_chains * 3);
+    walk_arena = heap_arena_create(num_chains * 3);
+    if (!walk.starts || !walk_heap || !walk_arena || !heap_arena_alloc_n(walk_arena, num_chains * 3)) {
+        fprintf(stderr, "failed to build walk heaps\n");
+        status = 1;
+    } else {
+        printf("walk objs=%d committed=%zu\n", num_chains * 3, heap_arena_committed_bytes(walk_arena));
+        fill_chains(walk_heap, walk.starts, num_chains, seed);
+        walk.heap = walk_heap;
+        status |= !run_one("calloc", walk_loop, &walk, &cfg);
+        fill_chains(heap_arena_heap(walk_arena), walk.starts, num_chains, seed);
+        walk.heap = heap_arena_heap(walk_arena);
+        status |= !run_one("arena", walk_loop, &walk, &cfg);
+    }
+
+    free(walk.starts);
+    heap_free(walk_heap);
+    heap_arena_destroy(walk_arena);
+    return status;
+}
\ No newline at end of file
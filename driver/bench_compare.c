@@ -0,0 +1,176 @@
+#include "bench_harness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Combine a baseline and an optimized bench JSON into the window.<var>
+   record consumed by viz/, benchmarks/bench_to_csv.py and slides/. */
+
+static void write_stats(const char* key, const BenchStats* st, FILE* f) {
+    fprintf(f, "    \"%s\": ", key);
+    bench_write_stats_json(st, f);
+}
+
+static void write_array(const char* key, const double* xs, int n, FILE* f) {
+    int i;
+    fprintf(f, "    \"%s\": [", key);
+    for (i = 0; i < n; ++i) {
+        fprintf(f, "%s%.6f", i ? ", " : "", xs[i]);
+    }
+    fprintf(f, "]");
+}
+
+static void write_side(const char* key, const BenchResult* res, FILE* f) {
+    double* times = (double*)malloc((size_t)(res->num_kept > 0 ? res->num_kept : 1) * sizeof(double));
+    BenchStats time_stats;
+    int first = 1;
+    int i;
+    int c;
+
+    for (i = 0; i < res->num_kept; ++i) {
+        times[i] = res->ns_per_iter[i] * (double)res->iters_per_sample;
+    }
+    bench_stats_compute(times, res->num_kept, &time_stats);
+
+    fprintf(f, "  \"%s\": {\n", key);
+    fprintf(f, "    \"iters_per_sample\": %llu,\n", (unsigned long long)res->iters_per_sample);
+    fprintf(f, "    \"rejected\": %d,\n", res->num_samples - res->num_kept);
+    write_array("times_ns", times, res->num_kept, f);
+    fprintf(f, ",\n");
+    write_array("ns_per_iter", res->ns_per_iter, res->num_kept, f);
+    fprintf(f, ",\n");
+    write_stats("stats_time_ns", &time_stats, f);
+    fprintf(f, ",\n");
+    write_stats("stats_ns_per_iter", &res->stats, f);
+    fprintf(f, ",\n    \"perf\": {");
+    for (c = 0; c < PERF_NUM_COUNTERS; ++c) {
+        if (res->perf_valid[c]) {
+            double v = res->perf_per_iter[c];
+            fprintf(f, "%s\"%s_per_iter\": {\"values\": [%.6f], \"stats\": {\"mean\": %.6f, \"median\": %.6f, "
+                       "\"min\": %.6f, \"max\": %.6f, \"stdev\": 0}}",
+                    first ? "" : ", ", perf_counter_name((PerfCounterId)c), v, v, v, v, v);
+            first = 0;
+        }
+    }
+    fprintf(f, "}\n  }");
+    free(times);
+}
+
+int main(int argc, char** argv) {
+    const char* base_path = NULL;
+    const char* opt_path = NULL;
+    const char* out_path = NULL;
+    const char* var = "BENCH_DATA";
+    int resamples = 10000;
+    double conf = 0.95;
+    unsigned seed = 1234;
+    long base_calls = 0;
+    long opt_calls = 0;
+    BenchResult base;
+    BenchResult opt;
+    BenchStats spd_stats;
+    double* speedups;
+    double lo;
+    double point;
+    double hi;
+    int n;
+    int i;
+    char stamp[64];
+    time_t now = time(NULL);
+    FILE* f = stdout;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--var") == 0 && i + 1 < argc) {
+            var = argv[++i];
+        } else if (strcmp(argv[i], "--resamples") == 0 && i + 1 < argc) {
+            resamples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--conf") == 0 && i + 1 < argc) {
+            conf = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--base_calls") == 0 && i + 1 < argc) {
+            base_calls = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--opt_calls") == 0 && i + 1 < argc) {
+            opt_calls = atol(argv[++i]);
+        } else if (!base_path) {
+            base_path = argv[i];
+        } else if (!opt_path) {
+            opt_path = argv[i];
+        }
+    }
+
+    if (!base_path || !opt_path) {
+        fprintf(stderr, "usage: bench_compare BASE.json OPT.json [--out PATH] [--var NAME] "
+                        "[--resamples N] [--conf C] [--base_calls N] [--opt_calls N]\n");
+        return 1;
+    }
+    if (!bench_read_json(base_path, &base)) {
+        fprintf(stderr, "failed to read %s\n", base_path);
+        return 1;
+    }
+    if (!bench_read_json(opt_path, &opt)) {
+        fprintf(stderr, "failed to read %s\n", opt_path);
+        bench_result_free(&base);
+        return 1;
+    }
+
+    /* Paired per-sample ratios for the sparkline; the CI is a bootstrap over
+       the two independent sample sets. */
+    n = base.num_kept < opt.num_kept ? base.num_kept : opt.num_kept;
+    speedups = (double*)malloc((size_t)(n > 0 ? n : 1) * sizeof(double));
+    if (!speedups) {
+        bench_result_free(&base);
+        bench_result_free(&opt);
+        return 1;
+    }
+    for (i = 0; i < n; ++i) {
+        speedups[i] = opt.ns_per_iter[i] > 0.0 ? base.ns_per_iter[i] / opt.ns_per_iter[i] : 0.0;
+    }
+    bench_stats_compute(speedups, n, &spd_stats);
+    bench_bootstrap_ratio(base.ns_per_iter, base.num_kept, opt.ns_per_iter, opt.num_kept,
+                          resamples, conf, seed, &lo, &point, &hi);
+
+    fprintf(stderr, "[%s] baseline median=%.3f ns/iter (mad %.3f, %d samples, %d rejected)\n",
+            var, base.stats.median, base.stats.mad, base.num_kept, base.num_samples - base.num_kept);
+    fprintf(stderr, "[%s] optimized median=%.3f ns/iter (mad %.3f, %d samples, %d rejected)\n",
+            var, opt.stats.median, opt.stats.mad, opt.num_kept, opt.num_samples - opt.num_kept);
+    fprintf(stderr, "[%s] speedup=%.3fx %.0f%% CI [%.3f, %.3f]\n", var, point, conf * 100.0, lo, hi);
+
+    if (out_path) {
+        f = fopen(out_path, "w");
+        if (!f) {
+            fprintf(stderr, "failed to write %s\n", out_path);
+            free(speedups);
+            bench_result_free(&base);
+            bench_result_free(&opt);
+            return 1;
+        }
+    }
+
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S %Z", localtime(&now));
+    fprintf(f, "window.%s = {\n", var);
+    fprintf(f, "  \"timestamp\": \"%s\",\n", stamp);
+    fprintf(f, "  \"config\": {\"iters\": %llu, \"runs\": %d, \"warmup\": %.0f, \"resamples\": %d, \"conf\": %.3f},\n",
+            (unsigned long long)base.iters_per_sample, base.num_samples, base.warmup_ms, resamples, conf);
+    fprintf(f, "  \"ir_call_count\": {\"baseline\": %ld, \"optimized\": %ld},\n", base_calls, opt_calls);
+    write_side("baseline", &base, f);
+    fprintf(f, ",\n");
+    write_side("optimized", &opt, f);
+    fprintf(f, ",\n  \"speedup\": {\n");
+    write_array("values", speedups, n, f);
+    fprintf(f, ",\n");
+    write_stats("stats", &spd_stats, f);
+    fprintf(f, ",\n    \"ci\": {\"point\": %.6f, \"lo\": %.6f, \"hi\": %.6f, \"conf\": %.3f}\n  }\n};\n",
+            point, lo, hi, conf);
+
+    if (f != stdout) {
+        fclose(f);
+    }
+    free(speedups);
+    bench_result_free(&base);
+    bench_result_free(&opt);
+    return 0;
+}
\ No newline at end of file
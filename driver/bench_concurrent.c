@@ -0,0 +1,328 @@
+#include "bench_harness.h"
+#include "concurrent_heap.h"
+#include "heap_gen.h"
+#include "kernels.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Readers chase root -> head -> mid -> MAGIC with triple_deref while
+   writers keep swapping in fresh head/mid pairs and freeing the old ones.
+
+   --mode stress checks that no reader ever sees a freed or reused object
+   (any result other than MAGIC is a failure). Readers load with acquire
+   ordering (conc_heap_load_ptr); --unsafe drops the read sections and
+   reads through the kernel's plain loads instead, which race with the
+   writers' atomic stores, so the check has something to catch. --mode
+   bench compares reader throughput on a plain Heap, on the concurrent heap
+   with no writers, and with writers running. */
+
+#define MAX_THREADS 64
+#define CACHE_LINE 64
+#define MAGIC 4242
+
+typedef struct {
+    uint64_t ops;
+    uint64_t failures;
+    char pad[CACHE_LINE - 2 * sizeof(uint64_t)];
+} PaddedCounters;
+
+typedef struct {
+    Heap* view;
+    ConcHeap* ch;
+    int tid;       /* epoch slot, or -1 to read without read sections */
+    int acquire;   /* conc_heap_load_ptr; 0: the kernel's plain loads */
+    int batch;
+    int num_roots;
+    int first_root;
+    int root_step; /* writers own roots first_root, first_root + step, ... */
+    unsigned seed;
+    PaddedCounters* counters;
+    volatile int* go;
+    volatile int* stop;
+} Worker;
+
+static Eval acquire_deref(ConcHeap* ch, int p) {
+    Eval v = ck_input("p", p);
+    v = conc_heap_load_ptr(ch, v);
+    v = conc_heap_load_ptr(ch, v);
+    return conc_heap_load_ptr(ch, v);
+}
+
+static void* reader_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    int root = w->first_root;
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) {
+    }
+    while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+        int k;
+        if (w->tid >= 0) {
+            conc_heap_enter(w->ch, w->tid);
+        }
+        for (k = 0; k < w->batch; ++k) {
+            Eval e = w->acquire ? acquire_deref(w->ch, VAL_PTR(root)) : triple_deref(w->view, VAL_PTR(root), VAL_NULL);
+            if (!e.ok || e.value != VAL_INT(MAGIC)) {
+                w->counters->failures++;
+            }
+            w->counters->ops++;
+            if (++root > w->num_roots) {
+                root = 1;
+            }
+        }
+        if (w->tid >= 0) {
+            conc_heap_exit(w->ch, w->tid);
+        }
+    }
+    return NULL;
+}
+
+/* Hang a fresh head -> mid -> MAGIC chain off `root` and free the old one. */
+static int swap_chain(ConcHeap* ch, int root) {
+    Heap* view = conc_heap_view(ch);
+    int head = conc_heap_alloc(ch);
+    int mid = conc_heap_alloc(ch);
+    int old_head = 0;
+    int old_mid = 0;
+    int value;
+
+    if (!head || !mid) {
+        if (head) {
+            conc_heap_release(ch, head);
+        }
+        if (mid) {
+            conc_heap_release(ch, mid);
+        }
+        return 0;
+    }
+    conc_heap_set_field(ch, mid, FIELD_DEREF, VAL_INT(MAGIC));
+    conc_heap_set_field(ch, head, FIELD_DEREF, VAL_PTR(mid));
+    /* this writer owns the root, so the old chain cannot change under it */
+    if (heap_get_field(heap_get_obj(view, root), FIELD_DEREF, &value) && VAL_IS_PTR(value)) {
+        old_head = VAL_PTR_ADDR(value);
+        if (heap_get_field(heap_get_obj(view, old_head), FIELD_DEREF, &value) && VAL_IS_PTR(value)) {
+            old_mid = VAL_PTR_ADDR(value);
+        }
+    }
+    conc_heap_set_field(ch, root, FIELD_DEREF, VAL_PTR(head));
+    if (old_head) {
+        conc_heap_release(ch, old_head);
+    }
+    if (old_mid) {
+        conc_heap_release(ch, old_mid);
+    }
+    return 1;
+}
+
+static void* writer_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    Rng rng;
+    int per_writer = (w->num_roots - w->first_root) / w->root_step + 1;
+    rng_seed(&rng, w->seed);
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) {
+    }
+    while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+        int root = w->first_root + w->root_step * rng_range(&rng, 0, per_writer - 1);
+        if (swap_chain(w->ch, root)) {
+            w->counters->ops++;
+        } else {
+            w->counters->failures++;
+            conc_heap_reclaim(w->ch);
+        }
+    }
+    return NULL;
+}
+
+static void sleep_ms(double ms) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+}
+
+typedef struct {
+    double reads_per_sec;
+    double writes_per_sec;
+    uint64_t read_failures;
+    uint64_t write_failures;
+} PhaseResult;
+
+/* Runs `readers` readers and `writers` writers for duration_ms. Reader t
+   uses epoch slot t when `sections` is set. */
+static int run_phase(Heap* view, ConcHeap* ch, int sections, int readers, int writers, int num_roots, int batch,
+                     int acquire, double duration_ms, PhaseResult* out) {
+    pthread_t tids[2 * MAX_THREADS];
+    Worker workers[2 * MAX_THREADS];
+    PaddedCounters* counters = (PaddedCounters*)calloc((size_t)(readers + writers), sizeof(PaddedCounters));
+    volatile int go = 0;
+    volatile int stop = 0;
+    uint64_t start;
+    uint64_t end;
+    int started = 0;
+    int t;
+
+    if (!counters) {
+        return 0;
+    }
+    memset(out, 0, sizeof(*out));
+    for (t = 0; t < readers + writers; ++t) {
+        Worker* w = &workers[t];
+        int is_reader = t < readers;
+        memset(w, 0, sizeof(*w));
+        w->view = view;
+        w->ch = ch;
+        w->tid = is_reader && sections ? t : -1;
+        w->acquire = acquire;
+        w->batch = batch;
+        w->num_roots = num_roots;
+        w->first_root = is_reader ? 1 + (int)((long long)num_roots * t / readers) : 1 + (t - readers);
+        w->root_step = writers;
+        w->seed = 1234u + (unsigned)t;
+        w->counters = &counters[t];
+        w->go = &go;
+        w->stop = &stop;
+        if (pthread_create(&tids[started], NULL, is_reader ? reader_main : writer_main, w) == 0) {
+            started++;
+        }
+    }
+
+    start = bench_now_ns();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    sleep_ms(duration_ms);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (t = 0; t < started; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+    end = bench_now_ns();
+
+    for (t = 0; t < started; ++t) {
+        double rate = (double)counters[t].ops * 1e9 / (double)(end - start);
+        if (t < readers) {
+            out->reads_per_sec += rate;
+            out->read_failures += counters[t].failures;
+        } else {
+            out->writes_per_sec += rate;
+            out->write_failures += counters[t].failures;
+        }
+    }
+    free(counters);
+    return started == readers + writers;
+}
+
+/* Roots are the first num_roots addresses, each already holding a chain. */
+static ConcHeap* build_heap(int capacity, int num_roots) {
+    ConcHeap* ch = conc_heap_create(capacity);
+    int r;
+    if (!ch) {
+        return NULL;
+    }
+    for (r = 1; r <= num_roots; ++r) {
+        if (conc_heap_alloc(ch) != r) {
+            conc_heap_free(ch);
+            return NULL;
+        }
+    }
+    for (r = 1; r <= num_roots; ++r) {
+        if (!swap_chain(ch, r)) {
+            conc_heap_free(ch);
+            return NULL;
+        }
+    }
+    return ch;
+}
+
+static void print_phase(const char* label, int readers, int writers, const PhaseResult* res) {
+    printf("%s readers=%d writers=%d reads_per_sec=%.0f per_reader=%.0f writes_per_sec=%.0f read_failures=%llu\n",
+           label, readers, writers, res->reads_per_sec, res->reads_per_sec / readers, res->writes_per_sec,
+           (unsigned long long)res->read_failures);
+}
+
+int main(int argc, char** argv) {
+    const char* mode = "stress";
+    int readers = 2;
+    int writers = 1;
+    int num_roots = 1024;
+    int capacity = 0;
+    int batch = 64;
+    int unsafe = 0;
+    double duration_ms = 1000.0;
+    ConcHeap* ch;
+    ConcHeapStats st;
+    PhaseResult res;
+    int status = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--writers") == 0 && i + 1 < argc) {
+            writers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--roots") == 0 && i + 1 < argc) {
+            num_roots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            capacity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration_ms") == 0 && i + 1 < argc) {
+            duration_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--unsafe") == 0) {
+            unsafe = 1;
+        }
+    }
+    if (readers < 1 || readers > CONC_HEAP_MAX_THREADS || writers < 1 || writers > MAX_THREADS || num_roots < writers || batch < 1) {
+        fprintf(stderr, "need 1..%d readers and writers, roots >= writers, batch >= 1\n", CONC_HEAP_MAX_THREADS);
+        return 1;
+    }
+    if (capacity <= 0) {
+        /* live chains plus room for the ones waiting on a grace period */
+        capacity = num_roots * 3 + 4096;
+    }
+
+    ch = build_heap(capacity, num_roots);
+    if (!ch) {
+        fprintf(stderr, "failed to build heap\n");
+        return 1;
+    }
+    for (i = 0; i < readers; ++i) {
+        conc_heap_register(ch);
+    }
+
+    if (strcmp(mode, "stress") == 0) {
+        if (!run_phase(conc_heap_view(ch), ch, !unsafe, readers, writers, num_roots, batch, !unsafe, duration_ms, &res)) {
+            status = 1;
+        }
+        conc_heap_stats(ch, &st);
+        print_phase(unsafe ? "stress(unsafe)" : "stress", readers, writers, &res);
+        printf("allocs=%llu frees=%llu reclaimed=%llu pending=%d epoch=%llu alloc_failures=%llu\n",
+               st.allocs, st.frees, st.reclaimed, st.pending, st.epoch, (unsigned long long)res.write_failures);
+        if (res.read_failures > 0) {
+            status = 1;
+        }
+    } else if (strcmp(mode, "bench") == 0) {
+        Heap* plain = heap_clone(conc_heap_view(ch));
+        if (!plain) {
+            status = 1;
+        }
+        if (status == 0 && run_phase(plain, ch, 0, readers, 0, num_roots, batch, 0, duration_ms, &res)) {
+            print_phase("plain", readers, 0, &res);
+        }
+        if (status == 0 && run_phase(conc_heap_view(ch), ch, !unsafe, readers, 0, num_roots, batch, !unsafe, duration_ms, &res)) {
+            print_phase("concurrent", readers, 0, &res);
+        }
+        if (status == 0 && run_phase(conc_heap_view(ch), ch, !unsafe, readers, writers, num_roots, batch, !unsafe, duration_ms, &res)) {
+            print_phase("concurrent", readers, writers, &res);
+            status = res.read_failures > 0;
+        }
+        heap_free(plain);
+    } else {
+        fprintf(stderr, "unknown mode %s (stress, bench)\n", mode);
+        status = 1;
+    }
+
+    conc_heap_free(ch);
+    return status;
+}
\ No newline at end of file
@@ -1,25 +1,13 @@
 #include "checked_ptr.h"
 #include "heap_gen.h"
+#include "bench_harness.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
 Eval graph_walk(Heap* heap, int p, int q);
 
-static uint64_t now_ns(void) {
-#if defined(CLOCK_MONOTONIC_RAW)
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
-#else
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
-#endif
-}
-
 static Heap* build_chain_heap(int len) {
     Heap* heap = heap_create(len);
     if (!heap) {
@@ -46,54 +34,84 @@ static Heap* build_chain_heap(int len) {
     return heap;
 }
 
+typedef struct {
+    Heap* heap;
+    int p;
+} LoopCtx;
+
+/* The timed loop; heap and p are loaded once so the calls stay loop-invariant. */
+static uint64_t run_loop(void* arg, uint64_t iters) {
+    const LoopCtx* ctx = (const LoopCtx*)arg;
+    Heap* heap = ctx->heap;
+    int p = ctx->p;
+    volatile uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        Eval e = graph_walk(heap, p, VAL_NULL);
+        sink += (uint64_t)e.value;
+    }
+    return sink;
+}
+
 int main(int argc, char** argv) {
-    uint64_t iters = 10000000ull;
+    BenchConfig cfg;
+    BenchResult res;
+    LoopCtx ctx;
     int len = 6;
     int i;
     Heap* heap;
-    int p;
-    volatile uint64_t sink = 0;
-    uint64_t start;
-    uint64_t end;
+    int use_shape = 0;
+    HeapShape shape = HEAP_SHAPE_LIST;
+    int fields[1] = {FIELD_DEREF};
+    int objs = 1024;
+    unsigned seed = 1234;
+
+    bench_config_default(&cfg);
 
     for (i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
-            iters = (uint64_t)strtoull(argv[++i], NULL, 10);
+        if (bench_parse_arg(&cfg, argc, argv, &i)) {
+            continue;
         } else if (strcmp(argv[i], "--len") == 0 && i + 1 < argc) {
             len = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shape") == 0 && i + 1 < argc) {
+            if (!heap_shape_parse(argv[++i], &shape)) {
+                fprintf(stderr, "unknown shape %s\n", argv[i]);
+                return 1;
+            }
+            use_shape = 1;
+        } else if (strcmp(argv[i], "--objs") == 0 && i + 1 < argc) {
+            objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
         }
     }
 
-    if (len < 5) {
+    if (!use_shape && len < 5) {
         fprintf(stderr, "len must be >= 5\n");
         return 1;
     }
 
-    heap = build_chain_heap(len);
+    if (use_shape && objs < 1) {
+        fprintf(stderr, "objs must be >= 1\n");
+        return 1;
+    }
+
+    heap = use_shape ? heap_create_shaped(objs, shape, fields, 1, seed) : build_chain_heap(len);
     if (!heap) {
         fprintf(stderr, "failed to build heap\n");
         return 1;
     }
 
-    p = VAL_PTR(1);
-
-    for (i = 0; i < 1000; ++i) {
-        Eval e = graph_walk(heap, p, VAL_NULL);
-        sink += (uint64_t)e.value;
-    }
+    ctx.heap = heap;
+    ctx.p = VAL_PTR(1);
 
-    start = now_ns();
-    for (uint64_t k = 0; k < iters; ++k) {
-        Eval e = graph_walk(heap, p, VAL_NULL);
-        sink += (uint64_t)e.value;
+    if (!bench_run("graph_walk", run_loop, &ctx, &cfg, &res)) {
+        fprintf(stderr, "benchmark failed\n");
+        heap_free(heap);
+        return 1;
     }
-    end = now_ns();
-
-    printf("iters=%llu time_ns=%llu sink=%llu\n",
-           (unsigned long long)iters,
-           (unsigned long long)(end - start),
-           (unsigned long long)sink);
+    bench_report(&res, &cfg, stdout);
 
+    bench_result_free(&res);
     heap_free(heap);
     return 0;
-}
+}
\ No newline at end of file
@@ -0,0 +1,541 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "bench_harness.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#define MIN_SAMPLE_ITERS 16ull
+
+void bench_config_default(BenchConfig* cfg) {
+    if (!cfg) {
+        return;
+    }
+    cfg->samples = 50;
+    cfg->warmup_ms = 200.0;
+    cfg->sample_ms = 20.0;
+    cfg->iters = 0;
+    cfg->cpu = -1;
+    cfg->use_perf = 0;
+    cfg->outlier_mads = 5.0;
+    cfg->json_path = NULL;
+}
+
+int bench_parse_arg(BenchConfig* cfg, int argc, char** argv, int* i) {
+    const char* arg = argv[*i];
+    int has_value = *i + 1 < argc;
+
+    if (strcmp(arg, "--perf") == 0) {
+        cfg->use_perf = 1;
+        return 1;
+    }
+    if (!has_value) {
+        return 0;
+    }
+    if (strcmp(arg, "--samples") == 0) {
+        cfg->samples = atoi(argv[++*i]);
+    } else if (strcmp(arg, "--warmup_ms") == 0) {
+        cfg->warmup_ms = atof(argv[++*i]);
+    } else if (strcmp(arg, "--sample_ms") == 0) {
+        cfg->sample_ms = atof(argv[++*i]);
+    } else if (strcmp(arg, "--iters") == 0) {
+        cfg->iters = (uint64_t)strtoull(argv[++*i], NULL, 10);
+    } else if (strcmp(arg, "--cpu") == 0) {
+        cfg->cpu = atoi(argv[++*i]);
+    } else if (strcmp(arg, "--outlier_mads") == 0) {
+        cfg->outlier_mads = atof(argv[++*i]);
+    } else if (strcmp(arg, "--json") == 0) {
+        cfg->json_path = argv[++*i];
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC_RAW)
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int bench_pin_cpu(int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return 0;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return 0;
+#endif
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Linear interpolation between closest ranks; xs must be sorted. */
+static double percentile_sorted(const double* xs, int n, double pct) {
+    double pos;
+    int lo;
+    if (n <= 0) {
+        return 0.0;
+    }
+    pos = pct / 100.0 * (double)(n - 1);
+    lo = (int)pos;
+    if (lo >= n - 1) {
+        return xs[n - 1];
+    }
+    return xs[lo] + (pos - (double)lo) * (xs[lo + 1] - xs[lo]);
+}
+
+static double median_of(const double* xs, int n, double* scratch) {
+    memcpy(scratch, xs, (size_t)n * sizeof(double));
+    qsort(scratch, (size_t)n, sizeof(double), cmp_double);
+    return percentile_sorted(scratch, n, 50.0);
+}
+
+void bench_stats_compute(const double* xs, int n, BenchStats* st) {
+    double* sorted;
+    double sum = 0.0;
+    double ss = 0.0;
+    int i;
+
+    memset(st, 0, sizeof(*st));
+    if (!xs || n <= 0) {
+        return;
+    }
+    sorted = (double*)malloc((size_t)n * sizeof(double));
+    if (!sorted) {
+        return;
+    }
+    memcpy(sorted, xs, (size_t)n * sizeof(double));
+    qsort(sorted, (size_t)n, sizeof(double), cmp_double);
+
+    for (i = 0; i < n; ++i) {
+        sum += sorted[i];
+    }
+    st->n = n;
+    st->mean = sum / n;
+    for (i = 0; i < n; ++i) {
+        double d = sorted[i] - st->mean;
+        ss += d * d;
+    }
+    st->stdev = sqrt(ss / n);
+    st->min = sorted[0];
+    st->max = sorted[n - 1];
+    st->median = percentile_sorted(sorted, n, 50.0);
+    st->p5 = percentile_sorted(sorted, n, 5.0);
+    st->p25 = percentile_sorted(sorted, n, 25.0);
+    st->p75 = percentile_sorted(sorted, n, 75.0);
+    st->p95 = percentile_sorted(sorted, n, 95.0);
+
+    for (i = 0; i < n; ++i) {
+        sorted[i] = fabs(xs[i] - st->median);
+    }
+    qsort(sorted, (size_t)n, sizeof(double), cmp_double);
+    st->mad = percentile_sorted(sorted, n, 50.0);
+    free(sorted);
+}
+
+int bench_reject_outliers(double* xs, int n, double k) {
+    BenchStats st;
+    double limit;
+    int kept = 0;
+    int i;
+
+    if (!xs || n <= 2 || k <= 0.0) {
+        return n;
+    }
+    bench_stats_compute(xs, n, &st);
+    if (st.mad <= 0.0) {
+        return n;
+    }
+    /* 1.4826 scales the MAD to a standard deviation for normal data */
+    limit = k * 1.4826 * st.mad;
+    for (i = 0; i < n; ++i) {
+        if (fabs(xs[i] - st.median) <= limit) {
+            xs[kept++] = xs[i];
+        }
+    }
+    return kept;
+}
+
+static uint64_t xorshift64(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return x;
+}
+
+static void resample(const double* xs, int n, double* out, uint64_t* s) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        out[i] = xs[xorshift64(s) % (uint64_t)n];
+    }
+}
+
+void bench_bootstrap_ratio(const double* num, int n_num, const double* den, int n_den,
+                           int resamples, double conf, unsigned seed,
+                           double* lo, double* point, double* hi) {
+    double* a;
+    double* b;
+    double* scratch;
+    double* ratios;
+    uint64_t s = ((uint64_t)seed << 1) | 1ull;
+    int max_n = n_num > n_den ? n_num : n_den;
+    int kept = 0;
+    int r;
+
+    *lo = *point = *hi = 0.0;
+    if (!num || !den || n_num <= 0 || n_den <= 0) {
+        return;
+    }
+    if (resamples < 1) {
+        resamples = 1;
+    }
+    a = (double*)malloc((size_t)n_num * sizeof(double));
+    b = (double*)malloc((size_t)n_den * sizeof(double));
+    scratch = (double*)malloc((size_t)max_n * sizeof(double));
+    ratios = (double*)malloc((size_t)resamples * sizeof(double));
+    if (!a || !b || !scratch || !ratios) {
+        free(a);
+        free(b);
+        free(scratch);
+        free(ratios);
+        return;
+    }
+
+    {
+        double md = median_of(den, n_den, scratch);
+        if (md > 0.0) {
+            *point = median_of(num, n_num, scratch) / md;
+        }
+    }
+
+    for (r = 0; r < resamples; ++r) {
+        double md;
+        resample(num, n_num, a, &s);
+        resample(den, n_den, b, &s);
+        md = median_of(b, n_den, scratch);
+        if (md > 0.0) {
+            ratios[kept++] = median_of(a, n_num, scratch) / md;
+        }
+    }
+
+    if (kept > 0) {
+        double tail = (1.0 - conf) / 2.0 * 100.0;
+        qsort(ratios, (size_t)kept, sizeof(double), cmp_double);
+        *lo = percentile_sorted(ratios, kept, tail);
+        *hi = percentile_sorted(ratios, kept, 100.0 - tail);
+    }
+
+    free(a);
+    free(b);
+    free(scratch);
+    free(ratios);
+}
+
+/* Grow the per-sample iteration count until one sample takes about
+   cfg->sample_ms. */
+static uint64_t calibrate(BenchBodyFn body, void* ctx, double sample_ms, uint64_t* sink) {
+    uint64_t iters = MIN_SAMPLE_ITERS;
+    double target_ns = sample_ms * 1e6;
+
+    for (;;) {
+        uint64_t start = bench_now_ns();
+        uint64_t elapsed;
+        *sink += body(ctx, iters);
+        elapsed = bench_now_ns() - start;
+        if (elapsed >= (uint64_t)(target_ns / 8.0) || iters >= (1ull << 40)) {
+            double scaled = elapsed > 0 ? (double)iters * target_ns / (double)elapsed : (double)iters;
+            return scaled < (double)MIN_SAMPLE_ITERS ? MIN_SAMPLE_ITERS : (uint64_t)scaled;
+        }
+        iters *= 2;
+    }
+}
+
+int bench_run(const char* name, BenchBodyFn body, void* ctx, const BenchConfig* cfg, BenchResult* out) {
+    PerfCounters pc;
+    unsigned long long perf_sum[PERF_NUM_COUNTERS];
+    int perf_samples[PERF_NUM_COUNTERS];
+    uint64_t sink = 0;
+    uint64_t warm_end;
+    int i;
+    int c;
+
+    if (!body || !cfg || !out || cfg->samples < 1) {
+        return 0;
+    }
+    memset(out, 0, sizeof(*out));
+    strncpy(out->name, name ? name : "bench", sizeof(out->name) - 1);
+    out->ns_per_iter = (double*)calloc((size_t)cfg->samples, sizeof(double));
+    if (!out->ns_per_iter) {
+        return 0;
+    }
+
+    if (cfg->cpu >= 0 && !bench_pin_cpu(cfg->cpu)) {
+        fprintf(stderr, "could not pin to cpu %d\n", cfg->cpu);
+    }
+
+    out->iters_per_sample = cfg->iters > 0 ? cfg->iters : calibrate(body, ctx, cfg->sample_ms, &sink);
+
+    warm_end = bench_now_ns() + (uint64_t)(cfg->warmup_ms * 1e6);
+    do {
+        sink += body(ctx, out->iters_per_sample);
+    } while (bench_now_ns() < warm_end);
+
+    memset(&pc, 0, sizeof(pc));
+    memset(perf_sum, 0, sizeof(perf_sum));
+    memset(perf_samples, 0, sizeof(perf_samples));
+    if (cfg->use_perf && !perf_counters_open(&pc)) {
+        fprintf(stderr, "perf counters unavailable, reporting time only\n");
+    }
+
+    for (i = 0; i < cfg->samples; ++i) {
+        uint64_t start;
+        uint64_t end;
+        start = bench_now_ns();
+        perf_counters_start(&pc);
+        sink += body(ctx, out->iters_per_sample);
+        perf_counters_stop(&pc);
+        end = bench_now_ns();
+        out->ns_per_iter[i] = (double)(end - start) / (double)out->iters_per_sample;
+        for (c = 0; c < PERF_NUM_COUNTERS; ++c) {
+            if (pc.valid[c]) {
+                perf_sum[c] += pc.values[c];
+                perf_samples[c]++;
+            }
+        }
+    }
+    perf_counters_close(&pc);
+
+    for (c = 0; c < PERF_NUM_COUNTERS; ++c) {
+        if (perf_samples[c] > 0) {
+            out->perf_valid[c] = 1;
+            out->perf_per_iter[c] = (double)perf_sum[c] /
+                ((double)perf_samples[c] * (double)out->iters_per_sample);
+        }
+    }
+
+    out->num_samples = cfg->samples;
+    out->num_kept = bench_reject_outliers(out->ns_per_iter, cfg->samples, cfg->outlier_mads);
+    bench_stats_compute(out->ns_per_iter, out->num_kept, &out->stats);
+    out->sink = sink;
+    out->warmup_ms = cfg->warmup_ms;
+    return 1;
+}
+
+void bench_result_free(BenchResult* res) {
+    if (!res) {
+        return;
+    }
+    free(res->ns_per_iter);
+    res->ns_per_iter = NULL;
+    res->num_kept = 0;
+}
+
+void bench_report(const BenchResult* res, const BenchConfig* cfg, FILE* f) {
+    double total_ns = 0.0;
+    int i;
+    int c;
+
+    for (i = 0; i < res->num_kept; ++i) {
+        total_ns += res->ns_per_iter[i] * (double)res->iters_per_sample;
+    }
+    fprintf(f, "iters=%llu time_ns=%llu sink=%llu ns_per_iter_median=%.3f mad=%.3f samples=%d rejected=%d",
+            (unsigned long long)(res->iters_per_sample * (uint64_t)res->num_kept),
+            (unsigned long long)total_ns,
+            (unsigned long long)res->sink,
+            res->stats.median,
+            res->stats.mad,
+            res->num_kept,
+            res->num_samples - res->num_kept);
+    for (c = 0; c < PERF_NUM_COUNTERS; ++c) {
+        if (res->perf_valid[c]) {
+            fprintf(f, " %s_per_iter=%.4f", perf_counter_name((PerfCounterId)c), res->perf_per_iter[c]);
+        }
+    }
+    fprintf(f, "\n");
+
+    if (cfg && cfg->json_path) {
+        if (strcmp(cfg->json_path, "-") == 0) {
+            bench_write_json(res, cfg, f);
+        } else {
+            FILE* jf = fopen(cfg->json_path, "w");
+            if (!jf) {
+                fprintf(stderr, "failed to write %s\n", cfg->json_path);
+                return;
+            }
+            bench_write_json(res, cfg, jf);
+            fclose(jf);
+        }
+    }
+}
+
+void bench_write_stats_json(const BenchStats* st, FILE* f) {
+    fprintf(f, "{\"n\": %d, \"mean\": %.6f, \"median\": %.6f, \"min\": %.6f, \"max\": %.6f, "
+               "\"stdev\": %.6f, \"mad\": %.6f, \"p5\": %.6f, \"p25\": %.6f, \"p75\": %.6f, \"p95\": %.6f}",
+            st->n, st->mean, st->median, st->min, st->max, st->stdev, st->mad,
+            st->p5, st->p25, st->p75, st->p95);
+}
+
+void bench_write_json(const BenchResult* res, const BenchConfig* cfg, FILE* f) {
+    int i;
+    int c;
+    int first = 1;
+
+    fprintf(f, "{\n  \"name\": \"%s\",\n", res->name);
+    fprintf(f, "  \"config\": {\"samples\": %d, \"warmup_ms\": %.3f, \"sample_ms\": %.3f, "
+               "\"cpu\": %d, \"outlier_mads\": %.3f},\n",
+            cfg->samples, cfg->warmup_ms, cfg->sample_ms, cfg->cpu, cfg->outlier_mads);
+    fprintf(f, "  \"iters_per_sample\": %llu,\n", (unsigned long long)res->iters_per_sample);
+    fprintf(f, "  \"rejected\": %d,\n", res->num_samples - res->num_kept);
+    fprintf(f, "  \"sink\": %llu,\n", (unsigned long long)res->sink);
+    fprintf(f, "  \"ns_per_iter\": [");
+    for (i = 0; i < res->num_kept; ++i) {
+        fprintf(f, "%s%.6f", i ? ", " : "", res->ns_per_iter[i]);
+    }
+    fprintf(f, "],\n  \"stats_ns_per_iter\": ");
+    bench_write_stats_json(&res->stats, f);
+    fprintf(f, ",\n  \"perf\": {");
+    for (c = 0; c < PERF_NUM_COUNTERS; ++c) {
+        if (res->perf_valid[c]) {
+            fprintf(f, "%s\"%s_per_iter\": %.6f", first ? "" : ", ",
+                    perf_counter_name((PerfCounterId)c), res->perf_per_iter[c]);
+            first = 0;
+        }
+    }
+    fprintf(f, "}\n}\n");
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    char* buf;
+    long len;
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = (len >= 0) ? (char*)malloc((size_t)len + 1) : NULL;
+    if (!buf || fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    buf[len] = '\0';
+    fclose(f);
+    return buf;
+}
+
+/* Position just past `"key":`, or NULL. Keys written by bench_write_json are unique. */
+static const char* find_key(const char* buf, const char* key) {
+    char pattern[96];
+    const char* p;
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    p = strstr(buf, pattern);
+    if (!p) {
+        return NULL;
+    }
+    p = strchr(p + strlen(pattern), ':');
+    return p ? p + 1 : NULL;
+}
+
+int bench_read_json(const char* path, BenchResult* out) {
+    char* buf = read_file(path);
+    const char* p;
+    int cap = 64;
+    int c;
+
+    if (!buf || !out) {
+        free(buf);
+        return 0;
+    }
+    memset(out, 0, sizeof(*out));
+
+    p = find_key(buf, "name");
+    if (p && (p = strchr(p, '"')) != NULL) {
+        const char* end = strchr(p + 1, '"');
+        size_t n = end ? (size_t)(end - p - 1) : 0;
+        if (n >= sizeof(out->name)) {
+            n = sizeof(out->name) - 1;
+        }
+        memcpy(out->name, p + 1, n);
+    }
+    p = find_key(buf, "iters_per_sample");
+    out->iters_per_sample = p ? (uint64_t)strtoull(p, NULL, 10) : 0;
+    p = find_key(buf, "sink");
+    out->sink = p ? (uint64_t)strtoull(p, NULL, 10) : 0;
+    p = find_key(buf, "warmup_ms");
+    out->warmup_ms = p ? strtod(p, NULL) : 0.0;
+
+    p = find_key(buf, "ns_per_iter");
+    p = p ? strchr(p, '[') : NULL;
+    out->ns_per_iter = (double*)malloc((size_t)cap * sizeof(double));
+    if (!p || !out->ns_per_iter) {
+        free(out->ns_per_iter);
+        out->ns_per_iter = NULL;
+        free(buf);
+        return 0;
+    }
+    ++p;
+    for (;;) {
+        char* end;
+        double v;
+        while (*p == ' ' || *p == ',' || *p == '\n') {
+            ++p;
+        }
+        if (*p == ']' || *p == '\0') {
+            break;
+        }
+        v = strtod(p, &end);
+        if (end == p) {
+            break;
+        }
+        if (out->num_kept == cap) {
+            double* grown = (double*)realloc(out->ns_per_iter, (size_t)cap * 2 * sizeof(double));
+            if (!grown) {
+                break;
+            }
+            out->ns_per_iter = grown;
+            cap *= 2;
+        }
+        out->ns_per_iter[out->num_kept++] = v;
+        p = end;
+    }
+
+    p = find_key(buf, "rejected");
+    out->num_samples = out->num_kept + (p ? atoi(p) : 0);
+    for (c = 0; c < PERF_NUM_COUNTERS; ++c) {
+        char key[64];
+        snprintf(key, sizeof(key), "%s_per_iter", perf_counter_name((PerfCounterId)c));
+        p = find_key(buf, key);
+        if (p) {
+            out->perf_valid[c] = 1;
+            out->perf_per_iter[c] = strtod(p, NULL);
+        }
+    }
+    bench_stats_compute(out->ns_per_iter, out->num_kept, &out->stats);
+    free(buf);
+    return out->num_kept > 0;
+}
\ No newline at end of file
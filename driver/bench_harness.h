@@ -0,0 +1,89 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include "perf_counters.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Runs the timed loop `iters` times and returns a value derived from the
+   results so the work cannot be dropped. Keep the loop itself in the bench
+   source so the LLVM passes see it. */
+typedef uint64_t (*BenchBodyFn)(void* ctx, uint64_t iters);
+
+typedef struct {
+    int samples;           /* timed samples to collect */
+    double warmup_ms;      /* untimed warmup before sampling */
+    double sample_ms;      /* calibration target per sample */
+    uint64_t iters;        /* fixed iterations per sample; 0 = calibrate */
+    int cpu;               /* pin the thread to this CPU; -1 = leave as is */
+    int use_perf;          /* read perf counters around every sample */
+    double outlier_mads;   /* drop samples beyond k scaled MADs of the median; 0 = keep all */
+    const char* json_path; /* write the result as JSON here ("-" = stdout) */
+} BenchConfig;
+
+typedef struct {
+    int n;
+    double mean;
+    double median;
+    double min;
+    double max;
+    double stdev;
+    double mad; /* median absolute deviation, unscaled */
+    double p5;
+    double p25;
+    double p75;
+    double p95;
+} BenchStats;
+
+typedef struct {
+    char name[64];
+    uint64_t iters_per_sample;
+    int num_samples;    /* collected */
+    int num_kept;       /* after outlier rejection */
+    double* ns_per_iter; /* kept samples, in collection order */
+    BenchStats stats;
+    uint64_t sink;
+    double warmup_ms;
+    double perf_per_iter[PERF_NUM_COUNTERS];
+    int perf_valid[PERF_NUM_COUNTERS];
+} BenchResult;
+
+void bench_config_default(BenchConfig* cfg);
+/* Consume a harness flag at argv[*i] (advancing *i past its value).
+   Returns 1 if it was one of: --samples --warmup_ms --sample_ms --iters
+   --cpu --perf --outlier_mads --json. */
+int bench_parse_arg(BenchConfig* cfg, int argc, char** argv, int* i);
+
+uint64_t bench_now_ns(void);
+int bench_pin_cpu(int cpu);
+
+/* Warm up, calibrate, sample, reject outliers and summarize. Returns 0 on failure. */
+int bench_run(const char* name, BenchBodyFn body, void* ctx, const BenchConfig* cfg, BenchResult* out);
+void bench_result_free(BenchResult* res);
+
+/* Print the one-line summary (legacy iters=/time_ns= keys first) and write
+   JSON when cfg->json_path is set. */
+void bench_report(const BenchResult* res, const BenchConfig* cfg, FILE* f);
+void bench_write_json(const BenchResult* res, const BenchConfig* cfg, FILE* f);
+/* A BenchStats as a single-line JSON object. */
+void bench_write_stats_json(const BenchStats* st, FILE* f);
+/* Read back the samples and perf values written by bench_write_json. */
+int bench_read_json(const char* path, BenchResult* out);
+
+void bench_stats_compute(const double* xs, int n, BenchStats* st);
+/* Compacts xs in place; returns the number kept. */
+int bench_reject_outliers(double* xs, int n, double k);
+/* Percentile bootstrap CI for median(num) / median(den). */
+void bench_bootstrap_ratio(const double* num, int n_num, const double* den, int n_den,
+                           int resamples, double conf, unsigned seed,
+                           double* lo, double* point, double* hi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
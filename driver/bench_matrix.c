@@ -0,0 +1,414 @@
+#include "bench_harness.h"
+#include "checked_ptr.h"
+#include "graph_compile.h"
+#include "graph_eval.h"
+#include "heap_gen.h"
+#include "heap_stats.h"
+#include "kernels.h"
+#include "manifest.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every kernel in programs/kernels.c timed as the native C kernel, the
+   interpreted graph and the compiled graph on a heap picked per kernel.
+   run_bench.sh builds a second copy through CollapseDerefsPass and runs its
+   native form with --native_label collapsed to fill the fourth column. */
+
+typedef struct {
+    Heap* heap;
+    Env env;
+    const Graph* graph;
+    const CompiledGraph* cg;
+    Eval* nodes;
+    unsigned char* seen;
+    Eval* slots;
+} MatrixCtx;
+
+/* One direct call per kernel so CollapseDerefsPass can see it. */
+#define NATIVE_LOOP(fn)                                                   \
+    static uint64_t native_##fn(void* arg, uint64_t iters) {              \
+        const MatrixCtx* ctx = (const MatrixCtx*)arg;                     \
+        Heap* heap = ctx->heap;                                           \
+        int p = ctx->env.p;                                               \
+        int q = ctx->env.q;                                               \
+        volatile uint64_t sink = 0;                                       \
+        for (uint64_t k = 0; k < iters; ++k) {                            \
+            Eval e = fn(heap, p, q);                                      \
+            sink += (uint64_t)e.value;                                    \
+        }                                                                 \
+        return sink;                                                      \
+    }
+
+NATIVE_LOOP(triple_deref)
+NATIVE_LOOP(triple_deref_spec)
+NATIVE_LOOP(graph_walk)
+NATIVE_LOOP(field_chain)
+NATIVE_LOOP(guarded_chain)
+NATIVE_LOOP(alias_branch)
+NATIVE_LOOP(mixed_fields)
+NATIVE_LOOP(add_two)
+NATIVE_LOOP(branch_chain)
+NATIVE_LOOP(bounded_walk)
+NATIVE_LOOP(deep_walk)
+
+static uint64_t interp_loop(void* arg, uint64_t iters) {
+    const MatrixCtx* ctx = (const MatrixCtx*)arg;
+    volatile uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        Eval e = graph_eval_trace(ctx->graph, ctx->heap, &ctx->env, ctx->nodes, ctx->seen);
+        sink += (uint64_t)e.value;
+    }
+    return sink;
+}
+
+static uint64_t compiled_loop(void* arg, uint64_t iters) {
+    const MatrixCtx* ctx = (const MatrixCtx*)arg;
+    volatile uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        Eval e = compiled_graph_eval(ctx->cg, ctx->heap, &ctx->env, ctx->slots);
+        sink += (uint64_t)e.value;
+    }
+    return sink;
+}
+
+typedef struct {
+    const char* name;
+    KernelFn fn;
+    BenchBodyFn native;
+    int fields[MAX_FIELDS];
+    int num_fields;
+    int use_q;
+    HeapShape shape;
+    int null_pct; /* -1 keeps the shape preset */
+    int int_pct;  /* -1 keeps the shape preset */
+} MatrixKernel;
+
+/* Heaps follow what each kernel walks: pointer chains for the deref
+   kernels, trees for the F/G field kernels, a shared DAG for the aliasing
+   kernel, int-heavy cells for add_two and an all-pointer F ring for the 64
+   hops of deep_walk. */
+static const MatrixKernel matrix_kernels[] = {
+    {"triple_deref", triple_deref, native_triple_deref, {FIELD_DEREF}, 1, 0, HEAP_SHAPE_LIST, -1, -1},
+    {"triple_deref_spec", triple_deref_spec, native_triple_deref_spec, {FIELD_DEREF}, 1, 0, HEAP_SHAPE_LIST, -1, -1},
+    {"graph_walk", graph_walk, native_graph_walk, {FIELD_DEREF}, 1, 0, HEAP_SHAPE_LIST, -1, -1},
+    {"field_chain", field_chain, native_field_chain, {FIELD_F, FIELD_G, FIELD_DEREF}, 3, 0, HEAP_SHAPE_TREE, -1, -1},
+    {"guarded_chain", guarded_chain, native_guarded_chain, {FIELD_DEREF}, 1, 0, HEAP_SHAPE_LIST, -1, -1},
+    {"alias_branch", alias_branch, native_alias_branch, {FIELD_DEREF}, 1, 1, HEAP_SHAPE_DAG, -1, -1},
+    {"mixed_fields", mixed_fields, native_mixed_fields, {FIELD_F, FIELD_G, FIELD_DEREF}, 3, 0, HEAP_SHAPE_TREE, -1, -1},
+    {"add_two", add_two, native_add_two, {FIELD_DEREF}, 1, 1, HEAP_SHAPE_UNIFORM, -1, 60},
+    {"branch_chain", branch_chain, native_branch_chain, {FIELD_DEREF}, 1, 0, HEAP_SHAPE_LIST, -1, -1},
+    {"bounded_walk", bounded_walk, native_bounded_walk, {FIELD_DEREF}, 1, 0, HEAP_SHAPE_LIST, -1, -1},
+    {"deep_walk", deep_walk, native_deep_walk, {FIELD_F}, 1, 0, HEAP_SHAPE_CYCLE, 0, 0},
+};
+
+/* Every kernel the guarded-graph pass lists in graph_dir/manifest.json
+   needs a row above (and its NATIVE_LOOP), or the matrix would silently
+   leave it out. A missing manifest is not checked. */
+static int check_manifest(const char* graph_dir) {
+    char path[512];
+    Manifest* manifest;
+    int num_kernels = (int)(sizeof(matrix_kernels) / sizeof(matrix_kernels[0]));
+    int ok = 1;
+    int i;
+    int j;
+    snprintf(path, sizeof(path), "%s/manifest.json", graph_dir);
+    manifest = manifest_load_json(path);
+    if (!manifest) {
+        return 1;
+    }
+    for (i = 0; i < manifest->num_kernels; ++i) {
+        for (j = 0; j < num_kernels && strcmp(matrix_kernels[j].name, manifest->kernels[i].name) != 0; ++j) {
+        }
+        if (j == num_kernels) {
+            fprintf(stderr, "%s is in %s but has no matrix row\n", manifest->kernels[i].name, path);
+            ok = 0;
+        }
+    }
+    manifest_free(manifest);
+    return ok;
+}
+
+static const char* const outcome_names[5] = {"ok", "null", "invalid", "type", "missing_field"};
+
+static const char* outcome_name(Eval e) {
+    if (e.ok) {
+        return "ok";
+    }
+    return ((int)e.err > 0 && (int)e.err < 5) ? outcome_names[e.err] : "error";
+}
+
+static Heap* generate_heap(const MatrixKernel* mk, int objs, unsigned seed) {
+    HeapGenConfig cfg;
+    Rng rng;
+    Heap* heap = heap_create(objs);
+    if (!heap) {
+        return NULL;
+    }
+    heap_gen_config_default(&cfg, mk->shape);
+    if (mk->null_pct >= 0) {
+        cfg.null_pct = mk->null_pct;
+    }
+    if (mk->int_pct >= 0) {
+        cfg.int_pct = mk->int_pct;
+    }
+    rng_seed(&rng, seed);
+    if (!heap_generate(heap, mk->fields, mk->num_fields, &cfg, &rng)) {
+        heap_free(heap);
+        return NULL;
+    }
+    return heap;
+}
+
+/* First seed from `seed` whose heap takes the kernel's success path, so
+   the timed loop measures the full chain rather than an early error. */
+static Heap* pick_heap(const MatrixKernel* mk, const Env* env, int objs, unsigned* seed) {
+    unsigned s;
+    for (s = *seed; s < *seed + 256; ++s) {
+        Heap* heap = generate_heap(mk, objs, s);
+        if (!heap) {
+            return NULL;
+        }
+        if (mk->fn(heap, env->p, env->q).ok) {
+            *seed = s;
+            return heap;
+        }
+        heap_free(heap);
+    }
+    return generate_heap(mk, objs, *seed);
+}
+
+/* The compiled program must agree with the interpreter before its timing
+   means anything. */
+static int check_compiled(const MatrixKernel* mk, MatrixCtx* ctx, int objs, int trials, unsigned seed,
+                          int trusted) {
+    Rng rng;
+    int t;
+    rng_seed(&rng, seed ^ 0x5bd1e995u);
+    for (t = 0; t < trials; ++t) {
+        Heap* heap = generate_heap(mk, objs, seed + (unsigned)t);
+        Env env;
+        Eval a;
+        Eval b;
+        if (!heap) {
+            return 0;
+        }
+        env_randomize(&env, objs, &rng, 1, mk->use_q);
+        if (trusted) {
+            int inputs[2];
+            inputs[0] = env.p;
+            inputs[1] = env.q;
+            heap_trust(heap, 1, inputs, 2);
+        }
+        a = graph_eval_trace(ctx->graph, heap, &env, ctx->nodes, ctx->seen);
+        b = compiled_graph_eval(ctx->cg, heap, &env, ctx->slots);
+        heap_free(heap);
+        if (a.ok != b.ok || (a.ok ? a.value != b.value : a.err != b.err)) {
+            fprintf(stderr, "%s: compiled graph disagrees with graph_eval on trial %d\n", mk->name, t);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int list_has(const char* list, const char* name) {
+    size_t n = strlen(name);
+    const char* p = list;
+    if (!list) {
+        return 1;
+    }
+    while ((p = strstr(p, name)) != NULL) {
+        int starts = p == list || p[-1] == ',';
+        int ends = p[n] == '\0' || p[n] == ',';
+        if (starts && ends) {
+            return 1;
+        }
+        p += n;
+    }
+    return 0;
+}
+
+static void write_row(FILE* jf, int* first, const char* kernel, const char* form, Eval outcome,
+                      const MatrixKernel* mk, int objs, unsigned seed, const BenchResult* res) {
+    int i;
+    if (!jf) {
+        return;
+    }
+    fprintf(jf, "%s    {\"kernel\": \"%s\", \"form\": \"%s\", \"outcome\": \"%s\", "
+                "\"heap\": {\"shape\": \"%s\", \"objs\": %d, \"seed\": %u}, "
+                "\"iters_per_sample\": %llu, \"rejected\": %d, \"stats_ns_per_iter\": ",
+            *first ? "" : ",\n", kernel, form, outcome_name(outcome),
+            heap_shape_name(mk->shape), objs, seed,
+            (unsigned long long)res->iters_per_sample, res->num_samples - res->num_kept);
+    bench_write_stats_json(&res->stats, jf);
+    fprintf(jf, ", \"ns_per_iter\": [");
+    for (i = 0; i < res->num_kept; ++i) {
+        fprintf(jf, "%s%.6f", i ? ", " : "", res->ns_per_iter[i]);
+    }
+    fprintf(jf, "]}");
+    *first = 0;
+}
+
+static int run_form(const char* kernel, const char* form, BenchBodyFn body, MatrixCtx* ctx,
+                    const BenchConfig* cfg, Eval outcome, const MatrixKernel* mk, int objs, unsigned seed,
+                    FILE* jf, int* first) {
+    BenchResult res;
+    if (!bench_run(kernel, body, ctx, cfg, &res)) {
+        fprintf(stderr, "%s/%s: benchmark failed\n", kernel, form);
+        return 0;
+    }
+    printf("kernel=%s form=%s outcome=%s median_ns=%.3f mad=%.3f p95=%.3f samples=%d\n",
+           kernel, form, outcome_name(outcome), res.stats.median, res.stats.mad, res.stats.p95, res.num_kept);
+    write_row(jf, first, kernel, form, outcome, mk, objs, seed, &res);
+    bench_result_free(&res);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    const char* graph_dir = "out";
+    const char* kernel_list = NULL;
+    const char* forms = "native,interp,compiled";
+    const char* native_label = "native";
+    int objs = 64;
+    unsigned base_seed = 1234;
+    int check_trials = 1000;
+    int trusted = 0;
+    char native_form[64];
+    char interp_form[64];
+    char compiled_form[64];
+    int num_kernels = (int)(sizeof(matrix_kernels) / sizeof(matrix_kernels[0]));
+    FILE* jf = NULL;
+    int first = 1;
+    int status = 0;
+    int i;
+
+    bench_config_default(&cfg);
+    cfg.samples = 30;
+    cfg.warmup_ms = 50.0;
+    cfg.sample_ms = 10.0;
+
+    for (i = 1; i < argc; ++i) {
+        if (bench_parse_arg(&cfg, argc, argv, &i)) {
+            continue;
+        } else if (strcmp(argv[i], "--graph_dir") == 0 && i + 1 < argc) {
+            graph_dir = argv[++i];
+        } else if (strcmp(argv[i], "--kernels") == 0 && i + 1 < argc) {
+            kernel_list = argv[++i];
+        } else if (strcmp(argv[i], "--forms") == 0 && i + 1 < argc) {
+            forms = argv[++i];
+        } else if (strcmp(argv[i], "--native_label") == 0 && i + 1 < argc) {
+            native_label = argv[++i];
+        } else if (strcmp(argv[i], "--objs") == 0 && i + 1 < argc) {
+            objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            base_seed = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            check_trials = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trusted") == 0) {
+            trusted = 1;
+        }
+    }
+
+    if (objs < 2) {
+        fprintf(stderr, "objs must be >= 2\n");
+        return 1;
+    }
+    if (!check_manifest(graph_dir)) {
+        return 1;
+    }
+    /* trusted rows are the same forms with the address checks skipped */
+    snprintf(native_form, sizeof(native_form), "%s%s", native_label, trusted ? "+trusted" : "");
+    snprintf(interp_form, sizeof(interp_form), "interp%s", trusted ? "+trusted" : "");
+    snprintf(compiled_form, sizeof(compiled_form), "compiled%s", trusted ? "+trusted" : "");
+
+    if (cfg.json_path) {
+        jf = fopen(cfg.json_path, "w");
+        if (!jf) {
+            fprintf(stderr, "failed to write %s\n", cfg.json_path);
+            return 1;
+        }
+        fprintf(jf, "{\n  \"native_label\": \"%s\",\n  \"rows\": [\n", native_label);
+    }
+
+    for (i = 0; i < num_kernels; ++i) {
+        const MatrixKernel* mk = &matrix_kernels[i];
+        MatrixCtx ctx;
+        char graph_path[512];
+        Graph* graph;
+        unsigned seed = base_seed;
+        Eval outcome;
+
+        if (!list_has(kernel_list, mk->name)) {
+            continue;
+        }
+
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.env.p = VAL_PTR(1);
+        ctx.env.q = mk->use_q ? VAL_PTR(2) : VAL_NULL;
+        ctx.heap = pick_heap(mk, &ctx.env, objs, &seed);
+        if (!ctx.heap) {
+            fprintf(stderr, "%s: failed to build heap\n", mk->name);
+            status = 1;
+            continue;
+        }
+        if (trusted) {
+            int inputs[2];
+            inputs[0] = ctx.env.p;
+            inputs[1] = ctx.env.q;
+            if (!heap_trust(ctx.heap, 1, inputs, 2)) {
+                fprintf(stderr, "%s: heap failed validation, timed untrusted\n", mk->name);
+            }
+        }
+        outcome = mk->fn(ctx.heap, ctx.env.p, ctx.env.q);
+
+        if (list_has(forms, "native")) {
+            if (!run_form(mk->name, native_form, mk->native, &ctx, &cfg, outcome, mk, objs, seed, jf, &first)) {
+                status = 1;
+            }
+        }
+
+        snprintf(graph_path, sizeof(graph_path), "%s/%s.json", graph_dir, mk->name);
+        graph = (list_has(forms, "interp") || list_has(forms, "compiled")) ? graph_load_json(graph_path) : NULL;
+        if (graph) {
+            int n = graph_num_nodes(graph);
+            CompiledGraph* cg = graph_compile(graph);
+            ctx.graph = graph;
+            ctx.cg = cg;
+            ctx.nodes = (Eval*)calloc((size_t)n + 1, sizeof(Eval));
+            ctx.seen = (unsigned char*)calloc((size_t)n + 1, 1);
+            ctx.slots = (Eval*)calloc((size_t)compiled_graph_num_slots(cg) + 1, sizeof(Eval));
+            if (!cg || !ctx.nodes || !ctx.seen || !ctx.slots) {
+                fprintf(stderr, "%s: failed to compile graph\n", mk->name);
+                status = 1;
+            } else if (check_trials > 0 && !check_compiled(mk, &ctx, objs, check_trials, base_seed, trusted)) {
+                status = 1;
+            } else {
+                if (list_has(forms, "interp") &&
+                    !run_form(mk->name, interp_form, interp_loop, &ctx, &cfg, outcome, mk, objs, seed, jf, &first)) {
+                    status = 1;
+                }
+                if (list_has(forms, "compiled") &&
+                    !run_form(mk->name, compiled_form, compiled_loop, &ctx, &cfg, outcome, mk, objs, seed, jf, &first)) {
+                    status = 1;
+                }
+            }
+            free(ctx.nodes);
+            free(ctx.seen);
+            free(ctx.slots);
+            compiled_graph_free(cg);
+            graph_free(graph);
+        } else if (list_has(forms, "interp") || list_has(forms, "compiled")) {
+            fprintf(stderr, "%s: no graph at %s, skipping graph forms\n", mk->name, graph_path);
+        }
+
+        heap_free(ctx.heap);
+    }
+
+    if (jf) {
+        fprintf(jf, "\n  ]\n}\n");
+        fclose(jf);
+    }
+    return status;
+}
\ No newline at end of file
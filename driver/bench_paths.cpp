@@ -0,0 +1,216 @@
+#include "bench_harness.h"
+#include "checked_ptr.h"
+#include "ck_path.hpp"
+#include "heap_compact.h"
+#include "heap_gen.h"
+#include "kernels.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The C kernels against the same field paths written with ck_path.hpp:
+   each template path is first checked against its C kernel for every start
+   value on random heaps (plain and compact), then both are timed on a heap
+   where the kernel succeeds. */
+
+typedef struct {
+    Heap* heap;
+    int p;
+} PathCtx;
+
+/* Fn is a template argument so the template paths inline into the loop;
+   the C kernels stay calls into kernels.c. */
+template <KernelFn Fn>
+static uint64_t path_loop(void* arg, uint64_t iters) {
+    const PathCtx* ctx = (const PathCtx*)arg;
+    Heap* heap = ctx->heap;
+    int p = ctx->p;
+    volatile uint64_t sink = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        Eval e = Fn(heap, p, VAL_NULL);
+        sink += (uint64_t)e.value;
+    }
+    return sink;
+}
+
+typedef struct {
+    const char* name;
+    KernelFn c_fn;
+    KernelFn path_fn;
+    BenchBodyFn c_body;
+    BenchBodyFn path_body;
+    int fields[MAX_FIELDS];
+    int num_fields;
+    HeapShape shape;
+} PathKernel;
+
+#define PATH_KERNEL(name, path, shape, num_fields, ...)                            \
+    {#name, name, ck::kernel<path>, path_loop<name>, path_loop<ck::kernel<path> >, \
+     {__VA_ARGS__}, num_fields, shape}
+
+typedef ck::Path<FIELD_F, FIELD_G> FieldChainPath;
+
+static const PathKernel path_kernels[] = {
+    PATH_KERNEL(triple_deref, ck::Deref<3>, HEAP_SHAPE_LIST, 1, FIELD_DEREF),
+    PATH_KERNEL(graph_walk, ck::Deref<4>, HEAP_SHAPE_LIST, 1, FIELD_DEREF),
+    PATH_KERNEL(field_chain, FieldChainPath, HEAP_SHAPE_TREE, 3, FIELD_F, FIELD_G, FIELD_DEREF),
+};
+
+static Heap* generate_heap(const PathKernel* pk, int objs, unsigned seed) {
+    return heap_create_shaped(objs, pk->shape, pk->fields, pk->num_fields, seed);
+}
+
+static int same_eval(Eval a, Eval b) {
+    return a.ok == b.ok && (a.ok ? a.value == b.value : a.err == b.err);
+}
+
+static int check_heap(const PathKernel* pk, Heap* heap, int objs, const char* what, unsigned seed) {
+    int starts[4] = {VAL_NULL, VAL_INT(0), VAL_INT(7), -2 /* pointer to address -1 */};
+    int i;
+    for (i = 0; i < 4 + objs + 2; ++i) {
+        int p = i < 4 ? starts[i] : VAL_PTR(i - 4);
+        Eval a = pk->c_fn(heap, p, VAL_NULL);
+        Eval b = pk->path_fn(heap, p, VAL_NULL);
+        if (!same_eval(a, b)) {
+            fprintf(stderr, "%s: path disagrees with the C kernel on a %s heap (seed %u, p=%d)\n",
+                    pk->name, what, seed, p);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int check_path(const PathKernel* pk, int objs, int trials, unsigned seed) {
+    int t;
+    for (t = 0; t < trials; ++t) {
+        Heap* heap = generate_heap(pk, objs, seed + (unsigned)t);
+        CompactHeap* ch;
+        int ok;
+        if (!heap) {
+            return 0;
+        }
+        ok = check_heap(pk, heap, objs, "plain", seed + (unsigned)t);
+        ch = ok ? compact_heap_encode(heap) : NULL;
+        if (ch) {
+            ok = check_heap(pk, compact_heap_view(ch), objs, "compact", seed + (unsigned)t);
+            compact_heap_free(ch);
+        }
+        heap_free(heap);
+        if (!ok) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* First seed from `seed` whose heap takes the success path from p. */
+static Heap* pick_heap(const PathKernel* pk, int p, int objs, unsigned seed) {
+    unsigned s;
+    for (s = seed; s < seed + 256; ++s) {
+        Heap* heap = generate_heap(pk, objs, s);
+        if (!heap) {
+            return NULL;
+        }
+        if (pk->c_fn(heap, p, VAL_NULL).ok) {
+            return heap;
+        }
+        heap_free(heap);
+    }
+    return generate_heap(pk, objs, seed);
+}
+
+static int run_form(const PathKernel* pk, const char* form, BenchBodyFn body, PathCtx* ctx,
+                    const BenchConfig* cfg, double* median, FILE* jf, int* first) {
+    BenchResult res;
+    if (!bench_run(pk->name, body, ctx, cfg, &res)) {
+        fprintf(stderr, "%s/%s: benchmark failed\n", pk->name, form);
+        return 0;
+    }
+    printf("kernel=%s form=%s median_ns=%.3f mad=%.3f p95=%.3f samples=%d\n",
+           pk->name, form, res.stats.median, res.stats.mad, res.stats.p95, res.num_kept);
+    if (jf) {
+        fprintf(jf, "%s    {\"kernel\": \"%s\", \"form\": \"%s\", \"stats_ns_per_iter\": ",
+                *first ? "" : ",\n", pk->name, form);
+        bench_write_stats_json(&res.stats, jf);
+        fprintf(jf, "}");
+        *first = 0;
+    }
+    *median = res.stats.median;
+    bench_result_free(&res);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    int objs = 64;
+    unsigned seed = 1234;
+    int check_trials = 200;
+    int num_kernels = (int)(sizeof(path_kernels) / sizeof(path_kernels[0]));
+    FILE* jf = NULL;
+    int first = 1;
+    int status = 0;
+    int i;
+
+    bench_config_default(&cfg);
+    cfg.samples = 30;
+    cfg.warmup_ms = 50.0;
+    cfg.sample_ms = 10.0;
+
+    for (i = 1; i < argc; ++i) {
+        if (bench_parse_arg(&cfg, argc, argv, &i)) {
+            continue;
+        } else if (strcmp(argv[i], "--objs") == 0 && i + 1 < argc) {
+            objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            check_trials = atoi(argv[++i]);
+        }
+    }
+    if (objs < 2) {
+        fprintf(stderr, "objs must be >= 2\n");
+        return 1;
+    }
+
+    if (cfg.json_path) {
+        jf = fopen(cfg.json_path, "w");
+        if (!jf) {
+            fprintf(stderr, "failed to write %s\n", cfg.json_path);
+            return 1;
+        }
+        fprintf(jf, "{\n  \"rows\": [\n");
+    }
+
+    for (i = 0; i < num_kernels && status == 0; ++i) {
+        const PathKernel* pk = &path_kernels[i];
+        PathCtx ctx;
+        double c_ns = 0.0;
+        double path_ns = 0.0;
+
+        if (check_trials > 0 && !check_path(pk, objs, check_trials, seed)) {
+            status = 1;
+            break;
+        }
+        ctx.p = VAL_PTR(1);
+        ctx.heap = pick_heap(pk, ctx.p, objs, seed);
+        if (!ctx.heap) {
+            fprintf(stderr, "%s: failed to build heap\n", pk->name);
+            status = 1;
+            break;
+        }
+        if (!run_form(pk, "c", pk->c_body, &ctx, &cfg, &c_ns, jf, &first) ||
+            !run_form(pk, "path", pk->path_body, &ctx, &cfg, &path_ns, jf, &first)) {
+            status = 1;
+        } else {
+            printf("kernel=%s speedup=%.2f\n", pk->name, path_ns > 0.0 ? c_ns / path_ns : 0.0);
+        }
+        heap_free(ctx.heap);
+    }
+
+    if (jf) {
+        fprintf(jf, "\n  ]\n}\n");
+        fclose(jf);
+    }
+    return status;
+}
\ No newline at end of file
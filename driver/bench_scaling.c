@@ -0,0 +1,406 @@
+#include "bench_harness.h"
+#include "checked_ptr.h"
+#include "heap_gen.h"
+#include "kernels.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+/* Reader scaling: 1..N pinned threads chase chains through one shared
+   read-only heap (or one heap each with --per_thread) for a fixed time.
+   Per-thread counters sit on their own cache lines unless --packed asks
+   for the false-sharing layout. */
+
+#define MAX_THREADS 256
+#define MAX_REPS 64
+#define CACHE_LINE 64
+
+typedef struct {
+    uint64_t evals;
+    uint64_t errors;
+} Counters;
+
+typedef struct {
+    Counters c;
+    char pad[CACHE_LINE - sizeof(Counters)];
+} PaddedCounters;
+
+typedef struct {
+    Heap* heap;
+    int* starts;
+    int num_starts;
+} ChainSet;
+
+typedef struct {
+    const ChainSet* chains;
+    KernelFn fn;
+    int cpu;
+    int first;
+    volatile Counters* counters;
+    volatile int* go;
+    volatile int* stop;
+} Worker;
+
+static void* worker_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    const ChainSet* set = w->chains;
+    KernelFn fn = w->fn;
+    int idx = w->first % set->num_starts;
+
+    if (w->cpu >= 0) {
+        bench_pin_cpu(w->cpu);
+    }
+    while (!__atomic_load_n(w->go, __ATOMIC_ACQUIRE)) {
+    }
+    while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+        int k;
+        for (k = 0; k < 256; ++k) {
+            Eval e = fn(set->heap, set->starts[idx], VAL_NULL);
+            if (e.ok) {
+                w->counters->evals++;
+            } else {
+                w->counters->errors++;
+            }
+            if (++idx == set->num_starts) {
+                idx = 0;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Chains of `len` objects at shuffled addresses, one per deref of the
+   kernel, so every start evaluates to an int. */
+static int build_chain_set(ChainSet* set, int objs, int len, unsigned seed, const HeapAllocOptions* hopts) {
+    int num_chains = objs / len;
+    int* perm = (int*)malloc((size_t)objs * sizeof(int));
+    Rng rng;
+    int c;
+    int i;
+
+    set->heap = heap_create_ex(objs, hopts);
+    set->starts = (int*)malloc((size_t)(num_chains > 0 ? num_chains : 1) * sizeof(int));
+    set->num_starts = num_chains;
+    if (!perm || !set->heap || !set->starts || num_chains < 1) {
+        free(perm);
+        return 0;
+    }
+    rng_seed(&rng, seed);
+    for (i = 0; i < objs; ++i) {
+        perm[i] = i + 1;
+    }
+    for (i = objs - 1; i > 0; --i) {
+        int j = rng_range(&rng, 0, i);
+        int t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+    for (c = 0; c < num_chains; ++c) {
+        for (i = 0; i < len; ++i) {
+            Obj* obj = heap_get_obj(set->heap, perm[c * len + i]);
+            obj->has_field[FIELD_DEREF] = 1;
+            obj->value[FIELD_DEREF] = i + 1 < len ? VAL_PTR(perm[c * len + i + 1]) : VAL_INT(c);
+        }
+        set->starts[c] = VAL_PTR(perm[c * len]);
+    }
+    free(perm);
+    return 1;
+}
+
+static void free_chain_set(ChainSet* set) {
+    heap_free(set->heap);
+    free(set->starts);
+    set->heap = NULL;
+    set->starts = NULL;
+}
+
+static void sleep_ms(double ms) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+}
+
+static int parse_cpu_list(const char* s, int* cpus, int max) {
+    int n = 0;
+    while (s && *s && n < max) {
+        char* end;
+        long v = strtol(s, &end, 10);
+        if (end == s) {
+            break;
+        }
+        cpus[n++] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static int default_threads(void) {
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+typedef struct {
+    double total;       /* evals per second, all threads */
+    double per_min;
+    double per_max;
+} RunResult;
+
+/* One timed run with `threads` readers; sets have one entry per thread
+   (all pointing at the same ChainSet when the heap is shared). */
+static int run_once(int threads, ChainSet* const* sets, KernelFn fn, const int* cpus, int num_cpus,
+                    double duration_ms, int packed, RunResult* out) {
+    pthread_t tids[MAX_THREADS];
+    Worker workers[MAX_THREADS];
+    PaddedCounters* padded = NULL;
+    Counters* dense = NULL;
+    volatile int go = 0;
+    volatile int stop = 0;
+    uint64_t start;
+    uint64_t end;
+    int started = 0;
+    int t;
+
+    if (packed) {
+        dense = (Counters*)calloc((size_t)threads, sizeof(Counters));
+    } else {
+        /* calloc only guarantees 16-byte alignment: padding alone would
+           still let two counters share a line */
+        void* p = NULL;
+        if (posix_memalign(&p, CACHE_LINE, (size_t)threads * sizeof(PaddedCounters)) == 0) {
+            padded = (PaddedCounters*)p;
+            memset(padded, 0, (size_t)threads * sizeof(PaddedCounters));
+        }
+    }
+    if (!dense && !padded) {
+        return 0;
+    }
+
+    for (t = 0; t < threads; ++t) {
+        workers[t].chains = sets[t];
+        workers[t].fn = fn;
+        workers[t].cpu = num_cpus > 0 ? cpus[t % num_cpus] : -1;
+        /* spread start positions so threads do not walk in lockstep */
+        workers[t].first = (int)((long long)sets[t]->num_starts * t / threads);
+        workers[t].counters = packed ? &dense[t] : &padded[t].c;
+        workers[t].go = &go;
+        workers[t].stop = &stop;
+        if (pthread_create(&tids[started], NULL, worker_main, &workers[t]) == 0) {
+            started++;
+        }
+    }
+
+    start = bench_now_ns();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+    sleep_ms(duration_ms);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for (t = 0; t < started; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+    end = bench_now_ns();
+
+    out->total = 0.0;
+    out->per_min = 0.0;
+    out->per_max = 0.0;
+    for (t = 0; t < started; ++t) {
+        const volatile Counters* c = workers[t].counters;
+        double rate = (double)(c->evals + c->errors) * 1e9 / (double)(end - start);
+        out->total += rate;
+        out->per_min = (t == 0 || rate < out->per_min) ? rate : out->per_min;
+        out->per_max = rate > out->per_max ? rate : out->per_max;
+    }
+    free(dense);
+    free(padded);
+    return started == threads;
+}
+
+/* 1, 2, 4, ... and always the requested maximum */
+static int next_count(int threads, int max_threads) {
+    if (threads < max_threads && threads * 2 > max_threads) {
+        return max_threads;
+    }
+    return threads * 2;
+}
+
+static int cmp_run(const void* a, const void* b) {
+    double x = ((const RunResult*)a)->total;
+    double y = ((const RunResult*)b)->total;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+    const char* kernel = "triple_deref";
+    KernelFn fn = triple_deref;
+    int max_threads = default_threads();
+    int cpus[MAX_THREADS];
+    int num_cpus = 0;
+    int objs = 1 << 20;
+    int len = 3;
+    int per_thread = 0;
+    int packed = 0;
+    int reps = 5;
+    double duration_ms = 200.0;
+    unsigned seed = 1234;
+    HeapAllocOptions hopts;
+    const char* json_path = NULL;
+    ChainSet shared;
+    ChainSet* own = NULL;
+    ChainSet* sets[MAX_THREADS];
+    FILE* jf = NULL;
+    double single = 0.0;
+    int threads;
+    int first = 1;
+    int status = 0;
+    int i;
+
+    heap_alloc_options_default(&hopts);
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            num_cpus = parse_cpu_list(argv[++i], cpus, MAX_THREADS);
+        } else if (strcmp(argv[i], "--no_pin") == 0) {
+            num_cpus = -1;
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernel = argv[++i];
+        } else if (strcmp(argv[i], "--objs") == 0 && i + 1 < argc) {
+            objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--per_thread") == 0) {
+            per_thread = 1;
+        } else if (strcmp(argv[i], "--packed") == 0) {
+            packed = 1;
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration_ms") == 0 && i + 1 < argc) {
+            duration_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            if (!heap_pages_parse(argv[++i], &hopts.pages)) {
+                fprintf(stderr, "unknown pages %s (default, 4k, thp, 2m, 1g)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--prefault") == 0) {
+            hopts.prefault = 1;
+        } else if (strcmp(argv[i], "--mlock") == 0) {
+            hopts.mlock = 1;
+        }
+    }
+
+    if (strcmp(kernel, "triple_deref") == 0) {
+        fn = triple_deref;
+    } else if (strcmp(kernel, "graph_walk") == 0) {
+        fn = graph_walk;
+        len = 4;
+    } else {
+        fprintf(stderr, "unknown kernel %s (triple_deref, graph_walk)\n", kernel);
+        return 1;
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS || reps < 1 || reps > MAX_REPS) {
+        fprintf(stderr, "threads must be in 1..%d and reps in 1..%d\n", MAX_THREADS, MAX_REPS);
+        return 1;
+    }
+    if (num_cpus == 0) {
+        int n = default_threads();
+        for (i = 0; i < n && i < MAX_THREADS; ++i) {
+            cpus[i] = i;
+        }
+        num_cpus = i;
+    }
+
+    memset(&shared, 0, sizeof(shared));
+    if (per_thread) {
+        own = (ChainSet*)calloc((size_t)max_threads, sizeof(ChainSet));
+        if (!own) {
+            return 1;
+        }
+        for (i = 0; i < max_threads; ++i) {
+            if (!build_chain_set(&own[i], objs, len, seed + (unsigned)i, &hopts)) {
+                fprintf(stderr, "failed to build heap\n");
+                status = 1;
+                break;
+            }
+            sets[i] = &own[i];
+        }
+    } else {
+        if (!build_chain_set(&shared, objs, len, seed, &hopts)) {
+            fprintf(stderr, "failed to build heap\n");
+            status = 1;
+        }
+        for (i = 0; i < max_threads; ++i) {
+            sets[i] = &shared;
+        }
+    }
+
+    if (status == 0 && json_path) {
+        jf = fopen(json_path, "w");
+        if (!jf) {
+            fprintf(stderr, "failed to write %s\n", json_path);
+            status = 1;
+        } else {
+            fprintf(jf, "{\n  \"kernel\": \"%s\",\n  \"heap\": \"%s\",\n  \"objs\": %d,\n  \"packed\": %d,\n  \"rows\": [\n",
+                    kernel, per_thread ? "per_thread" : "shared", objs, packed);
+        }
+    }
+
+    printf("kernel=%s heap=%s objs=%d counters=%s pin=%s pages=%s\n", kernel, per_thread ? "per_thread" : "shared",
+           objs, packed ? "packed" : "padded", num_cpus > 0 ? "yes" : "no",
+           status == 0 ? heap_pages_name(sets[0]->heap->pages) : "none");
+
+    for (threads = 1; status == 0 && threads <= max_threads; threads = next_count(threads, max_threads)) {
+        RunResult runs[MAX_REPS];
+        RunResult med;
+        int r;
+        for (r = 0; r < reps; ++r) {
+            if (!run_once(threads, sets, fn, cpus, num_cpus, duration_ms, packed, &runs[r])) {
+                fprintf(stderr, "failed to start %d threads\n", threads);
+                status = 1;
+                break;
+            }
+        }
+        if (status != 0) {
+            break;
+        }
+        qsort(runs, (size_t)reps, sizeof(RunResult), cmp_run);
+        med = runs[reps / 2];
+        if (threads == 1) {
+            single = med.total;
+        }
+        printf("threads=%d evals_per_sec=%.0f per_thread=%.0f min_thread=%.0f max_thread=%.0f speedup=%.2f efficiency=%.2f\n",
+               threads, med.total, med.total / threads, med.per_min, med.per_max,
+               single > 0 ? med.total / single : 0.0, single > 0 ? med.total / (single * threads) : 0.0);
+        if (jf) {
+            fprintf(jf, "%s    {\"threads\": %d, \"evals_per_sec\": %.0f, \"per_thread\": %.0f, "
+                        "\"min_thread\": %.0f, \"max_thread\": %.0f, \"speedup\": %.4f, \"efficiency\": %.4f}",
+                    first ? "" : ",\n", threads, med.total, med.total / threads, med.per_min, med.per_max,
+                    single > 0 ? med.total / single : 0.0, single > 0 ? med.total / (single * threads) : 0.0);
+            first = 0;
+        }
+    }
+
+    if (jf) {
+        fprintf(jf, "\n  ]\n}\n");
+        fclose(jf);
+    }
+    if (own) {
+        for (i = 0; i < max_threads; ++i) {
+            free_chain_set(&own[i]);
+        }
+        free(own);
+    }
+    free_chain_set(&shared);
+    return status;
+}
\ No newline at end of file
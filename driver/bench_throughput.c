@@ -0,0 +1,455 @@
+#include "bench_harness.h"
+#include "checked_ptr.h"
+#include "heap_compact.h"
+#include "heap_gen.h"
+#include "heap_layout.h"
+#include "heap_stats.h"
+#include "kernels.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Latency vs throughput of the checked runtime. The heaps hold many
+   independent chains scattered over memory. Latency mode picks the next
+   chain from the previous result, so every deref waits for the one before;
+   throughput mode evaluates a batch of W unrelated (heap, p) pairs per
+   iteration so their loads can overlap. */
+
+#define MAX_WIDTH 64
+
+typedef struct {
+    Heap** heaps;   /* per pair */
+    int* starts;    /* per pair, tagged pointer to the chain head */
+    int num_pairs;
+    int width;
+    KernelFn fn;
+} ThroughputCtx;
+
+static uint64_t latency_loop(void* arg, uint64_t iters) {
+    const ThroughputCtx* ctx = (const ThroughputCtx*)arg;
+    KernelFn fn = ctx->fn;
+    int idx = 0;
+    uint64_t acc = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        Eval e = fn(ctx->heaps[idx], ctx->starts[idx], VAL_NULL);
+        /* the chain tail names the next pair */
+        if (e.ok && VAL_IS_INT(e.value) && VAL_INT_VALUE(e.value) < ctx->num_pairs) {
+            idx = VAL_INT_VALUE(e.value);
+        } else {
+            idx = (idx + 1) % ctx->num_pairs;
+        }
+        acc += (uint64_t)idx;
+    }
+    return acc;
+}
+
+static uint64_t throughput_loop(void* arg, uint64_t iters) {
+    const ThroughputCtx* ctx = (const ThroughputCtx*)arg;
+    KernelFn fn = ctx->fn;
+    int width = ctx->width;
+    int idx = 0;
+    uint64_t acc[MAX_WIDTH] = {0};
+    uint64_t sum = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+        for (int j = 0; j < width; ++j) {
+            Eval e = fn(ctx->heaps[idx + j], ctx->starts[idx + j], VAL_NULL);
+            acc[j] += (uint64_t)e.value;
+        }
+        idx += width;
+        if (idx + width > ctx->num_pairs) {
+            idx = 0;
+        }
+    }
+    for (int j = 0; j < width; ++j) {
+        sum += acc[j];
+    }
+    return sum;
+}
+
+/* Chains of `len` objects at random addresses across `num_heaps` heaps; the
+   tail of each chain holds the int index of the pair that follows it in one
+   random cycle through all pairs, which is what latency mode chases. */
+static int build_chains(ThroughputCtx* ctx, Heap** heaps, int num_heaps, int objs_per_heap, int len, unsigned seed) {
+    int chains_per_heap = objs_per_heap / len;
+    int num_pairs = chains_per_heap * num_heaps;
+    int* perm = (int*)malloc((size_t)objs_per_heap * sizeof(int));
+    int* order = (int*)malloc((size_t)num_pairs * sizeof(int));
+    int* pos = (int*)malloc((size_t)num_pairs * sizeof(int));
+    Rng rng;
+    int h;
+    int c;
+    int i;
+
+    ctx->heaps = (Heap**)malloc((size_t)num_pairs * sizeof(Heap*));
+    ctx->starts = (int*)malloc((size_t)num_pairs * sizeof(int));
+    if (!perm || !order || !pos || !ctx->heaps || !ctx->starts || num_pairs < 1) {
+        free(perm);
+        free(order);
+        free(pos);
+        return 0;
+    }
+    rng_seed(&rng, seed);
+
+    for (i = 0; i < num_pairs; ++i) {
+        order[i] = i;
+    }
+    for (i = num_pairs - 1; i > 0; --i) {
+        int j = rng_range(&rng, 0, i);
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (i = 0; i < num_pairs; ++i) {
+        pos[order[i]] = i;
+    }
+
+    for (h = 0; h < num_heaps; ++h) {
+        for (i = 0; i < objs_per_heap; ++i) {
+            perm[i] = i + 1;
+        }
+        for (i = objs_per_heap - 1; i > 0; --i) {
+            int j = rng_range(&rng, 0, i);
+            int t = perm[i];
+            perm[i] = perm[j];
+            perm[j] = t;
+        }
+        for (c = 0; c < chains_per_heap; ++c) {
+            /* pairs interleave heaps so a batch touches all of them */
+            int pair = c * num_heaps + h;
+            int next = order[(pos[pair] + 1) % num_pairs];
+            for (i = 0; i < len; ++i) {
+                Obj* obj = heap_get_obj(heaps[h], perm[c * len + i]);
+                obj->has_field[FIELD_DEREF] = 1;
+                obj->value[FIELD_DEREF] = i + 1 < len ? VAL_PTR(perm[c * len + i + 1]) : VAL_INT(next);
+            }
+            ctx->heaps[pair] = heaps[h];
+            ctx->starts[pair] = VAL_PTR(perm[c * len]);
+        }
+    }
+
+    ctx->num_pairs = num_pairs;
+    free(perm);
+    free(order);
+    free(pos);
+    return 1;
+}
+
+static void report(const char* mode, const char* layout, int width, int derefs, const BenchResult* res, FILE* jf,
+                   int* first) {
+    double ns = res->stats.median / width;
+    printf("mode=%s layout=%s width=%d ns_per_eval=%.3f ns_per_deref=%.3f evals_per_sec=%.0f derefs_per_sec=%.0f\n",
+           mode, layout, width, ns, ns / derefs, 1e9 / ns, 1e9 * derefs / ns);
+    if (!jf) {
+        return;
+    }
+    fprintf(jf, "%s    {\"mode\": \"%s\", \"layout\": \"%s\", \"width\": %d, \"ns_per_eval\": %.6f, "
+                "\"ns_per_deref\": %.6f, \"evals_per_sec\": %.0f, \"derefs_per_sec\": %.0f, \"stats_ns_per_iter\": ",
+            *first ? "" : ",\n", mode, layout, width, ns, ns / derefs, 1e9 / ns, 1e9 * derefs / ns);
+    bench_write_stats_json(&res->stats, jf);
+    fprintf(jf, "}");
+    *first = 0;
+}
+
+static int run_modes(ThroughputCtx* ctx, const BenchConfig* cfg, const char* kernel, const char* mode,
+                     const int* widths, int num_widths, int derefs, const char* layout, FILE* jf, int* first) {
+    int status = 0;
+    int i;
+
+    if (strcmp(mode, "latency") == 0 || strcmp(mode, "both") == 0) {
+        BenchResult res;
+        if (bench_run(kernel, latency_loop, ctx, cfg, &res)) {
+            report("latency", layout, 1, derefs, &res, jf, first);
+            bench_result_free(&res);
+        } else {
+            status = 1;
+        }
+    }
+
+    if (strcmp(mode, "throughput") == 0 || strcmp(mode, "both") == 0) {
+        for (i = 0; i < num_widths; ++i) {
+            BenchResult res;
+            ctx->width = widths[i];
+            if (!bench_run(kernel, throughput_loop, ctx, cfg, &res)) {
+                status = 1;
+                continue;
+            }
+            report("throughput", layout, ctx->width, derefs, &res, jf, first);
+            bench_result_free(&res);
+        }
+    }
+    return status;
+}
+
+/* Renumber each heap in traversal order from its chain heads (in pair
+   order) and translate the heads. */
+static int relayout_heaps(ThroughputCtx* ctx, Heap** heaps, int num_heaps, HeapOrder order) {
+    int* roots = (int*)malloc((size_t)ctx->num_pairs * sizeof(int));
+    int* remap = NULL;
+    int h;
+    int i;
+    if (!roots) {
+        return 0;
+    }
+    for (h = 0; h < num_heaps; ++h) {
+        Heap* moved;
+        int n = 0;
+        for (i = 0; i < ctx->num_pairs; ++i) {
+            if (ctx->heaps[i] == heaps[h]) {
+                roots[n++] = ctx->starts[i];
+            }
+        }
+        remap = (int*)malloc(((size_t)heaps[h]->num_objs + 1) * sizeof(int));
+        moved = remap ? heap_relayout(heaps[h], roots, n, NULL, 0, order, remap) : NULL;
+        if (!moved) {
+            free(remap);
+            free(roots);
+            return 0;
+        }
+        for (i = 0; i < ctx->num_pairs; ++i) {
+            if (ctx->heaps[i] == heaps[h]) {
+                ctx->heaps[i] = moved;
+                ctx->starts[i] = heap_remap_value(remap, moved->num_objs, ctx->starts[i]);
+            }
+        }
+        heap_free(heaps[h]);
+        heaps[h] = moved;
+        free(remap);
+    }
+    free(roots);
+    return 1;
+}
+
+/* Encode each heap with 16-bit fields, check that it decodes back to the
+   same fields, and point the pairs at the compact views. */
+static int compact_heaps(ThroughputCtx* ctx, Heap** heaps, int num_heaps, CompactHeap** packed) {
+    size_t bytes = 0;
+    size_t plain = 0;
+    int escapes = 0;
+    int h;
+    int i;
+    int f;
+    for (h = 0; h < num_heaps; ++h) {
+        Heap* back;
+        int same = 1;
+        packed[h] = compact_heap_encode(heaps[h]);
+        back = packed[h] ? compact_heap_decode(packed[h]) : NULL;
+        if (!back) {
+            return 0;
+        }
+        for (i = 0; i < heaps[h]->num_objs && same; ++i) {
+            for (f = 0; f < MAX_FIELDS; ++f) {
+                const Obj* a = &heaps[h]->objs[i];
+                const Obj* b = &back->objs[i];
+                if (a->has_field[f] != b->has_field[f] || (a->has_field[f] && a->value[f] != b->value[f])) {
+                    same = 0;
+                }
+            }
+        }
+        heap_free(back);
+        if (!same) {
+            fprintf(stderr, "compact heap %d does not round-trip\n", h);
+            return 0;
+        }
+        bytes += compact_heap_bytes(packed[h]);
+        plain += (size_t)heaps[h]->num_objs * sizeof(Obj);
+        escapes += compact_heap_num_escapes(packed[h]);
+    }
+    for (i = 0; i < ctx->num_pairs; ++i) {
+        for (h = 0; h < num_heaps; ++h) {
+            if (ctx->heaps[i] == heaps[h]) {
+                ctx->heaps[i] = compact_heap_view(packed[h]);
+                break;
+            }
+        }
+    }
+    printf("compact bytes=%zu plain_bytes=%zu escapes=%d\n", bytes, plain, escapes);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    ThroughputCtx ctx;
+    Heap** heaps;
+    const char* kernel = "triple_deref";
+    const char* mode = "both";
+    int widths[8] = {1, 2, 4, 8, 16, 32, 0, 0};
+    int num_widths = 6;
+    int objs = 1 << 20;
+    int num_heaps = 1;
+    unsigned seed = 1234;
+    HeapAllocOptions hopts;
+    HeapOrder order = HEAP_ORDER_DFS;
+    int relayout = 0;
+    int compact = 0;
+    int trusted = 0;
+    CompactHeap** packed = NULL;
+    char label[32];
+    FILE* jf = NULL;
+    int first = 1;
+    int len;
+    int derefs;
+    int h;
+    int i;
+    int status = 0;
+
+    bench_config_default(&cfg);
+    cfg.samples = 20;
+    heap_alloc_options_default(&hopts);
+
+    for (i = 1; i < argc; ++i) {
+        if (bench_parse_arg(&cfg, argc, argv, &i)) {
+            continue;
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernel = argv[++i];
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            widths[0] = atoi(argv[++i]);
+            num_widths = 1;
+        } else if (strcmp(argv[i], "--objs") == 0 && i + 1 < argc) {
+            objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--heaps") == 0 && i + 1 < argc) {
+            num_heaps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            if (!heap_pages_parse(argv[++i], &hopts.pages)) {
+                fprintf(stderr, "unknown pages %s (default, 4k, thp, 2m, 1g)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--strict_pages") == 0) {
+            hopts.fallback = 0;
+        } else if (strcmp(argv[i], "--relayout") == 0 && i + 1 < argc) {
+            if (!heap_order_parse(argv[++i], &order)) {
+                fprintf(stderr, "unknown order %s (dfs, bfs)\n", argv[i]);
+                return 1;
+            }
+            relayout = 1;
+        } else if (strcmp(argv[i], "--compact") == 0) {
+            compact = 1;
+        } else if (strcmp(argv[i], "--trusted") == 0) {
+            trusted = 1;
+        } else if (strcmp(argv[i], "--prefault") == 0) {
+            hopts.prefault = 1;
+        } else if (strcmp(argv[i], "--mlock") == 0) {
+            hopts.mlock = 1;
+        }
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    if (strcmp(kernel, "triple_deref") == 0) {
+        ctx.fn = triple_deref;
+        derefs = 3;
+    } else if (strcmp(kernel, "triple_deref_spec") == 0) {
+        ctx.fn = triple_deref_spec;
+        derefs = 3;
+    } else if (strcmp(kernel, "graph_walk") == 0) {
+        ctx.fn = graph_walk;
+        derefs = 4;
+    } else {
+        fprintf(stderr, "unknown kernel %s (triple_deref, triple_deref_spec, graph_walk)\n", kernel);
+        return 1;
+    }
+    /* one object per deref; the last load yields the int tail */
+    len = derefs;
+    for (i = 0; i < num_widths; ++i) {
+        if (widths[i] < 1 || widths[i] > MAX_WIDTH) {
+            fprintf(stderr, "batch must be in 1..%d\n", MAX_WIDTH);
+            return 1;
+        }
+    }
+    if (num_heaps < 1 || objs / num_heaps < len * MAX_WIDTH) {
+        fprintf(stderr, "need at least %d objs per heap\n", len * MAX_WIDTH);
+        return 1;
+    }
+
+    heaps = (Heap**)calloc((size_t)num_heaps, sizeof(Heap*));
+    if (!heaps) {
+        return 1;
+    }
+    for (h = 0; h < num_heaps && status == 0; ++h) {
+        heaps[h] = heap_create_ex(objs / num_heaps, &hopts);
+        if (!heaps[h]) {
+            fprintf(stderr, "failed to build heap\n");
+            status = 1;
+        }
+    }
+    if (status == 0 && !build_chains(&ctx, heaps, num_heaps, objs / num_heaps, len, seed)) {
+        fprintf(stderr, "failed to build chains\n");
+        status = 1;
+    }
+    if (status == 0) {
+        /* what the kernel actually gave us, which may differ from --pages */
+        printf("pages=%s requested=%s prefault=%d locked=%d\n", heap_pages_name(heaps[0]->pages),
+               heap_pages_name(hopts.pages), hopts.prefault, heaps[0]->locked);
+        if (hopts.mlock && !heaps[0]->locked) {
+            fprintf(stderr, "mlock failed (RLIMIT_MEMLOCK?), heap left unlocked\n");
+        }
+        if (cfg.json_path) {
+            jf = fopen(cfg.json_path, "w");
+            if (!jf) {
+                fprintf(stderr, "failed to write %s\n", cfg.json_path);
+                status = 1;
+            } else {
+                fprintf(jf, "{\n  \"kernel\": \"%s\",\n  \"pairs\": %d,\n  \"pages\": \"%s\",\n  \"locked\": %d,\n  \"rows\": [\n",
+                        kernel, ctx.num_pairs, heap_pages_name(heaps[0]->pages), heaps[0]->locked);
+            }
+        }
+    }
+    if (status == 0) {
+        status = run_modes(&ctx, &cfg, kernel, mode, widths, num_widths, derefs, "original", jf, &first);
+    }
+    /* the same heaps again with the address checks skipped; every chain
+       starts in range, so validating the heaps is enough */
+    if (status == 0 && trusted) {
+        for (h = 0; h < num_heaps && status == 0; ++h) {
+            if (!heap_trust(heaps[h], 0, NULL, 0)) {
+                fprintf(stderr, "heap %d failed validation\n", h);
+                status = 1;
+            }
+        }
+        if (status == 0) {
+            status = run_modes(&ctx, &cfg, kernel, mode, widths, num_widths, derefs, "original+trusted", jf, &first);
+        }
+        for (h = 0; h < num_heaps; ++h) {
+            heaps[h]->trusted = 0;
+        }
+    }
+    /* same chains, same evaluation order, renumbered so each chain is contiguous */
+    if (status == 0 && relayout) {
+        if (!relayout_heaps(&ctx, heaps, num_heaps, order)) {
+            fprintf(stderr, "failed to relayout heap\n");
+            status = 1;
+        } else {
+            status = run_modes(&ctx, &cfg, kernel, mode, widths, num_widths, derefs, heap_order_name(order), jf, &first);
+        }
+    }
+    /* the same heaps again with 16-bit fields decoded inside the ck_* loads */
+    if (status == 0 && compact) {
+        packed = (CompactHeap**)calloc((size_t)num_heaps, sizeof(CompactHeap*));
+        if (!packed || !compact_heaps(&ctx, heaps, num_heaps, packed)) {
+            fprintf(stderr, "failed to compact heap\n");
+            status = 1;
+        } else {
+            snprintf(label, sizeof(label), "%s+compact", relayout ? heap_order_name(order) : "original");
+            status = run_modes(&ctx, &cfg, kernel, mode, widths, num_widths, derefs, label, jf, &first);
+        }
+    }
+    if (jf) {
+        fprintf(jf, "\n  ]\n}\n");
+        fclose(jf);
+    }
+
+    free(ctx.heaps);
+    free(ctx.starts);
+    for (h = 0; h < num_heaps; ++h) {
+        heap_free(heaps[h]);
+        if (packed) {
+            compact_heap_free(packed[h]);
+        }
+    }
+    free(packed);
+    free(heaps);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include "exhaustive.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define MAX_SLOTS (EXHAUSTIVE_MAX_OBJS * MAX_FIELDS + 2)
+/* 0, the graph's constants, the shared value, then the fresh class */
+#define MAX_INT_CLASSES (EXHAUSTIVE_MAX_CONSTS + 3)
+#define MAX_CHOICES (3 + MAX_INT_CLASSES + EXHAUSTIVE_MAX_OBJS)
+/* prefixes to split each space into, per thread */
+#define TASKS_PER_THREAD 64
+
+/* heap slot digits: 0 absent, 1 null, 2 dangling, 3 + c -> int class c,
+   heap_ptr + a -> Ptr(a + 1) */
+#define HEAP_DIGIT_INT 3
+/* env slot digits: 0 null, 1 dangling, 2 + c -> int class c,
+   env_ptr + a -> Ptr(a + 1) */
+#define ENV_DIGIT_INT 2
+
+/* Slots are assigned in BFS order: p, q, then object 1's fields, object 2's
+   and so on. `next` is the first address the BFS has not discovered yet. */
+typedef struct {
+    int digits[MAX_SLOTS];
+    int next;
+} Prefix;
+
+typedef struct {
+    const Graph* graph;
+    const Kernel* kernel;
+    int k;
+    int fields[MAX_FIELDS];
+    int num_fields;
+    int num_slots; /* k * num_fields heap slots, then p, then q */
+    int radix[MAX_SLOTS];
+    const int* int_vals;    /* classes 0..num_int_vals - 1; class num_int_vals is fresh */
+    int num_int_vals;
+    int fresh_base;         /* a fresh int is fresh_base + the slot's number */
+    int heap_ptr;
+    int env_ptr;
+    int depth;              /* slots every task prefix assigns */
+    Prefix* tasks;          /* in enumeration order */
+    unsigned long long num_tasks;
+    unsigned long long next; /* next task, claimed atomically */
+} Space;
+
+typedef struct {
+    Space* space;
+    ExhaustiveStats stats;
+    unsigned long long witness_index; /* task holding the witness */
+    Heap* heap;
+    Eval* nodes;
+    unsigned char* seen;
+} Worker;
+
+static unsigned long long claim_task(Space* sp) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __sync_fetch_and_add(&sp->next, 1ull);
+#else
+    return sp->next++;
+#endif
+}
+
+/* digits index of the pos-th slot in BFS order */
+static int slot_at(const Space* sp, int pos) {
+    return pos < 2 ? sp->num_slots - 2 + pos : pos - 2;
+}
+
+/* The digits slot `pos` may take with `next` undiscovered, in increasing
+   order, and the BFS frontier after each. A pointer may go to any
+   discovered address or to `next` itself, which discovers it. The fields of
+   an object the BFS has not reached yet take none: that object would stay
+   undiscovered or be discovered out of address order. */
+static int slot_choices(const Space* sp, int pos, int next, int* digits, int* nexts) {
+    int s = slot_at(sp, pos);
+    int base = pos < 2 ? sp->env_ptr : sp->heap_ptr;
+    int n = 0;
+    int d;
+    int a;
+    if (pos >= 2 && s % sp->num_fields == 0 && s / sp->num_fields + 1 >= next) {
+        return 0;
+    }
+    if (sp->radix[s] == 1) {
+        digits[0] = 0;
+        nexts[0] = next;
+        return 1;
+    }
+    for (d = 0; d < base; ++d) {
+        digits[n] = d;
+        nexts[n++] = next;
+    }
+    for (a = 1; a <= next && a <= sp->k; ++a) {
+        digits[n] = base + a - 1;
+        nexts[n++] = a == next ? next + 1 : next;
+    }
+    return n;
+}
+
+/* Int class c in the slot numbered `slot`: a fresh int differs from every
+   other int in the heap and env, the other classes are shared by all slots. */
+static int int_value(const Space* sp, int c, int slot) {
+    return VAL_INT(c < sp->num_int_vals ? sp->int_vals[c] : sp->fresh_base + slot);
+}
+
+static int env_value(const Space* sp, int d, int which) {
+    if (d == 0) {
+        return VAL_NULL;
+    }
+    if (d == 1) {
+        return VAL_PTR(sp->k + 1);
+    }
+    if (d < sp->env_ptr) {
+        return int_value(sp, d - ENV_DIGIT_INT, EXHAUSTIVE_MAX_OBJS * MAX_FIELDS + which);
+    }
+    return VAL_PTR(d - sp->env_ptr + 1);
+}
+
+static void fill_heap(const Space* sp, const int* digits, Heap* heap, Env* env) {
+    int obj;
+    int fi;
+    for (obj = 0; obj < sp->k; ++obj) {
+        Obj* o = &heap->objs[obj];
+        for (fi = 0; fi < sp->num_fields; ++fi) {
+            int field = sp->fields[fi];
+            int d = digits[obj * sp->num_fields + fi];
+            o->has_field[field] = d != 0;
+            if (d == 0 || d == 1) {
+                o->value[field] = VAL_NULL;
+            } else if (d == 2) {
+                o->value[field] = VAL_PTR(sp->k + 1);
+            } else if (d < sp->heap_ptr) {
+                o->value[field] = int_value(sp, d - HEAP_DIGIT_INT, obj * MAX_FIELDS + field);
+            } else {
+                o->value[field] = VAL_PTR(d - sp->heap_ptr + 1);
+            }
+        }
+    }
+    env->p = env_value(sp, digits[sp->num_slots - 2], 0);
+    env->q = env_value(sp, digits[sp->num_slots - 1], 1);
+}
+
+static void visit(Worker* w, const int* digits, unsigned long long task) {
+    Space* sp = w->space;
+    Env env;
+    Eval kernel_res;
+    Eval graph_res;
+    w->stats.canonical++;
+    fill_heap(sp, digits, w->heap, &env);
+    kernel_res = sp->kernel->fn(w->heap, env.p, env.q);
+    graph_res = graph_eval_trace(sp->graph, w->heap, &env, w->nodes, w->seen);
+    if (kernel_res.ok && graph_res.ok && kernel_res.value == graph_res.value) {
+        w->stats.ok++;
+    } else if (!kernel_res.ok && !graph_res.ok && kernel_res.err == graph_res.err) {
+        w->stats.fail++;
+    } else {
+        w->stats.mismatch++;
+        /* tasks run in enumeration order, so the first witness of a task is its lowest */
+        if (!w->stats.witness_heap || task < w->witness_index) {
+            heap_free(w->stats.witness_heap);
+            w->stats.witness_heap = heap_clone(w->heap);
+            w->stats.witness_env = env;
+            w->stats.witness_kernel = kernel_res;
+            w->stats.witness_graph = graph_res;
+            w->witness_index = task;
+        }
+    }
+}
+
+static void walk(Worker* w, int* digits, int pos, int next, unsigned long long task) {
+    const Space* sp = w->space;
+    int choice[MAX_CHOICES];
+    int nexts[MAX_CHOICES];
+    int n;
+    int i;
+    if (pos == sp->num_slots) {
+        if (next == sp->k + 1) {
+            visit(w, digits, task);
+        }
+        return;
+    }
+    n = slot_choices(sp, pos, next, choice, nexts);
+    for (i = 0; i < n; ++i) {
+        digits[slot_at(sp, pos)] = choice[i];
+        walk(w, digits, pos + 1, nexts[i], task);
+    }
+}
+
+/* Every canonical prefix of the first sp->depth slots, one slot deeper at a
+   time until there are `target` of them or every slot is assigned. */
+static int build_tasks(Space* sp, unsigned long long target) {
+    Prefix* tasks = (Prefix*)calloc(1, sizeof(Prefix));
+    unsigned long long count = 1;
+    if (!tasks) {
+        return 0;
+    }
+    tasks[0].next = 1;
+    sp->depth = 0;
+    while (sp->depth < sp->num_slots && count > 0 && count < target) {
+        Prefix* deeper = (Prefix*)malloc((size_t)count * MAX_CHOICES * sizeof(Prefix));
+        unsigned long long out = 0;
+        unsigned long long t;
+        if (!deeper) {
+            free(tasks);
+            return 0;
+        }
+        for (t = 0; t < count; ++t) {
+            int choice[MAX_CHOICES];
+            int nexts[MAX_CHOICES];
+            int n = slot_choices(sp, sp->depth, tasks[t].next, choice, nexts);
+            int i;
+            for (i = 0; i < n; ++i) {
+                deeper[out] = tasks[t];
+                deeper[out].digits[slot_at(sp, sp->depth)] = choice[i];
+                deeper[out].next = nexts[i];
+                out++;
+            }
+        }
+        free(tasks);
+        tasks = deeper;
+        count = out;
+        sp->depth++;
+    }
+    sp->tasks = tasks;
+    sp->num_tasks = count;
+    return 1;
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    Space* sp = w->space;
+    int n = graph_num_nodes(sp->graph);
+    int digits[MAX_SLOTS];
+
+    w->nodes = (Eval*)calloc((size_t)n + 1, sizeof(Eval));
+    w->seen = (unsigned char*)calloc((size_t)n + 1, 1);
+    w->heap = heap_create(sp->k > 0 ? sp->k : 1);
+    if (w->nodes && w->seen && w->heap) {
+        w->heap->num_objs = sp->k;
+        for (;;) {
+            unsigned long long task = claim_task(sp);
+            if (task >= sp->num_tasks) {
+                break;
+            }
+            memcpy(digits, sp->tasks[task].digits, sizeof(digits));
+            walk(w, digits, sp->depth, sp->tasks[task].next, task);
+        }
+    }
+
+    free(w->nodes);
+    free(w->seen);
+    heap_free(w->heap);
+    return NULL;
+}
+
+static int run_space(Space* sp, int threads, ExhaustiveStats* stats) {
+    Worker* workers;
+    Worker* best = NULL;
+    int t;
+    int started = 0;
+#ifndef _WIN32
+    pthread_t* tids;
+#endif
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (!build_tasks(sp, (unsigned long long)threads * TASKS_PER_THREAD)) {
+        return 0;
+    }
+    workers = (Worker*)calloc((size_t)threads, sizeof(Worker));
+    if (!workers) {
+        free(sp->tasks);
+        return 0;
+    }
+#ifndef _WIN32
+    tids = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    if (!tids) {
+        free(workers);
+        free(sp->tasks);
+        return 0;
+    }
+#endif
+    for (t = 0; t < threads; ++t) {
+        workers[t].space = sp;
+    }
+#ifndef _WIN32
+    /* a worker that fails to start just leaves its tasks to the others */
+    for (t = 1; t < threads; ++t) {
+        if (pthread_create(&tids[started], NULL, worker_main, &workers[t]) == 0) {
+            started++;
+        }
+    }
+#endif
+    worker_main(&workers[0]);
+#ifndef _WIN32
+    for (t = 0; t < started; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+    free(tids);
+#endif
+
+    for (t = 0; t < threads; ++t) {
+        Worker* w = &workers[t];
+        stats->canonical += w->stats.canonical;
+        stats->ok += w->stats.ok;
+        stats->fail += w->stats.fail;
+        stats->mismatch += w->stats.mismatch;
+        if (w->stats.witness_heap && (!best || w->witness_index < best->witness_index)) {
+            best = w;
+        }
+    }
+    /* keep the lowest witness of the smallest heap size that has one */
+    for (t = 0; t < threads; ++t) {
+        Worker* w = &workers[t];
+        if (w == best && !stats->witness_heap) {
+            stats->witness_heap = w->stats.witness_heap;
+            stats->witness_env = w->stats.witness_env;
+            stats->witness_kernel = w->stats.witness_kernel;
+            stats->witness_graph = w->stats.witness_graph;
+        } else {
+            heap_free(w->stats.witness_heap);
+        }
+    }
+    free(workers);
+    free(sp->tasks);
+    return 1;
+}
+
+/* The fixed int classes: 0, every distinct constant of the graph, then one
+   value shared by all slots that is none of those. Returns how many, or -1
+   when the graph has more than EXHAUSTIVE_MAX_CONSTS constants. */
+static int int_classes(const Graph* graph, int* vals, int* fresh_base) {
+    int n = 1;
+    int top = 0;
+    int id;
+    int i;
+    vals[0] = 0;
+    for (id = 1; id <= graph_num_nodes(graph); ++id) {
+        GraphNodeInfo info;
+        if (!graph_node_info(graph, id, &info) || strcmp(info.kind, "const_int") != 0) {
+            continue;
+        }
+        for (i = 0; i < n && vals[i] != info.value; ++i) {
+        }
+        if (i < n) {
+            continue;
+        }
+        if (n == EXHAUSTIVE_MAX_CONSTS + 1) {
+            return -1;
+        }
+        vals[n++] = info.value;
+        top = info.value > top ? info.value : top;
+    }
+    /* above every constant, so the shared and fresh values meet none of them */
+    vals[n++] = top + 1;
+    *fresh_base = top + 2;
+    return n;
+}
+
+int exhaustive_check(const Graph* graph, const Kernel* kernel, const ExhaustiveConfig* cfg,
+                     ExhaustiveStats* stats) {
+    unsigned mask;
+    int use_p;
+    int use_q;
+    int int_vals[MAX_INT_CLASSES];
+    int num_int_vals;
+    int fresh_base;
+    int k;
+    int f;
+
+    if (!graph || !kernel || !cfg || !stats || cfg->max_objs < 0 || cfg->max_objs > EXHAUSTIVE_MAX_OBJS) {
+        return 0;
+    }
+    memset(stats, 0, sizeof(*stats));
+    mask = graph_field_mask(graph);
+    use_p = graph_has_input(graph, "p");
+    use_q = graph_has_input(graph, "q");
+    stats->field_mask = mask;
+    num_int_vals = int_classes(graph, int_vals, &fresh_base);
+    if (num_int_vals < 0) {
+        return 0;
+    }
+    stats->int_classes = num_int_vals + 1;
+
+    for (k = 0; k <= cfg->max_objs; ++k) {
+        Space sp;
+        unsigned long long total;
+        int s;
+        memset(&sp, 0, sizeof(sp));
+        sp.graph = graph;
+        sp.kernel = kernel;
+        sp.k = k;
+        sp.int_vals = int_vals;
+        sp.num_int_vals = num_int_vals;
+        sp.fresh_base = fresh_base;
+        sp.heap_ptr = HEAP_DIGIT_INT + num_int_vals + 1;
+        sp.env_ptr = ENV_DIGIT_INT + num_int_vals + 1;
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            if (mask & (1u << f)) {
+                sp.fields[sp.num_fields++] = f;
+            }
+        }
+        sp.num_slots = k * sp.num_fields + 2;
+        for (s = 0; s < sp.num_slots - 2; ++s) {
+            sp.radix[s] = sp.heap_ptr + k;
+        }
+        sp.radix[sp.num_slots - 2] = use_p ? sp.env_ptr + k : 1;
+        sp.radix[sp.num_slots - 1] = use_q ? sp.env_ptr + k : 1;
+        /* the raw space the canonical heaps stand for, saturating at 2^64 - 1 */
+        for (s = 0, total = 1; s < sp.num_slots; ++s) {
+            if (total > ULLONG_MAX / (unsigned long long)sp.radix[s]) {
+                total = ULLONG_MAX;
+                break;
+            }
+            total *= (unsigned long long)sp.radix[s];
+        }
+        stats->candidates = total > ULLONG_MAX - stats->candidates ? ULLONG_MAX : stats->candidates + total;
+        if (!run_space(&sp, cfg->threads, stats)) {
+            return 0;
+        }
+    }
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef EXHAUSTIVE_H
+#define EXHAUSTIVE_H
+
+#include "graph_eval.h"
+#include "kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXHAUSTIVE_MAX_OBJS 8
+#define EXHAUSTIVE_MAX_CONSTS 8 /* distinct int constants in the graph */
+
+typedef struct {
+    int max_objs; /* enumerate heaps with 0..max_objs reachable objects */
+    int threads;
+} ExhaustiveConfig;
+
+typedef struct {
+    unsigned long long candidates; /* raw assignments the canonical ones stand for (saturates) */
+    unsigned long long canonical;  /* evaluated after symmetry reduction */
+    unsigned long long ok;
+    unsigned long long fail;
+    unsigned long long mismatch;
+    unsigned field_mask;           /* fields enumerated (read by the graph) */
+    int int_classes;               /* values an int slot ranges over */
+    Heap* witness_heap;            /* one mismatching heap, NULL if none; caller frees */
+    Env witness_env;
+    Eval witness_kernel;
+    Eval witness_graph;
+} ExhaustiveStats;
+
+/* Check kernel against graph on every heap/env up to cfg->max_objs objects.
+   Only fields the graph reads are enumerated (others stay absent), and only
+   heaps whose objects are all reachable from the roots and numbered in BFS
+   order from (p, q) are evaluated: every other heap is an address permutation
+   or an unreachable extension of one of those. Each slot ranges over absent,
+   null, one dangling pointer, every in-heap address and the int classes: 0,
+   each constant of the graph, one value shared by every slot, and a value
+   fresh to the slot. Kernels that only test ints for zero, against the
+   graph's constants or for equality with each other cannot tell two ints
+   of one class apart, so for them the check covers every int; sums are not
+   enumerated (ck_add results can coincide with other ints). Slots are
+   assigned in BFS order, so only canonical heaps are generated: a prefix
+   that can no longer become one is dropped with everything below it. The
+   witness is the first mismatch in that order, whatever the thread count.
+   Returns 0 on bad arguments, allocation failure or more than
+   EXHAUSTIVE_MAX_CONSTS distinct constants. */
+int exhaustive_check(const Graph* graph, const Kernel* kernel, const ExhaustiveConfig* cfg,
+                     ExhaustiveStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "fuzz.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    Heap* heap;
+    Env env;
+} CorpusEntry;
+
+typedef struct {
+    const Graph* graph;
+    const Kernel* kernel;
+    int num_nodes;
+    Eval* nodes;
+    unsigned char* seen;
+    unsigned char* covered; /* (num_nodes + 1) * FUZZ_OUTCOMES */
+    FuzzMismatchFn on_mismatch;
+    void* ctx;
+    FuzzStats* stats;
+} FuzzState;
+
+void fuzz_config_default(FuzzConfig* cfg) {
+    if (!cfg) {
+        return;
+    }
+    cfg->max_evals = 2000;
+    cfg->heap_objs = 6;
+    cfg->num_seeds = 4;
+    cfg->max_corpus = 512;
+    cfg->seed = 1234;
+}
+
+static int outcome_of(Eval e) {
+    if (e.ok) {
+        return 0;
+    }
+    if ((int)e.err <= 0 || (int)e.err >= FUZZ_OUTCOMES) {
+        return ERR_INVALID;
+    }
+    return (int)e.err;
+}
+
+static int state_init(FuzzState* st, const Graph* graph, const Kernel* kernel, FuzzStats* stats) {
+    memset(st, 0, sizeof(*st));
+    st->graph = graph;
+    st->kernel = kernel;
+    st->num_nodes = graph_num_nodes(graph);
+    st->nodes = (Eval*)calloc((size_t)st->num_nodes + 1, sizeof(Eval));
+    st->seen = (unsigned char*)calloc((size_t)st->num_nodes + 1, 1);
+    st->covered = (unsigned char*)calloc(((size_t)st->num_nodes + 1) * FUZZ_OUTCOMES, 1);
+    st->stats = stats;
+    memset(stats, 0, sizeof(*stats));
+    if (!st->nodes || !st->seen || !st->covered) {
+        free(st->nodes);
+        free(st->seen);
+        free(st->covered);
+        return 0;
+    }
+    return 1;
+}
+
+static void state_free(FuzzState* st) {
+    free(st->nodes);
+    free(st->seen);
+    free(st->covered);
+}
+
+/* Run kernel and graph once; returns the number of new (node, outcome) pairs. */
+static int run_one(FuzzState* st, Heap* heap, const Env* env) {
+    Eval kernel_res = st->kernel->fn(heap, env->p, env->q);
+    Eval graph_res = graph_eval_trace(st->graph, heap, env, st->nodes, st->seen);
+    int fresh = 0;
+    int id;
+
+    st->stats->evals++;
+    st->stats->output_counts[outcome_of(graph_res)]++;
+
+    for (id = 1; id <= st->num_nodes; ++id) {
+        unsigned char* slot;
+        if (!st->seen[id]) {
+            continue;
+        }
+        slot = &st->covered[(size_t)id * FUZZ_OUTCOMES + (size_t)outcome_of(st->nodes[id])];
+        if (!*slot) {
+            *slot = 1;
+            fresh++;
+        }
+    }
+    if (fresh) {
+        st->stats->covered += fresh;
+        st->stats->last_new_eval = st->stats->evals;
+    }
+
+    if (!((kernel_res.ok && graph_res.ok && kernel_res.value == graph_res.value) ||
+          (!kernel_res.ok && !graph_res.ok && kernel_res.err == graph_res.err))) {
+        st->stats->mismatches++;
+        if (st->on_mismatch) {
+            st->on_mismatch(st->ctx, heap, env, kernel_res, graph_res, st->stats->evals);
+        }
+    }
+    return fresh;
+}
+
+static int random_value(Rng* rng, int num_objs) {
+    switch (rng_range(rng, 0, 4)) {
+        case 0:
+            return VAL_NULL;
+        case 1:
+            return VAL_INT(rng_range(rng, 0, 9));
+        case 2:
+            return VAL_PTR(num_objs + 1); /* dangling, reaches ERR_INVALID */
+        default:
+            return VAL_PTR(rng_range(rng, 1, num_objs));
+    }
+}
+
+static void mutate(Heap* heap, Env* env, const Kernel* k, Rng* rng) {
+    int steps = rng_range(rng, 1, 3);
+    int s;
+    for (s = 0; s < steps; ++s) {
+        int choice = rng_range(rng, 0, 9);
+        if (choice < 2 && (k->use_p || k->use_q)) {
+            if (k->use_q && (!k->use_p || rng_chance(rng, 50))) {
+                env->q = random_value(rng, heap->num_objs);
+            } else {
+                env->p = random_value(rng, heap->num_objs);
+            }
+        } else if (k->num_fields > 0) {
+            Obj* obj = &heap->objs[rng_range(rng, 0, heap->num_objs - 1)];
+            int field = k->fields[rng_range(rng, 0, k->num_fields - 1)];
+            if (choice < 4) {
+                obj->has_field[field] = !obj->has_field[field];
+            } else {
+                obj->has_field[field] = 1;
+                obj->value[field] = random_value(rng, heap->num_objs);
+            }
+        }
+    }
+}
+
+int fuzz_kernel(const Graph* graph, const Kernel* kernel, const FuzzConfig* cfg,
+                FuzzMismatchFn on_mismatch, void* ctx, FuzzStats* stats) {
+    FuzzState st;
+    CorpusEntry* corpus;
+    int num_corpus = 0;
+    int i;
+    Rng rng;
+
+    if (!graph || !kernel || !cfg || !stats || cfg->heap_objs < 1 || cfg->max_corpus < 1) {
+        return 0;
+    }
+    if (!state_init(&st, graph, kernel, stats)) {
+        return 0;
+    }
+    st.on_mismatch = on_mismatch;
+    st.ctx = ctx;
+    corpus = (CorpusEntry*)calloc((size_t)cfg->max_corpus, sizeof(CorpusEntry));
+    if (!corpus) {
+        state_free(&st);
+        return 0;
+    }
+
+    rng_seed(&rng, cfg->seed);
+    for (i = 0; i < cfg->num_seeds && stats->evals < cfg->max_evals; ++i) {
+        Heap* heap = heap_create(cfg->heap_objs);
+        Env env;
+        if (!heap) {
+            break;
+        }
+        heap_randomize(heap, kernel->fields, kernel->num_fields, &rng);
+        env_randomize(&env, heap->num_objs, &rng, kernel->use_p, kernel->use_q);
+        if (run_one(&st, heap, &env) && num_corpus < cfg->max_corpus) {
+            corpus[num_corpus].heap = heap;
+            corpus[num_corpus].env = env;
+            num_corpus++;
+        } else {
+            heap_free(heap);
+        }
+    }
+
+    while (num_corpus > 0 && stats->evals < cfg->max_evals) {
+        const CorpusEntry* parent = &corpus[rng_range(&rng, 0, num_corpus - 1)];
+        Heap* heap = heap_clone(parent->heap);
+        Env env = parent->env;
+        if (!heap) {
+            break;
+        }
+        mutate(heap, &env, kernel, &rng);
+        if (run_one(&st, heap, &env) && num_corpus < cfg->max_corpus) {
+            corpus[num_corpus].heap = heap;
+            corpus[num_corpus].env = env;
+            num_corpus++;
+        } else {
+            heap_free(heap);
+        }
+    }
+
+    stats->corpus_size = num_corpus;
+    for (i = 0; i < num_corpus; ++i) {
+        heap_free(corpus[i].heap);
+    }
+    free(corpus);
+    state_free(&st);
+    return 1;
+}
+
+int fuzz_uniform_coverage(const Graph* graph, const Kernel* kernel, const FuzzConfig* cfg,
+                          FuzzStats* stats) {
+    FuzzState st;
+    Rng rng;
+    int i;
+
+    if (!graph || !kernel || !cfg || !stats || cfg->heap_objs < 1) {
+        return 0;
+    }
+    if (!state_init(&st, graph, kernel, stats)) {
+        return 0;
+    }
+    rng_seed(&rng, cfg->seed);
+    for (i = 0; i < cfg->max_evals; ++i) {
+        Heap* heap = heap_create(cfg->heap_objs);
+        Env env;
+        if (!heap) {
+            break;
+        }
+        heap_randomize(heap, kernel->fields, kernel->num_fields, &rng);
+        env_randomize(&env, heap->num_objs, &rng, kernel->use_p, kernel->use_q);
+        run_one(&st, heap, &env);
+        heap_free(heap);
+    }
+    state_free(&st);
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include "graph_eval.h"
+#include "kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* outcome slots per node: OK plus the four Err codes */
+#define FUZZ_OUTCOMES 5
+
+typedef struct {
+    int max_evals;  /* evaluation budget */
+    int heap_objs;  /* objects per heap */
+    int num_seeds;  /* random heaps seeding the corpus */
+    int max_corpus; /* corpus entries kept */
+    unsigned seed;
+} FuzzConfig;
+
+typedef struct {
+    int evals;
+    int corpus_size;
+    int covered;       /* distinct (node, outcome) pairs reached */
+    int last_new_eval; /* evaluation count when coverage last grew */
+    int output_counts[FUZZ_OUTCOMES];
+    int mismatches;
+} FuzzStats;
+
+typedef void (*FuzzMismatchFn)(void* ctx, const Heap* heap, const Env* env,
+                               Eval kernel_res, Eval graph_res, int eval_index);
+
+void fuzz_config_default(FuzzConfig* cfg);
+
+/* Coverage-guided search: keep every heap/env that reaches a new (node, outcome)
+   pair of the graph and derive further inputs by mutating the corpus.
+   Returns 0 on allocation failure. */
+int fuzz_kernel(const Graph* graph, const Kernel* kernel, const FuzzConfig* cfg,
+                FuzzMismatchFn on_mismatch, void* ctx, FuzzStats* stats);
+
+/* Same bookkeeping over heap_randomize draws, as the baseline to compare against. */
+int fuzz_uniform_coverage(const Graph* graph, const Kernel* kernel, const FuzzConfig* cfg,
+                          FuzzStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
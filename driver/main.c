@@ -1,26 +1,21 @@
+#include "exhaustive.h"
+#include "fuzz.h"
 #include "graph_eval.h"
 #include "heap_gen.h"
+#include "heap_stats.h"
+#include "kernels.h"
+#include "manifest.h"
+#include "minimize.h"
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-Eval triple_deref(Heap* heap, int p, int q);
-Eval field_chain(Heap* heap, int p, int q);
-Eval guarded_chain(Heap* heap, int p, int q);
-Eval alias_branch(Heap* heap, int p, int q);
-Eval mixed_fields(Heap* heap, int p, int q);
-Eval add_two(Heap* heap, int p, int q);
-
-typedef Eval (*KernelFn)(Heap*, int, int);
-
-typedef struct {
-    const char* name;
-    KernelFn fn;
-    int fields[MAX_FIELDS];
-    int num_fields;
-    int use_p;
-    int use_q;
-} Kernel;
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
 
 static void format_value(int tagged, char* buf, size_t n) {
     if (tagged == VAL_NULL) {
@@ -70,6 +65,77 @@ static int copy_file(const char* src, const char* dst) {
     return 1;
 }
 
+typedef struct {
+    const char* out_dir;
+    const Kernel* kernel;
+    const Graph* graph;
+    const char* graph_path;
+    int minimize;
+} MismatchSink;
+
+/* Full witness + graph copy, then the delta-debugged witness next to it. */
+static void write_mismatch(const MismatchSink* sink, const char* tag, int index,
+                           const Env* env, const Heap* heap, Eval kernel_res, Eval graph_res) {
+    char witness_path[512];
+    char graph_copy[512];
+    const char* name = sink->kernel->name;
+    snprintf(witness_path, sizeof(witness_path), "%s/%s_%s_%d.json", sink->out_dir, name, tag, index);
+    write_witness(witness_path, env, heap, kernel_res, graph_res);
+    snprintf(graph_copy, sizeof(graph_copy), "%s/%s_%s_%d.graph.json", sink->out_dir, name, tag, index);
+    copy_file(sink->graph_path, graph_copy);
+
+    if (sink->minimize) {
+        MinimizeStats mst;
+        Env min_env;
+        Heap* min_heap = minimize_mismatch(sink->graph, sink->kernel->fn, heap, env, &min_env, &mst);
+        if (min_heap) {
+            Eval min_kernel = sink->kernel->fn(min_heap, min_env.p, min_env.q);
+            Eval min_graph = graph_eval(sink->graph, min_heap, &min_env);
+            snprintf(witness_path, sizeof(witness_path), "%s/%s_%s_%d.min.json", sink->out_dir, name, tag, index);
+            write_witness(witness_path, &min_env, min_heap, min_kernel, min_graph);
+            printf("  minimized %s: objs %d->%d fields %d->%d in %d evals\n", witness_path,
+                   mst.objs_before, mst.objs_after, mst.fields_before, mst.fields_after, mst.evals);
+            heap_free(min_heap);
+        }
+    }
+}
+
+static void on_fuzz_mismatch(void* ctx, const Heap* heap, const Env* env,
+                             Eval kernel_res, Eval graph_res, int eval_index) {
+    write_mismatch((const MismatchSink*)ctx, "fuzz_mismatch", eval_index, env, heap, kernel_res, graph_res);
+}
+
+static void print_fuzz_stats(const char* label, const FuzzStats* st) {
+    printf("  %s: evals=%d covered=%d last_new=%d corpus=%d mismatch=%d outputs(ok/null/invalid/type/missing)=%d/%d/%d/%d/%d\n",
+           label, st->evals, st->covered, st->last_new_eval, st->corpus_size, st->mismatches,
+           st->output_counts[0], st->output_counts[ERR_NULL], st->output_counts[ERR_INVALID],
+           st->output_counts[ERR_TYPE], st->output_counts[ERR_MISSING_FIELD]);
+}
+
+static void write_profile(const char* out_dir, const char* name, const Graph* graph) {
+    char path[512];
+    FILE* f;
+    if (!graph_profile_enabled()) {
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s_profile.json", out_dir, name);
+    f = fopen(path, "w");
+    if (!f) {
+        return;
+    }
+    graph_profile_write_json(graph, f);
+    fclose(f);
+}
+
+static int default_threads(void) {
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
 static int ensure_dir(const char* path) {
 #ifdef _WIN32
     const char* cmd = "mkdir";
@@ -81,14 +147,82 @@ static int ensure_dir(const char* path) {
     return system(buf) == 0;
 }
 
+/* Kernels are found by name: first in --kernel_lib, then among the
+   symbols the driver itself exports (the built-in kernels). */
+static void* open_kernel_lib(const char* path) {
+#ifdef _WIN32
+    return (void*)LoadLibraryA(path);
+#else
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static KernelFn find_kernel(void* lib, const char* name) {
+    void* sym = NULL;
+#ifdef _WIN32
+    if (lib) {
+        sym = (void*)GetProcAddress((HMODULE)lib, name);
+    }
+    if (!sym) {
+        sym = (void*)GetProcAddress(GetModuleHandleA(NULL), name);
+    }
+#else
+    if (lib) {
+        sym = dlsym(lib, name);
+    }
+    if (!sym) {
+        sym = dlsym(RTLD_DEFAULT, name);
+    }
+#endif
+    return (KernelFn)sym;
+}
+
+/* Fill a Kernel from its manifest entry; 0 when the function is not found. */
+static int kernel_from_manifest(const ManifestKernel* entry, void* lib, Kernel* k) {
+    int j;
+    memset(k, 0, sizeof(*k));
+    k->name = entry->name;
+    k->fn = find_kernel(lib, entry->name);
+    if (!k->fn) {
+        return 0;
+    }
+    for (j = 0; j < entry->num_fields; ++j) {
+        k->fields[j] = entry->fields[j];
+    }
+    k->num_fields = entry->num_fields;
+    if (k->num_fields == 0) {
+        /* reads no field (e.g. returns an input): still give the heap pointers */
+        k->fields[0] = FIELD_DEREF;
+        k->num_fields = 1;
+    }
+    k->use_p = manifest_kernel_has_input(entry, "p");
+    k->use_q = manifest_kernel_has_input(entry, "q");
+    return 1;
+}
+
 int main(int argc, char** argv) {
     int trials = 200;
     unsigned seed = 1234;
     const char* graph_dir = "out";
     const char* out_dir = "out";
+    const char* manifest_path = NULL;
+    const char* kernel_lib = NULL;
+    char manifest_buf[512];
+    Manifest* manifest;
+    void* lib = NULL;
     int debug_one = 0;
+    int heap_objs = 6;
+    int use_shape = 0;
+    HeapGenConfig gen;
+    int fuzz_evals = 0;
+    int minimize = 1;
+    int exhaustive_objs = -1;
+    int threads = default_threads();
+    int trusted = 0;
     int i;
 
+    heap_gen_config_default(&gen, HEAP_SHAPE_UNIFORM);
+
     for (i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc) {
             trials = atoi(argv[++i]);
@@ -98,29 +232,83 @@ int main(int argc, char** argv) {
             graph_dir = argv[++i];
         } else if (strcmp(argv[i], "--out_dir") == 0 && i + 1 < argc) {
             out_dir = argv[++i];
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifest_path = argv[++i];
+        } else if (strcmp(argv[i], "--kernel_lib") == 0 && i + 1 < argc) {
+            kernel_lib = argv[++i];
         } else if (strcmp(argv[i], "--debug_one") == 0) {
             debug_one = 1;
+        } else if (strcmp(argv[i], "--heap_objs") == 0 && i + 1 < argc) {
+            heap_objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shape") == 0 && i + 1 < argc) {
+            HeapShape shape;
+            if (!heap_shape_parse(argv[++i], &shape)) {
+                fprintf(stderr, "unknown shape %s\n", argv[i]);
+                return 1;
+            }
+            gen.shape = shape;
+            use_shape = 1;
+        } else if (strcmp(argv[i], "--null_pct") == 0 && i + 1 < argc) {
+            gen.null_pct = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--int_pct") == 0 && i + 1 < argc) {
+            gen.int_pct = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--missing_pct") == 0 && i + 1 < argc) {
+            gen.missing_pct = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--share_pct") == 0 && i + 1 < argc) {
+            gen.share_pct = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            fuzz_evals = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trusted") == 0) {
+            trusted = 1;
+        } else if (strcmp(argv[i], "--no_minimize") == 0) {
+            minimize = 0;
+        } else if (strcmp(argv[i], "--exhaustive") == 0 && i + 1 < argc) {
+            exhaustive_objs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
         }
     }
 
+    if (exhaustive_objs > EXHAUSTIVE_MAX_OBJS) {
+        fprintf(stderr, "exhaustive bound must be <= %d\n", EXHAUSTIVE_MAX_OBJS);
+        return 1;
+    }
+
+    if (heap_objs < 1) {
+        fprintf(stderr, "heap_objs must be >= 1\n");
+        return 1;
+    }
+
+    if (!heap_gen_config_valid(&gen)) {
+        fprintf(stderr, "percentages must be in 0..100, with null_pct + int_pct + missing_pct <= 100\n");
+        return 1;
+    }
+
     if (debug_one) {
         trials = 1;
     }
 
+    if (!manifest_path) {
+        snprintf(manifest_buf, sizeof(manifest_buf), "%s/manifest.json", graph_dir);
+        manifest_path = manifest_buf;
+    }
+    manifest = manifest_load_json(manifest_path);
+    if (!manifest) {
+        fprintf(stderr, "missing manifest %s (run the guarded-graph pass)\n", manifest_path);
+        return 1;
+    }
+    if (kernel_lib && !(lib = open_kernel_lib(kernel_lib))) {
+        fprintf(stderr, "cannot load kernel library %s\n", kernel_lib);
+        manifest_free(manifest);
+        return 1;
+    }
+
     ensure_dir(out_dir);
 
-    Kernel kernels[] = {
-        {"triple_deref", triple_deref, {FIELD_DEREF}, 1, 1, 0},
-        {"field_chain", field_chain, {FIELD_F, FIELD_G, FIELD_DEREF}, 3, 1, 0},
-        {"guarded_chain", guarded_chain, {FIELD_DEREF}, 1, 1, 0},
-        {"alias_branch", alias_branch, {FIELD_DEREF}, 1, 1, 1},
-        {"mixed_fields", mixed_fields, {FIELD_F, FIELD_G, FIELD_DEREF}, 3, 1, 0},
-        {"add_two", add_two, {FIELD_DEREF}, 1, 1, 1},
-    };
-    int num_kernels = (int)(sizeof(kernels) / sizeof(kernels[0]));
-
-    for (i = 0; i < num_kernels; ++i) {
-        Kernel* k = &kernels[i];
+    for (i = 0; i < manifest->num_kernels; ++i) {
+        const ManifestKernel* entry = &manifest->kernels[i];
+        Kernel kernel;
+        Kernel* k = &kernel;
         char graph_path[512];
         Graph* graph;
         int t;
@@ -128,19 +316,84 @@ int main(int argc, char** argv) {
         int fail_count = 0;
         int mismatch_count = 0;
         int witness_written = 0;
+        int valid_heaps = 0;
+        int trusted_heaps = 0;
+        HeapStats heap_totals;
+        MismatchSink sink;
         Rng rng;
 
-        snprintf(graph_path, sizeof(graph_path), "%s/%s.json", graph_dir, k->name);
+        if (!kernel_from_manifest(entry, lib, k)) {
+            fprintf(stderr, "%s: kernel function not found\n", entry->name);
+            continue;
+        }
+        snprintf(graph_path, sizeof(graph_path), "%s/%s", graph_dir, entry->graph);
         graph = graph_load_json(graph_path);
         if (!graph) {
             fprintf(stderr, "%s: missing graph %s\n", k->name, graph_path);
             continue;
         }
 
+        sink.out_dir = out_dir;
+        sink.kernel = k;
+        sink.graph = graph;
+        sink.graph_path = graph_path;
+        sink.minimize = minimize;
+
+        if (exhaustive_objs >= 0) {
+            ExhaustiveConfig ecfg;
+            ExhaustiveStats est;
+            ecfg.max_objs = exhaustive_objs;
+            ecfg.threads = threads;
+            if (!exhaustive_check(graph, k, &ecfg, &est)) {
+                fprintf(stderr, "%s: exhaustive check failed\n", k->name);
+            } else {
+                printf("%s: exhaustive objs<=%d field_mask=0x%x int_classes=%d threads=%d\n",
+                       k->name, exhaustive_objs, est.field_mask, est.int_classes, threads);
+                printf("  candidates=%s%llu canonical=%llu ok=%llu fail=%llu mismatch=%llu\n",
+                       est.candidates == ULLONG_MAX ? ">=" : "", est.candidates, est.canonical, est.ok,
+                       est.fail, est.mismatch);
+                if (est.witness_heap) {
+                    write_mismatch(&sink, "exhaustive_mismatch", 0, &est.witness_env, est.witness_heap,
+                                   est.witness_kernel, est.witness_graph);
+                    heap_free(est.witness_heap);
+                    printf("  WARNING: mismatches detected\n");
+                } else {
+                    printf("  equivalent on every heap up to %d objects\n", exhaustive_objs);
+                }
+            }
+            write_profile(out_dir, k->name, graph);
+            graph_free(graph);
+            continue;
+        }
+
+        if (fuzz_evals > 0) {
+            FuzzConfig fcfg;
+            FuzzStats guided;
+            FuzzStats uniform;
+            fuzz_config_default(&fcfg);
+            fcfg.max_evals = fuzz_evals;
+            fcfg.heap_objs = heap_objs;
+            fcfg.seed = seed;
+            printf("%s: fuzz budget=%d\n", k->name, fuzz_evals);
+            if (fuzz_kernel(graph, k, &fcfg, on_fuzz_mismatch, &sink, &guided)) {
+                print_fuzz_stats("guided ", &guided);
+            }
+            if (fuzz_uniform_coverage(graph, k, &fcfg, &uniform)) {
+                print_fuzz_stats("uniform", &uniform);
+            }
+            if (guided.mismatches) {
+                printf("  WARNING: mismatches detected\n");
+            }
+            write_profile(out_dir, k->name, graph);
+            graph_free(graph);
+            continue;
+        }
+
         rng_seed(&rng, seed);
+        memset(&heap_totals, 0, sizeof(heap_totals));
 
         for (t = 0; t < trials; ++t) {
-            Heap* heap = heap_create(6);
+            Heap* heap = heap_create(heap_objs);
             Env env;
             Eval kernel_res;
             Eval graph_res;
@@ -148,8 +401,26 @@ int main(int argc, char** argv) {
             if (!heap) {
                 break;
             }
-            heap_randomize(heap, k->fields, k->num_fields, &rng);
+            if (use_shape) {
+                heap_generate(heap, k->fields, k->num_fields, &gen, &rng);
+            } else {
+                heap_randomize(heap, k->fields, k->num_fields, &rng);
+            }
             env_randomize(&env, heap->num_objs, &rng, k->use_p, k->use_q);
+            {
+                HeapStats hs;
+                if (heap_stats(heap, 1, &hs)) {
+                    heap_stats_add(&heap_totals, &hs);
+                    valid_heaps += hs.dangling == 0;
+                    /* trust reuses the scan; heaps with dangling pointers run checked */
+                    if (trusted) {
+                        int inputs[2];
+                        inputs[0] = env.p;
+                        inputs[1] = env.q;
+                        trusted_heaps += heap_trust_stats(heap, &hs, inputs, 2);
+                    }
+                }
+            }
 
             kernel_res = k->fn(heap, env.p, env.q);
             graph_res = graph_eval(graph, heap, &env);
@@ -183,12 +454,7 @@ int main(int argc, char** argv) {
             }
 
             if (!same) {
-                char witness_path[512];
-                char graph_copy[512];
-                snprintf(witness_path, sizeof(witness_path), "%s/%s_mismatch_%d.json", out_dir, k->name, t);
-                write_witness(witness_path, &env, heap, kernel_res, graph_res);
-                snprintf(graph_copy, sizeof(graph_copy), "%s/%s_mismatch_%d.graph.json", out_dir, k->name, t);
-                copy_file(graph_path, graph_copy);
+                write_mismatch(&sink, "mismatch", t, &env, heap, kernel_res, graph_res);
             }
 
             heap_free(heap);
@@ -218,9 +484,18 @@ int main(int argc, char** argv) {
         if (mismatch_count) {
             printf("  WARNING: mismatches detected\n");
         }
+        /* what the trial heaps held, over the fields this kernel reads */
+        if (trusted) {
+            printf("  heaps: valid=%d/%d trusted=%d/%d\n", valid_heaps, trials, trusted_heaps, trials);
+        } else {
+            printf("  heaps: valid=%d/%d\n", valid_heaps, trials);
+        }
+        heap_stats_write(&heap_totals, k->fields, k->num_fields, "    ", stdout);
 
+        write_profile(out_dir, k->name, graph);
         graph_free(graph);
     }
 
+    manifest_free(manifest);
     return 0;
 }
@@ -0,0 +1,242 @@
+#include "minimize.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const Graph* graph;
+    KernelFn fn;
+    Eval* nodes;
+    unsigned char* seen;
+    int kernel_outcome;
+    int graph_outcome;
+    MinimizeStats* stats;
+} Oracle;
+
+static int outcome_of(Eval e) {
+    return e.ok ? 0 : (int)e.err;
+}
+
+static int results_agree(Eval a, Eval b) {
+    return (a.ok && b.ok && a.value == b.value) || (!a.ok && !b.ok && a.err == b.err);
+}
+
+/* The property being preserved: still a mismatch, with the original outcomes. */
+static int still_fails(Oracle* o, Heap* heap, const Env* env) {
+    Eval kernel_res = o->fn(heap, env->p, env->q);
+    Eval graph_res = graph_eval_trace(o->graph, heap, env, o->nodes, o->seen);
+    o->stats->evals++;
+    return !results_agree(kernel_res, graph_res) &&
+           outcome_of(kernel_res) == o->kernel_outcome &&
+           outcome_of(graph_res) == o->graph_outcome;
+}
+
+static int count_fields(const Heap* heap) {
+    int i, f;
+    int n = 0;
+    for (i = 0; i < heap->num_objs; ++i) {
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            n += heap->objs[i].has_field[f] != 0;
+        }
+    }
+    return n;
+}
+
+static int remap_value(int tagged, const int* remap, int old_objs) {
+    int addr;
+    if (!VAL_IS_PTR(tagged)) {
+        return tagged;
+    }
+    addr = VAL_PTR_ADDR(tagged);
+    if (addr <= 0 || addr > old_objs) {
+        return tagged; /* dangling pointers stay dangling */
+    }
+    return remap[addr] ? VAL_PTR(remap[addr]) : VAL_NULL;
+}
+
+/* Copy of heap without objects [lo, hi) (0-based); links into the gap become null. */
+static Heap* drop_objects(const Heap* heap, const Env* env, int lo, int hi, Env* out_env, int* remap) {
+    Heap* out = heap_create(heap->num_objs - (hi - lo));
+    int i, f;
+    int next = 1;
+    if (!out) {
+        return NULL;
+    }
+    remap[0] = 0;
+    for (i = 0; i < heap->num_objs; ++i) {
+        remap[i + 1] = (i >= lo && i < hi) ? 0 : next++;
+    }
+    for (i = 0; i < heap->num_objs; ++i) {
+        Obj* dst;
+        if (!remap[i + 1]) {
+            continue;
+        }
+        dst = &out->objs[remap[i + 1] - 1];
+        *dst = heap->objs[i];
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            if (dst->has_field[f]) {
+                dst->value[f] = remap_value(dst->value[f], remap, heap->num_objs);
+            }
+        }
+    }
+    out_env->p = remap_value(env->p, remap, heap->num_objs);
+    out_env->q = remap_value(env->q, remap, heap->num_objs);
+    return out;
+}
+
+/* ddmin over contiguous object ranges; each accepted cut rebuilds the heap. */
+static int shrink_objects(Oracle* o, Heap** heap, Env* env) {
+    int changed = 0;
+    int chunks = 2;
+    int* remap = (int*)malloc(((size_t)(*heap)->num_objs + 1) * sizeof(int));
+    if (!remap) {
+        return 0;
+    }
+    while ((*heap)->num_objs > 1) {
+        int n = (*heap)->num_objs;
+        int size = (n + chunks - 1) / chunks;
+        int lo;
+        int cut = 0;
+        if (chunks > n) {
+            break;
+        }
+        for (lo = 0; lo < n && (*heap)->num_objs > 1; lo += size) {
+            int hi = lo + size < n ? lo + size : n;
+            Env cand_env;
+            Heap* cand;
+            if (hi - lo >= (*heap)->num_objs) {
+                continue;
+            }
+            cand = drop_objects(*heap, env, lo, hi, &cand_env, remap);
+            if (!cand) {
+                continue;
+            }
+            if (still_fails(o, cand, &cand_env)) {
+                heap_free(*heap);
+                *heap = cand;
+                *env = cand_env;
+                cut = 1;
+                changed = 1;
+                break;
+            }
+            heap_free(cand);
+        }
+        if (cut) {
+            chunks = chunks > 2 ? chunks - 1 : 2;
+        } else if (size == 1) {
+            break;
+        } else {
+            chunks *= 2;
+        }
+    }
+    free(remap);
+    return changed;
+}
+
+/* Try each edit in place and undo it when the mismatch disappears. */
+static int shrink_fields(Oracle* o, Heap* heap, Env* env) {
+    int changed = 0;
+    int i, f;
+    for (i = 0; i < heap->num_objs; ++i) {
+        Obj* obj = &heap->objs[i];
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            int value;
+            if (!obj->has_field[f]) {
+                continue;
+            }
+            value = obj->value[f];
+            obj->has_field[f] = 0;
+            if (still_fails(o, heap, env)) {
+                changed = 1;
+                continue;
+            }
+            obj->has_field[f] = 1;
+            if (value != VAL_NULL && value != VAL_INT(0)) {
+                obj->value[f] = VAL_IS_PTR(value) ? VAL_NULL : VAL_INT(0);
+                if (still_fails(o, heap, env)) {
+                    changed = 1;
+                    continue;
+                }
+                obj->value[f] = value;
+            }
+        }
+    }
+    if (env->p != VAL_NULL) {
+        int p = env->p;
+        env->p = VAL_NULL;
+        if (still_fails(o, heap, env)) {
+            changed = 1;
+        } else {
+            env->p = p;
+        }
+    }
+    if (env->q != VAL_NULL) {
+        int q = env->q;
+        env->q = VAL_NULL;
+        if (still_fails(o, heap, env)) {
+            changed = 1;
+        } else {
+            env->q = q;
+        }
+    }
+    return changed;
+}
+
+Heap* minimize_mismatch(const Graph* graph, KernelFn fn, const Heap* heap, const Env* env,
+                        Env* out_env, MinimizeStats* stats) {
+    Oracle o;
+    MinimizeStats local;
+    Heap* cur;
+    Eval kernel_res;
+    Eval graph_res;
+    int n = graph_num_nodes(graph);
+
+    if (!graph || !fn || !heap || !env || !out_env) {
+        return NULL;
+    }
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+    stats->objs_before = heap->num_objs;
+    stats->fields_before = count_fields(heap);
+
+    cur = heap_clone(heap);
+    o.graph = graph;
+    o.fn = fn;
+    o.nodes = (Eval*)calloc((size_t)n + 1, sizeof(Eval));
+    o.seen = (unsigned char*)calloc((size_t)n + 1, 1);
+    o.stats = stats;
+    if (!cur || !o.nodes || !o.seen) {
+        heap_free(cur);
+        free(o.nodes);
+        free(o.seen);
+        return NULL;
+    }
+
+    kernel_res = fn(cur, env->p, env->q);
+    graph_res = graph_eval_trace(graph, cur, env, o.nodes, o.seen);
+    stats->evals++;
+    if (results_agree(kernel_res, graph_res)) {
+        heap_free(cur);
+        free(o.nodes);
+        free(o.seen);
+        return NULL;
+    }
+    o.kernel_outcome = outcome_of(kernel_res);
+    o.graph_outcome = outcome_of(graph_res);
+
+    *out_env = *env;
+    for (;;) {
+        int changed = shrink_objects(&o, &cur, out_env);
+        changed |= shrink_fields(&o, cur, out_env);
+        if (!changed) {
+            break;
+        }
+    }
+
+    stats->objs_after = cur->num_objs;
+    stats->fields_after = count_fields(cur);
+    free(o.nodes);
+    free(o.seen);
+    return cur;
+}
\ No newline at end of file
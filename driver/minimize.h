@@ -0,0 +1,30 @@
+#ifndef MINIMIZE_H
+#define MINIMIZE_H
+
+#include "graph_eval.h"
+#include "kernels.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int evals;         /* kernel+graph evaluations spent */
+    int objs_before;
+    int objs_after;
+    int fields_before; /* present field slots */
+    int fields_after;
+} MinimizeStats;
+
+/* Delta-debug a mismatching (heap, env): drop objects, fields and links while the
+   kernel and graph still disagree with the same pair of outcomes. Returns a new
+   heap (caller frees) and writes the shrunk env to out_env, or NULL if the input
+   does not mismatch or allocation fails. */
+Heap* minimize_mismatch(const Graph* graph, KernelFn fn, const Heap* heap, const Env* env,
+                        Env* out_env, MinimizeStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
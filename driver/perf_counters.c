@@ -0,0 +1,143 @@
+#include "perf_counters.h"
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* const counter_names[PERF_NUM_COUNTERS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "dtlb_misses"
+};
+
+const char* perf_counter_name(PerfCounterId id) {
+    if ((int)id < 0 || id >= PERF_NUM_COUNTERS) {
+        return "unknown";
+    }
+    return counter_names[id];
+}
+
+#if defined(__linux__)
+static unsigned long long cache_config(unsigned cache, unsigned op, unsigned result) {
+    return (unsigned long long)cache | ((unsigned long long)op << 8) | ((unsigned long long)result << 16);
+}
+
+static int open_counter(unsigned type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    /* counters are opened independently, so report enabled/running time to
+       scale values when the PMU multiplexes them */
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+int perf_counters_open(PerfCounters* pc) {
+    int i;
+    if (!pc) {
+        return 0;
+    }
+    memset(pc, 0, sizeof(*pc));
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        pc->fds[i] = -1;
+    }
+#if defined(__linux__)
+    pc->fds[PERF_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    pc->fds[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    pc->fds[PERF_L1D_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+        cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    pc->fds[PERF_LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    pc->fds[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    pc->fds[PERF_DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+        cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (pc->fds[i] >= 0) {
+            pc->available++;
+        }
+    }
+#endif
+    return pc->available;
+}
+
+void perf_counters_start(PerfCounters* pc) {
+#if defined(__linux__)
+    int i;
+    if (!pc || pc->available == 0) {
+        return;
+    }
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (pc->fds[i] >= 0) {
+            ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    (void)pc;
+#endif
+}
+
+void perf_counters_stop(PerfCounters* pc) {
+#if defined(__linux__)
+    int i;
+    if (!pc || pc->available == 0) {
+        return;
+    }
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (pc->fds[i] >= 0) {
+            ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        unsigned long long buf[3];
+        pc->valid[i] = 0;
+        if (pc->fds[i] < 0) {
+            continue;
+        }
+        if (read(pc->fds[i], buf, sizeof(buf)) != (ssize_t)sizeof(buf) || buf[2] == 0) {
+            continue;
+        }
+        pc->values[i] = buf[2] < buf[1]
+            ? (unsigned long long)((double)buf[0] * (double)buf[1] / (double)buf[2])
+            : buf[0];
+        pc->valid[i] = 1;
+    }
+#else
+    (void)pc;
+#endif
+}
+
+void perf_counters_close(PerfCounters* pc) {
+    int i;
+    if (!pc || pc->available == 0) {
+        return;
+    }
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+#if defined(__linux__)
+        if (pc->fds[i] >= 0) {
+            close(pc->fds[i]);
+        }
+#endif
+        pc->fds[i] = -1;
+    }
+    pc->available = 0;
+}
+
+void perf_counters_print(const PerfCounters* pc, unsigned long long iters, FILE* f) {
+    int i;
+    if (!pc || !f || iters == 0) {
+        return;
+    }
+    for (i = 0; i < PERF_NUM_COUNTERS; ++i) {
+        if (pc->valid[i]) {
+            fprintf(f, " %s_per_iter=%.4f", counter_names[i], (double)pc->values[i] / (double)iters);
+        }
+    }
+}
\ No newline at end of file
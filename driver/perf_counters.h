@@ -0,0 +1,44 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NUM_COUNTERS
+} PerfCounterId;
+
+typedef struct {
+    int fds[PERF_NUM_COUNTERS];      /* -1 when the counter could not be opened */
+    unsigned long long values[PERF_NUM_COUNTERS];
+    int valid[PERF_NUM_COUNTERS];    /* value read after the last stop */
+    int available;                   /* counters opened */
+} PerfCounters;
+
+/* Open whatever hardware counters the kernel grants for this thread
+   (perf_event_open, user space only). Returns the number opened; 0 means
+   counters are unavailable and start/stop/print become no-ops, as they are
+   for a zero-initialized PerfCounters that was never opened. */
+int perf_counters_open(PerfCounters* pc);
+void perf_counters_start(PerfCounters* pc);
+void perf_counters_stop(PerfCounters* pc);
+void perf_counters_close(PerfCounters* pc);
+const char* perf_counter_name(PerfCounterId id);
+
+/* Append " <name>_per_iter=<value>" for each valid counter. */
+void perf_counters_print(const PerfCounters* pc, unsigned long long iters, FILE* f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
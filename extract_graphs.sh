@@ -0,0 +1,102 @@
+#!/usr/bin/env bash
+# Extract guarded graphs from many .ll/.bc files in parallel into one
+# directory with one merged manifest.
+#
+#   extract_graphs.sh [-j JOBS] [-o OUT_DIR] file.ll|file.bc ...
+#
+# Each input gets its own manifest under OUT_DIR/.manifests; an input whose
+# manifest is newer than both the input and the pass plugin is not rerun, and
+# inside a rerun the pass (GRAPH_INCREMENTAL=1) reuses the graph of every
+# function whose IR hash is unchanged. The per-input manifests are then
+# merged into OUT_DIR/manifest.json in argument order. Kernel names must be
+# unique across inputs, since each writes OUT_DIR/<name>.json.
+set -euo pipefail
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+OUT_DIR="${OUT_DIR:-$ROOT/out}"
+BUILD_LLVM_DIR="${BUILD_LLVM_DIR:-$ROOT/build_llvm}"
+OPT_BIN="${OPT:-opt}"
+JOBS="${JOBS:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4)}"
+
+while getopts "j:o:" opt; do
+  case "$opt" in
+    j) JOBS="$OPTARG" ;;
+    o) OUT_DIR="$OPTARG" ;;
+    *) echo "usage: $0 [-j JOBS] [-o OUT_DIR] file.ll|file.bc ..." >&2; exit 2 ;;
+  esac
+done
+shift $((OPTIND - 1))
+if [ "$#" -eq 0 ]; then
+  echo "usage: $0 [-j JOBS] [-o OUT_DIR] file.ll|file.bc ..." >&2
+  exit 2
+fi
+
+PASS_LIB="${PASS_LIB:-$BUILD_LLVM_DIR/libGuardedGraphPass.so}"
+if [ ! -f "$PASS_LIB" ] && [ -f "$BUILD_LLVM_DIR/libGuardedGraphPass.dylib" ]; then
+  PASS_LIB="$BUILD_LLVM_DIR/libGuardedGraphPass.dylib"
+fi
+MANIFEST_DIR="$OUT_DIR/.manifests"
+mkdir -p "$MANIFEST_DIR"
+
+# per-input manifest path: the input path with separators flattened
+input_manifest() {
+  local key="${1#./}"
+  key="${key//\//_}"
+  echo "$MANIFEST_DIR/${key%.*}.json"
+}
+
+extract_one() {
+  local input="$1"
+  local manifest
+  manifest="$(input_manifest "$input")"
+  if [ "$manifest" -nt "$input" ] && [ "$manifest" -nt "$PASS_LIB" ]; then
+    return 0
+  fi
+  GRAPH_OUT_DIR="$OUT_DIR" GRAPH_MANIFEST="$manifest" GRAPH_INCREMENTAL=1 \
+    "$OPT_BIN" -load-pass-plugin "$PASS_LIB" -passes="guarded-graph" -disable-output "$input"
+}
+
+export OUT_DIR OPT_BIN PASS_LIB MANIFEST_DIR
+export -f input_manifest extract_one
+
+printf '%s\0' "$@" | xargs -0 -n 1 -P "$JOBS" bash -c 'extract_one "$1"' _
+
+manifests=()
+for input in "$@"; do
+  manifests+=("$(input_manifest "$input")")
+done
+
+awk '
+  /^ *\{"name":"/ {
+    entry = $0
+    sub(/^ */, "", entry)
+    sub(/,$/, "", entry)
+    name = entry
+    sub(/^\{"name":"/, "", name)
+    sub(/".*/, "", name)
+    if (name in seen) {
+      printf "extract_graphs: %s is in both %s and %s\n", name, seen[name], FILENAME > "/dev/stderr"
+      dup = 1
+      next
+    }
+    seen[name] = FILENAME
+    entries[n++] = entry
+  }
+  END {
+    if (dup) {
+      exit 1
+    }
+    print "{"
+    print "  \"kernels\": ["
+    for (i = 0; i < n; i++) {
+      printf "    %s%s\n", entries[i], (i + 1 < n ? "," : "")
+    }
+    print "  ]"
+    print "}"
+  }
+' "${manifests[@]}" > "$OUT_DIR/manifest.json.tmp$$" || {
+  rm -f "$OUT_DIR/manifest.json.tmp$$"
+  echo "extract_graphs: duplicate kernel names, $OUT_DIR/manifest.json not updated" >&2
+  exit 1
+}
+mv "$OUT_DIR/manifest.json.tmp$$" "$OUT_DIR/manifest.json"
@@ -1,18 +1,37 @@
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSlotTracker.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Regex.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
 
 #include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <vector>
 
 using namespace llvm;
@@ -58,20 +77,122 @@ struct GraphBuilder {
     }
 };
 
-static bool isKernelName(StringRef name) {
-    return name == "triple_deref" || name == "graph_walk" || name == "field_chain" ||
-           name == "guarded_chain" || name == "alias_branch" || name == "mixed_fields" ||
-           name == "add_two";
+/* What the manifest records about one kernel besides its graph. */
+struct KernelInfo {
+    std::string name;
+    std::vector<std::string> inputs; /* in order of first use */
+    std::vector<int> fields;         /* fields read, in order of first use */
+    std::string hash;                /* kernelHash() of the IR the graph came from */
+};
+
+static const char* const kKernelAnnotation = "guarded_kernel";
+
+/* Functions tagged with __attribute__((annotate("guarded_kernel"))), which
+   clang records in llvm.global.annotations as {fn, string, file, line, ...}. */
+static std::set<const Function*> annotatedKernels(Module& M) {
+    std::set<const Function*> out;
+    GlobalVariable* ga = M.getNamedGlobal("llvm.global.annotations");
+    if (!ga || !ga->hasInitializer()) {
+        return out;
+    }
+    auto* arr = dyn_cast<ConstantArray>(ga->getInitializer());
+    if (!arr) {
+        return out;
+    }
+    for (Value* op : arr->operands()) {
+        auto* cs = dyn_cast<ConstantStruct>(op);
+        if (!cs || cs->getNumOperands() < 2) {
+            continue;
+        }
+        auto* fn = dyn_cast<Function>(cs->getOperand(0)->stripPointerCasts());
+        auto* gv = dyn_cast<GlobalVariable>(cs->getOperand(1)->stripPointerCasts());
+        if (!fn || !gv || !gv->hasInitializer()) {
+            continue;
+        }
+        auto* cda = dyn_cast<ConstantDataArray>(gv->getInitializer());
+        if (cda && cda->isString() && cda->getAsCString() == kKernelAnnotation) {
+            out.insert(fn);
+        }
+    }
+    return out;
+}
+
+static bool callsInput(const Function& F) {
+    for (const BasicBlock& BB : F) {
+        for (const Instruction& I : BB) {
+            if (auto* CI = dyn_cast<CallInst>(&I)) {
+                const Function* callee = CI->getCalledFunction();
+                if (callee && callee->getName() == "ck_input") {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/* Kernels are functions that are annotated, carry a "guarded_kernel"
+   function attribute, or match GUARDED_KERNEL_PATTERN (a regex over the
+   whole name). With none of those in play every function that calls
+   ck_input is taken, so unannotated sources keep working. */
+static std::vector<Function*> discoverKernels(Module& M) {
+    std::set<const Function*> annotated = annotatedKernels(M);
+    std::unique_ptr<Regex> pattern;
+    std::vector<Function*> out;
+    bool explicitOnly;
+
+    if (const char* env = std::getenv("GUARDED_KERNEL_PATTERN")) {
+        std::string err;
+        pattern.reset(new Regex((Twine("^(") + env + ")$").str()));
+        if (!pattern->isValid(err)) {
+            errs() << "GUARDED_KERNEL_PATTERN: " << err << "\n";
+            pattern.reset();
+        }
+    }
+    explicitOnly = pattern || !annotated.empty();
+    for (Function& F : M) {
+        if (!explicitOnly && F.hasFnAttribute(kKernelAnnotation)) {
+            explicitOnly = true;
+        }
+    }
+
+    for (Function& F : M) {
+        bool selected;
+        if (F.isDeclaration()) {
+            continue;
+        }
+        if (explicitOnly) {
+            selected = annotated.count(&F) || F.hasFnAttribute(kKernelAnnotation) ||
+                       (pattern && pattern->match(F.getName()));
+        } else {
+            selected = callsInput(F);
+        }
+        if (!selected) {
+            continue;
+        }
+        if (F.arg_size() != 3) {
+            errs() << "guarded-graph: skipping " << F.getName() << ": not Eval(Heap*, int, int)\n";
+            continue;
+        }
+        out.push_back(&F);
+    }
+    return out;
 }
 
+/* Casts of any kind: bitcasts at -O0, and the zext/trunc/ptrtoint that
+   instcombine leaves around the integer halves of a split Eval. */
 static Value* stripCasts(Value* v) {
     while (true) {
-        if (auto* bc = dyn_cast<BitCastInst>(v)) {
-            v = bc->getOperand(0);
+        if (auto* ci = dyn_cast<CastInst>(v)) {
+            v = ci->getOperand(0);
+            continue;
+        }
+        if (auto* fr = dyn_cast<FreezeInst>(v)) {
+            v = fr->getOperand(0);
             continue;
         }
         if (auto* ce = dyn_cast<ConstantExpr>(v)) {
-            if (ce->getOpcode() == Instruction::BitCast) {
+            if (ce->isCast()) {
                 v = ce->getOperand(0);
                 continue;
             }
@@ -138,236 +259,878 @@ static bool getConstInt(Value* v, int& out) {
     return false;
 }
 
-struct GuardedGraphPass : PassInfoMixin<GuardedGraphPass> {
-    PreservedAnalyses run(Function& F, FunctionAnalysisManager&) {
-        if (!isKernelName(F.getName())) {
-            return PreservedAnalyses::all();
+/* Predicates are node ids of int 0/1 values, or one of these. The
+   negation of p is -p - 3, so it costs no node until it is used as a value,
+   and kTrue/kFalse negate into each other. */
+static const int kTrue = -1;  /* known to hold */
+static const int kFalse = -2; /* known not to hold */
+
+/* Follow extractvalue and casts back to the aggregate an Eval half came from. */
+static Value* evalSource(Value* v) {
+    v = stripCasts(v);
+    while (auto* ev = dyn_cast<ExtractValueInst>(v)) {
+        v = stripCasts(ev->getAggregateOperand());
+    }
+    return v;
+}
+
+/* Builds one kernel's graph. ck_* calls become nodes, block by block in
+   reverse post-order, and control flow becomes data flow: a block's
+   predicate is an int 0/1 node that is 1 when the block runs, built from
+   the ck_truthy results its branches test; a phi (or a select, or several
+   returns) becomes a chain of select nodes over the predicates of its
+   incoming edges; and a counted loop that applies one load to a
+   loop-carried value becomes a loop_chain node. Loops the optimizer
+   unrolled are plain branches by then. Nodes on both sides of a branch
+   are built unconditionally, which is safe because ck_* calls have no
+   side effects and select only returns the side that was taken. */
+struct GraphExtractor {
+    Function& F;
+    GraphBuilder& builder;
+    DominatorTree& DT;
+    PostDominatorTree& PDT;
+    LoopInfo& LI;
+    ScalarEvolution& SE;
+    DenseMap<const Value*, int> valueToNode;
+    DenseMap<const AllocaInst*, int> allocaToNode;
+    DenseMap<const BasicBlock*, int> blockPreds;
+    std::map<std::pair<const BasicBlock*, const BasicBlock*>, int> edgePreds;
+    std::set<const BasicBlock*> visited;
+    std::map<std::tuple<int, int, int>, int> selects;
+    std::map<int, int> notNodes; /* predicate node -> node holding its negation */
+    int constNodes[2] = {0, 0};
+    std::string unsupported;
+
+    GraphExtractor(Function& F, GraphBuilder& builder, DominatorTree& DT, PostDominatorTree& PDT, LoopInfo& LI,
+                   ScalarEvolution& SE)
+        : F(F), builder(builder), DT(DT), PDT(PDT), LI(LI), SE(SE) {}
+
+    int fail(const Twine& why) {
+        if (unsupported.empty()) {
+            unsupported = why.str();
         }
+        return 0;
+    }
 
-        GraphBuilder builder;
-        DenseMap<const Value*, int> valueToNode;
-        DenseMap<const AllocaInst*, int> allocaToNode;
+    int constant(int value) {
+        if (!constNodes[value]) {
+            Node n;
+            n.kind = "const_int";
+            n.value = value;
+            constNodes[value] = builder.addNode(n);
+        }
+        return constNodes[value];
+    }
 
-        auto resolveNode = [&](Value* v) -> int {
-            v = stripCasts(v);
-            if (auto* li = dyn_cast<LoadInst>(v)) {
-                if (AllocaInst* ai = getAlloca(li->getPointerOperand())) {
-                    auto it = allocaToNode.find(ai);
-                    if (it != allocaToNode.end()) {
-                        return it->second;
-                    }
-                }
+    int materialize(int pred) {
+        if (pred == kTrue) {
+            return constant(1);
+        }
+        if (pred == kFalse) {
+            return constant(0);
+        }
+        if (pred < kFalse) {
+            int inner = notPred(pred);
+            auto it = notNodes.find(inner);
+            if (it == notNodes.end()) {
+                int zero = constant(0);
+                int one = constant(1);
+                it = notNodes.emplace(inner, select(inner, zero, one)).first;
             }
-            auto it = valueToNode.find(v);
-            if (it != valueToNode.end()) {
+            return it->second;
+        }
+        return pred;
+    }
+
+    /* Selects are shared, and one on a negated predicate swaps its arms. */
+    int select(int cond, int then_id, int else_id) {
+        Node n;
+        if (cond == kTrue) {
+            return then_id;
+        }
+        if (cond == kFalse) {
+            return else_id;
+        }
+        if (then_id == else_id) {
+            return then_id;
+        }
+        if (cond < kFalse) {
+            return select(notPred(cond), else_id, then_id);
+        }
+        auto key = std::make_tuple(cond, then_id, else_id);
+        auto it = selects.find(key);
+        if (it != selects.end()) {
+            return it->second;
+        }
+        n.kind = "select";
+        n.cond = cond;
+        n.then_id = then_id;
+        n.else_id = else_id;
+        int id = builder.addNode(n);
+        selects[key] = id;
+        return id;
+    }
+
+    int notPred(int a) {
+        return -a - 3;
+    }
+
+    int andPred(int a, int b) {
+        if (a == kFalse || b == kFalse) {
+            return kFalse;
+        }
+        if (a == kTrue) {
+            return b;
+        }
+        if (b == kTrue) {
+            return a;
+        }
+        b = materialize(b);
+        return select(a, b, constant(0));
+    }
+
+    int orPred(int a, int b) {
+        if (a == kTrue || b == kTrue) {
+            return kTrue;
+        }
+        if (a == kFalse) {
+            return b;
+        }
+        if (b == kFalse) {
+            return a;
+        }
+        b = materialize(b);
+        return select(a, constant(1), b);
+    }
+
+    /* A branch condition as a predicate: ck_truthy results compared with 0,
+       and not/and/or/select/phi over those. */
+    int resolveCond(Value* c) {
+        c = stripCasts(c);
+        if (auto* ci = dyn_cast<ConstantInt>(c)) {
+            return ci->isZero() ? kFalse : kTrue;
+        }
+        if (auto* call = dyn_cast<CallInst>(c)) {
+            auto it = valueToNode.find(call);
+            if (it != valueToNode.end() && call->getCalledFunction() &&
+                call->getCalledFunction()->getName() == "ck_truthy") {
                 return it->second;
             }
+        }
+        if (auto* cmp = dyn_cast<ICmpInst>(c)) {
+            auto* rhs = dyn_cast<ConstantInt>(cmp->getOperand(1));
+            if (cmp->isEquality() && rhs && rhs->isZero()) {
+                int inner = resolveCond(cmp->getOperand(0));
+                return cmp->getPredicate() == CmpInst::ICMP_EQ ? notPred(inner) : inner;
+            }
+        }
+        if (auto* bo = dyn_cast<BinaryOperator>(c)) {
+            auto* rhs = dyn_cast<ConstantInt>(bo->getOperand(1));
+            if (bo->getOpcode() == Instruction::Xor && rhs && rhs->isOne()) {
+                return notPred(resolveCond(bo->getOperand(0)));
+            }
+            if (bo->getOpcode() == Instruction::And || bo->getOpcode() == Instruction::Or) {
+                int a = resolveCond(bo->getOperand(0));
+                int b = resolveCond(bo->getOperand(1));
+                return bo->getOpcode() == Instruction::And ? andPred(a, b) : orPred(a, b);
+            }
+        }
+        if (auto* si = dyn_cast<SelectInst>(c)) {
+            int cond = resolveCond(si->getCondition());
+            int t = resolveCond(si->getTrueValue());
+            int e = resolveCond(si->getFalseValue());
+            if (cond == kTrue || cond == kFalse) {
+                return cond == kTrue ? t : e;
+            }
+            t = materialize(t);
+            e = materialize(e);
+            return select(cond, t, e);
+        }
+        if (auto* phi = dyn_cast<PHINode>(c)) {
+            return resolvePhi(phi, [&](Value* v) { return materialize(resolveCond(v)); });
+        }
+        return fail("unsupported branch condition in " + F.getName());
+    }
+
+    int edgeCond(BasicBlock* from, BasicBlock* to) {
+        auto* br = dyn_cast<BranchInst>(from->getTerminator());
+        if (!br) {
+            return fail("unsupported terminator in " + F.getName());
+        }
+        if (br->isUnconditional() || br->getSuccessor(0) == br->getSuccessor(1)) {
+            return kTrue;
+        }
+        int c = resolveCond(br->getCondition());
+        return br->getSuccessor(0) == to ? c : notPred(c);
+    }
+
+    int edgePred(BasicBlock* from, BasicBlock* to) {
+        auto key = std::make_pair((const BasicBlock*)from, (const BasicBlock*)to);
+        auto it = edgePreds.find(key);
+        if (it != edgePreds.end()) {
+            return it->second;
+        }
+        int fromPred = blockPred(from);
+        int pred = andPred(fromPred, edgeCond(from, to));
+        edgePreds[key] = pred;
+        return pred;
+    }
+
+    /* A block that post-dominates its immediate dominator runs exactly
+       when that one does; otherwise it runs when one of its (forward)
+       incoming edges is taken. */
+    int blockPred(BasicBlock* BB) {
+        auto it = blockPreds.find(BB);
+        if (it != blockPreds.end()) {
+            return it->second;
+        }
+        int pred = kFalse;
+        DomTreeNode* node = DT.getNode(BB);
+        DomTreeNode* idom = node ? node->getIDom() : nullptr;
+        if (!idom) {
+            pred = kTrue;
+        } else if (PDT.dominates(BB, idom->getBlock())) {
+            pred = blockPred(idom->getBlock());
+        } else {
+            for (BasicBlock* P : predecessors(BB)) {
+                if (DT.isReachableFromEntry(P) && !DT.dominates(BB, P)) {
+                    pred = orPred(pred, edgePred(P, BB));
+                }
+            }
+        }
+        blockPreds[BB] = pred;
+        return pred;
+    }
+
+    /* Exactly one incoming edge was taken, so the last live incoming value
+       is the fallback and the others are selected by their edge predicate. */
+    int resolvePhi(PHINode* phi, const std::function<int(Value*)>& resolve) {
+        std::vector<std::pair<BasicBlock*, Value*>> incoming;
+        for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+            BasicBlock* from = phi->getIncomingBlock(i);
+            Value* v = phi->getIncomingValue(i);
+            if (!DT.isReachableFromEntry(from) || isa<UndefValue>(v)) {
+                continue;
+            }
+            if (!visited.count(from)) {
+                return fail("loop-carried value in " + F.getName() + " is not a loop_chain");
+            }
+            incoming.emplace_back(from, v);
+        }
+        if (incoming.empty()) {
             return 0;
-        };
+        }
+        int result = resolve(incoming.back().second);
+        for (size_t i = incoming.size() - 1; i-- > 0;) {
+            int pred = edgePred(incoming[i].first, phi->getParent());
+            if (pred == kFalse) {
+                continue;
+            }
+            result = select(pred, resolve(incoming[i].second), result);
+        }
+        return result;
+    }
 
-        auto resolveEvalArg = [&](CallInst* CI, unsigned idx) -> int {
-            if (idx >= CI->arg_size()) {
-                return 0;
+    /* In SSA form (after sroa/instcombine) an Eval travels as the {i64, i32}
+       the ABI returns it in: extractvalue takes it apart for the next call
+       and insertvalue rebuilds it for a return, so both lead back to the
+       ck_* call. At -O0 it goes through allocas and memcpy instead. */
+    int resolveNode(Value* v) {
+        v = stripCasts(v);
+        while (true) {
+            if (auto* ev = dyn_cast<ExtractValueInst>(v)) {
+                v = stripCasts(ev->getAggregateOperand());
+                continue;
             }
-            return resolveNode(CI->getArgOperand(idx));
-        };
+            if (auto* iv = dyn_cast<InsertValueInst>(v)) {
+                if (int id = resolveNode(iv->getInsertedValueOperand())) {
+                    return id;
+                }
+                v = stripCasts(iv->getAggregateOperand());
+                continue;
+            }
+            break;
+        }
+        if (auto* li = dyn_cast<LoadInst>(v)) {
+            if (AllocaInst* ai = getAlloca(li->getPointerOperand())) {
+                auto it = allocaToNode.find(ai);
+                if (it != allocaToNode.end()) {
+                    return it->second;
+                }
+            }
+        }
+        auto it = valueToNode.find(v);
+        if (it != valueToNode.end()) {
+            return it->second;
+        }
+        int id = 0;
+        if (auto* phi = dyn_cast<PHINode>(v)) {
+            id = resolvePhi(phi, [&](Value* in) { return resolveNode(in); });
+        } else if (auto* si = dyn_cast<SelectInst>(v)) {
+            int cond = resolveCond(si->getCondition());
+            if (cond == kTrue || cond == kFalse) {
+                id = resolveNode(cond == kTrue ? si->getTrueValue() : si->getFalseValue());
+            } else {
+                int t = resolveNode(si->getTrueValue());
+                int e = resolveNode(si->getFalseValue());
+                id = select(cond, t, e);
+            }
+        }
+        if (id) {
+            valueToNode[v] = id;
+        }
+        return id;
+    }
 
-        auto addGuardedPtr = [&](int ptrNodeId) -> int {
-            Node guardPtr;
-            guardPtr.kind = "guard_ptr";
-            guardPtr.x = ptrNodeId;
-            int guardPtrId = builder.addNode(guardPtr);
+    int resolveEvalArg(CallInst* CI, unsigned idx) {
+        if (idx >= CI->arg_size()) {
+            return 0;
+        }
+        return resolveNode(CI->getArgOperand(idx));
+    }
 
-            Node guardNonNull;
-            guardNonNull.kind = "guard_nonnull";
-            guardNonNull.x = guardPtrId;
-            int guardNonNullId = builder.addNode(guardNonNull);
+    int addGuardedPtr(int ptrNodeId) {
+        Node guardPtr;
+        guardPtr.kind = "guard_ptr";
+        guardPtr.x = ptrNodeId;
+        int guardPtrId = builder.addNode(guardPtr);
 
-            return guardNonNullId;
-        };
+        Node guardNonNull;
+        guardNonNull.kind = "guard_nonnull";
+        guardNonNull.x = guardPtrId;
+        int guardNonNullId = builder.addNode(guardNonNull);
 
-        for (BasicBlock& BB : F) {
-            for (Instruction& I : BB) {
-                if (auto* CI = dyn_cast<CallInst>(&I)) {
-                    Function* callee = CI->getCalledFunction();
-                    if (!callee) {
-                        continue;
-                    }
-                    StringRef name = callee->getName();
-                    Node n;
-                    bool makeNode = true;
-
-                    if (name == "ck_input") {
-                        std::string inputName = getConstString(CI->getArgOperand(0));
-                        int id = builder.getOrAddInput(inputName);
-                        valueToNode[CI] = id;
-                        continue;
-                    } else if (name == "ck_const_int") {
-                        int val = 0;
-                        getConstInt(CI->getArgOperand(0), val);
-                        n.kind = "const_int";
-                        n.value = val;
-                    } else if (name == "ck_const_null") {
-                        n.kind = "const_null";
-                    } else if (name == "ck_guard_nonnull") {
-                        n.kind = "is_nonnull";
-                        n.x = resolveEvalArg(CI, 0);
-                    } else if (name == "ck_guard_eq") {
-                        n.kind = "guard_eq";
-                        n.x = resolveEvalArg(CI, 0);
-                        n.y = resolveEvalArg(CI, 2);
-                    } else if (name == "ck_load_ptr") {
-                        n.kind = "load_ptr";
-                        n.x = addGuardedPtr(resolveEvalArg(CI, 1));
-                        n.field = 0;
-                    } else if (name == "ck_load_int") {
-                        n.kind = "load_int";
-                        n.x = addGuardedPtr(resolveEvalArg(CI, 1));
-                        n.field = 0;
-                    } else if (name == "ck_getfield") {
-                        int field = 0;
-                        n.kind = "getfield";
-                        n.x = addGuardedPtr(resolveEvalArg(CI, 1));
-                        getConstInt(CI->getArgOperand(3), field);
-                        n.field = field;
-                    } else if (name == "ck_getfield_int") {
-                        int field = 0;
-                        n.kind = "getfield_int";
-                        n.x = addGuardedPtr(resolveEvalArg(CI, 1));
-                        getConstInt(CI->getArgOperand(3), field);
-                        n.field = field;
-                    } else if (name == "ck_select") {
-                        n.kind = "select";
-                        n.cond = resolveEvalArg(CI, 0);
-                        n.then_id = resolveEvalArg(CI, 2);
-                        n.else_id = resolveEvalArg(CI, 4);
-                    } else if (name == "ck_add") {
-                        n.kind = "add";
-                        n.x = resolveEvalArg(CI, 0);
-                        n.y = resolveEvalArg(CI, 2);
-                    } else if (name.startswith("llvm.memcpy")) {
-                        AllocaInst* dst = getAlloca(CI->getArgOperand(0));
-                        AllocaInst* src = getAlloca(CI->getArgOperand(1));
-                        if (dst && src) {
-                            auto it = allocaToNode.find(src);
-                            if (it != allocaToNode.end()) {
-                                allocaToNode[dst] = it->second;
-                            }
-                        }
-                        makeNode = false;
-                    } else {
-                        makeNode = false;
-                    }
-
-                    if (makeNode) {
-                        int id = builder.addNode(n);
-                        valueToNode[CI] = id;
-                    }
+        return guardNonNullId;
+    }
+
+    /* for (i = 0; i < N; ++i) cur = ck_getfield(heap, cur, f) (or
+       ck_load_ptr) with a constant N, as one block whose ck_* calls are
+       only those loads, each taking the previous one (several when the
+       loop was partially unrolled): the value after the loop is
+       loop_chain(init, f, N * loads per iteration). */
+    bool extractLoopChain(Loop* L) {
+        BasicBlock* BB = L->getHeader();
+        std::vector<CallInst*> loads;
+        if (!L->getSubLoops().empty() || L->getNumBlocks() != 1 || !L->getLoopPreheader()) {
+            return fail("loop in " + F.getName() + " is not a single-block loop_chain");
+        }
+        unsigned trips = SE.getSmallConstantTripCount(L);
+        if (!trips) {
+            return fail("loop in " + F.getName() + " has no constant trip count");
+        }
+        for (Instruction& I : *BB) {
+            auto* CI = dyn_cast<CallInst>(&I);
+            if (!CI || isa<DbgInfoIntrinsic>(CI)) {
+                continue;
+            }
+            Function* callee = CI->getCalledFunction();
+            if (!callee || (callee->getName() != "ck_load_ptr" && callee->getName() != "ck_getfield")) {
+                return fail("loop in " + F.getName() + " calls something other than a load");
+            }
+            loads.push_back(CI);
+        }
+        if (loads.empty()) {
+            return fail("loop in " + F.getName() + " has no load");
+        }
+
+        int field = -1;
+        auto* phi = dyn_cast<PHINode>(evalSource(loads[0]->getArgOperand(1)));
+        if (!phi || phi->getParent() != BB || evalSource(phi->getIncomingValueForBlock(BB)) != loads.back()) {
+            return fail("loop in " + F.getName() + " does not chain its loads");
+        }
+        for (size_t i = 0; i < loads.size(); ++i) {
+            int f = 0;
+            if (loads[i]->getCalledFunction()->getName() == "ck_getfield" &&
+                !getConstInt(loads[i]->getArgOperand(3), f)) {
+                return fail("loop in " + F.getName() + " with a non-constant field");
+            }
+            if ((field >= 0 && f != field) || (i > 0 && evalSource(loads[i]->getArgOperand(1)) != loads[i - 1])) {
+                return fail("loop in " + F.getName() + " does not chain one field");
+            }
+            field = f;
+        }
+        /* only the last load's value may leave the loop */
+        std::function<bool(Instruction*)> leaves = [&](Instruction* I) {
+            for (User* U : I->users()) {
+                auto* UI = dyn_cast<Instruction>(U);
+                if (!UI || !L->contains(UI)) {
+                    return true;
                 }
+                if ((isa<ExtractValueInst>(UI) || isa<CastInst>(UI)) && leaves(UI)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        for (size_t i = 0; i < loads.size(); ++i) {
+            if (leaves(i == 0 ? (Instruction*)phi : (Instruction*)loads[i - 1])) {
+                return fail("loop in " + F.getName() + " uses the chain before its last load");
+            }
+        }
 
-                if (auto* SI = dyn_cast<StoreInst>(&I)) {
-                    Value* val = SI->getValueOperand();
-                    Value* ptr = stripCasts(SI->getPointerOperand());
-                    if (auto* AI = dyn_cast<AllocaInst>(ptr)) {
-                        int id = resolveNode(val);
-                        if (id) {
-                            allocaToNode[AI] = id;
-                        }
-                    }
+        Node n;
+        n.kind = "loop_chain";
+        n.x = resolveNode(phi->getIncomingValueForBlock(L->getLoopPreheader()));
+        n.field = field;
+        n.value = (int)(trips * loads.size());
+        valueToNode[loads.back()] = builder.addNode(n);
+        return true;
+    }
+
+    void visitCall(CallInst* CI) {
+        Function* callee = CI->getCalledFunction();
+        if (!callee) {
+            return;
+        }
+        StringRef name = callee->getName();
+        Node n;
+        bool makeNode = true;
+
+        if (name == "ck_input") {
+            std::string inputName = getConstString(CI->getArgOperand(0));
+            valueToNode[CI] = builder.getOrAddInput(inputName);
+            return;
+        } else if (name == "ck_const_int") {
+            int val = 0;
+            getConstInt(CI->getArgOperand(0), val);
+            n.kind = "const_int";
+            n.value = val;
+            if ((val == 0 || val == 1) && !constNodes[val]) {
+                constNodes[val] = builder.addNode(n);
+                valueToNode[CI] = constNodes[val];
+                return;
+            }
+        } else if (name == "ck_const_null") {
+            n.kind = "const_null";
+        } else if (name == "ck_truthy") {
+            n.kind = "truthy";
+            n.x = resolveEvalArg(CI, 0);
+        } else if (name == "ck_guard_nonnull") {
+            n.kind = "is_nonnull";
+            n.x = resolveEvalArg(CI, 0);
+        } else if (name == "ck_guard_eq") {
+            n.kind = "guard_eq";
+            n.x = resolveEvalArg(CI, 0);
+            n.y = resolveEvalArg(CI, 2);
+        } else if (name == "ck_load_ptr") {
+            n.kind = "load_ptr";
+            n.x = addGuardedPtr(resolveEvalArg(CI, 1));
+            n.field = 0;
+        } else if (name == "ck_load_int") {
+            n.kind = "load_int";
+            n.x = addGuardedPtr(resolveEvalArg(CI, 1));
+            n.field = 0;
+        } else if (name == "ck_getfield") {
+            int field = 0;
+            if (!getConstInt(CI->getArgOperand(3), field)) {
+                fail("ck_getfield with a non-constant field in " + F.getName());
+                return;
+            }
+            n.kind = "getfield";
+            n.x = addGuardedPtr(resolveEvalArg(CI, 1));
+            n.field = field;
+        } else if (name == "ck_getfield_int") {
+            int field = 0;
+            if (!getConstInt(CI->getArgOperand(3), field)) {
+                fail("ck_getfield_int with a non-constant field in " + F.getName());
+                return;
+            }
+            n.kind = "getfield_int";
+            n.x = addGuardedPtr(resolveEvalArg(CI, 1));
+            n.field = field;
+        } else if (name == "ck_load_chain") {
+            int field = 0;
+            int count = 0;
+            if (!getConstInt(CI->getArgOperand(3), field) || !getConstInt(CI->getArgOperand(4), count)) {
+                fail("ck_load_chain with a non-constant field or length in " + F.getName());
+                return;
+            }
+            n.kind = "loop_chain";
+            n.x = resolveEvalArg(CI, 1);
+            n.field = field;
+            n.value = count;
+        } else if (name == "ck_select") {
+            n.kind = "select";
+            n.cond = resolveEvalArg(CI, 0);
+            n.then_id = resolveEvalArg(CI, 2);
+            n.else_id = resolveEvalArg(CI, 4);
+        } else if (name == "ck_add") {
+            n.kind = "add";
+            n.x = resolveEvalArg(CI, 0);
+            n.y = resolveEvalArg(CI, 2);
+        } else if (name.startswith("llvm.memcpy")) {
+            AllocaInst* dst = getAlloca(CI->getArgOperand(0));
+            AllocaInst* src = getAlloca(CI->getArgOperand(1));
+            if (dst && src) {
+                auto it = allocaToNode.find(src);
+                if (it != allocaToNode.end()) {
+                    allocaToNode[dst] = it->second;
                 }
             }
+            makeNode = false;
+        } else {
+            makeNode = false;
         }
 
-        int outputId = 0;
-        for (BasicBlock& BB : F) {
-            if (auto* RI = dyn_cast<ReturnInst>(BB.getTerminator())) {
+        if (makeNode) {
+            valueToNode[CI] = builder.addNode(n);
+        }
+    }
+
+    void visitStore(StoreInst* SI) {
+        Value* val = SI->getValueOperand();
+        Value* ptr = stripCasts(SI->getPointerOperand());
+        if (auto* AI = dyn_cast<AllocaInst>(ptr)) {
+            int id = resolveNode(val);
+            if (id) {
+                allocaToNode[AI] = id;
+            }
+        }
+    }
+
+    /* Returns the output node id, or 0 with `unsupported` set. */
+    int run() {
+        ReversePostOrderTraversal<Function*> rpot(&F);
+        std::vector<std::pair<BasicBlock*, Value*>> returns;
+
+        for (BasicBlock* BB : rpot) {
+            Loop* L = LI.getLoopFor(BB);
+            if (L) {
+                if (L->getHeader() != BB || !extractLoopChain(L)) {
+                    return fail("unsupported loop in " + F.getName());
+                }
+                visited.insert(BB);
+                continue;
+            }
+            for (Instruction& I : *BB) {
+                if (auto* CI = dyn_cast<CallInst>(&I)) {
+                    visitCall(CI);
+                } else if (auto* SI = dyn_cast<StoreInst>(&I)) {
+                    visitStore(SI);
+                }
+            }
+            visited.insert(BB);
+            if (auto* RI = dyn_cast<ReturnInst>(BB->getTerminator())) {
                 if (Value* rv = RI->getReturnValue()) {
-                    outputId = resolveNode(rv);
+                    returns.emplace_back(BB, rv);
                 }
             }
         }
+        if (visited.size() > 1 && !allocaToNode.empty()) {
+            return fail("control flow through allocas in " + F.getName() + " (run mem2reg first)");
+        }
+        if (returns.empty()) {
+            return 0;
+        }
 
-        std::string outDir = "out";
-        if (const char* env = std::getenv("GRAPH_OUT_DIR")) {
-            outDir = env;
+        /* several returns: the same select chain as a phi, on block predicates */
+        int outputId = resolveNode(returns.back().second);
+        for (size_t i = returns.size() - 1; i-- > 0;) {
+            int pred = blockPred(returns[i].first);
+            if (pred != kFalse) {
+                outputId = select(pred, resolveNode(returns[i].second), outputId);
+            }
         }
-        sys::fs::create_directories(outDir);
-        std::string path = (Twine(outDir) + "/" + F.getName() + ".json").str();
+        return unsupported.empty() ? outputId : 0;
+    }
+};
+
+static KernelInfo describeKernel(const Function& F, const GraphBuilder& builder) {
+    KernelInfo info;
+    std::set<int> seen;
+    info.name = F.getName().str();
+    for (const Node& n : builder.nodes) {
+        int field = -1;
+        if (n.kind == "input") {
+            info.inputs.push_back(n.name);
+        } else if (n.kind == "load_ptr" || n.kind == "load_int") {
+            field = 0;
+        } else if (n.kind == "getfield" || n.kind == "getfield_int" || n.kind == "loop_chain") {
+            field = n.field;
+        }
+        if (field >= 0 && seen.insert(field).second) {
+            info.fields.push_back(field);
+        }
+    }
+    return info;
+}
+
+/* Bump when extraction changes, so graphs cached by an older pass are redone. */
+static const char* const kExtractorVersion = "guarded-graph 3";
+
+/* Key for incremental extraction: the function's IR plus the initializers of
+   the globals it references (input names are string constants), so a cached
+   graph is reused only when nothing the extractor reads has changed. MST is
+   shared across kernels so the module is numbered once. */
+static std::string kernelHash(const Function& F, ModuleSlotTracker& MST) {
+    std::string text = kExtractorVersion;
+    raw_string_ostream os(text);
+    std::set<const GlobalVariable*> globals;
+    os << "\n";
+    F.Value::print(os, MST);
+    for (const Instruction& I : instructions(F)) {
+        for (const Value* op : I.operands()) {
+            auto* gv = dyn_cast<GlobalVariable>(op->stripPointerCasts());
+            if (gv && gv->hasInitializer() && globals.insert(gv).second) {
+                os << "\n" << gv->getName() << " = ";
+                gv->getInitializer()->print(os);
+            }
+        }
+    }
+    os.flush();
+    return utohexstr(xxHash64(text), /*LowerCase=*/true);
+}
+
+/* Write to a temporary next to path and rename it into place, so the driver
+   and opt runs sharing an output directory never see a half-written file. */
+static bool writeFileAtomic(const std::string& path, function_ref<void(raw_ostream&)> body) {
+    std::string tmp = path + ".tmp" + std::to_string(sys::Process::getProcessId());
+    {
         std::error_code ec;
-        raw_fd_ostream os(path, ec, sys::fs::OF_Text);
+        raw_fd_ostream os(tmp, ec, sys::fs::OF_Text);
         if (ec) {
-            errs() << "Failed to open output: " << ec.message() << "\n";
-            return PreservedAnalyses::all();
+            errs() << "Failed to open " << tmp << ": " << ec.message() << "\n";
+            return false;
+        }
+        body(os);
+        os.close();
+        if (os.has_error()) {
+            errs() << "Failed to write " << tmp << ": " << os.error().message() << "\n";
+            os.clear_error();
+            sys::fs::remove(tmp);
+            return false;
         }
+    }
+    if (std::error_code ec = sys::fs::rename(tmp, path)) {
+        errs() << "Failed to rename " << tmp << ": " << ec.message() << "\n";
+        sys::fs::remove(tmp);
+        return false;
+    }
+    return true;
+}
 
-        std::vector<std::pair<int, int>> edges;
-        for (const Node& n : builder.nodes) {
-            if (n.kind == "guard_ptr" || n.kind == "guard_nonnull" || n.kind == "is_nonnull") {
-                edges.emplace_back(n.x, n.id);
-            } else if (n.kind == "guard_eq") {
-                edges.emplace_back(n.x, n.id);
-                edges.emplace_back(n.y, n.id);
-            } else if (n.kind == "load_ptr" || n.kind == "load_int" ||
-                       n.kind == "getfield" || n.kind == "getfield_int") {
-                edges.emplace_back(n.x, n.id);
-            } else if (n.kind == "select") {
-                edges.emplace_back(n.cond, n.id);
-                edges.emplace_back(n.then_id, n.id);
-                edges.emplace_back(n.else_id, n.id);
-            } else if (n.kind == "add") {
-                edges.emplace_back(n.x, n.id);
-                edges.emplace_back(n.y, n.id);
-            }
+static void writeGraphJson(raw_ostream& os, const Function& F, const GraphBuilder& builder, int outputId) {
+    std::vector<std::pair<int, int>> edges;
+    for (const Node& n : builder.nodes) {
+        if (n.kind == "guard_ptr" || n.kind == "guard_nonnull" || n.kind == "is_nonnull" || n.kind == "truthy" ||
+            n.kind == "loop_chain") {
+            edges.emplace_back(n.x, n.id);
+        } else if (n.kind == "guard_eq") {
+            edges.emplace_back(n.x, n.id);
+            edges.emplace_back(n.y, n.id);
+        } else if (n.kind == "load_ptr" || n.kind == "load_int" ||
+                   n.kind == "getfield" || n.kind == "getfield_int") {
+            edges.emplace_back(n.x, n.id);
+        } else if (n.kind == "select") {
+            edges.emplace_back(n.cond, n.id);
+            edges.emplace_back(n.then_id, n.id);
+            edges.emplace_back(n.else_id, n.id);
+        } else if (n.kind == "add") {
+            edges.emplace_back(n.x, n.id);
+            edges.emplace_back(n.y, n.id);
+        }
+    }
+
+    os << "{\n";
+    os << "  \"function\": \"" << F.getName() << "\",\n";
+    os << "  \"nodes\": [\n";
+    for (size_t i = 0; i < builder.nodes.size(); ++i) {
+        const Node& n = builder.nodes[i];
+        os << "    {\"id\":" << n.id << ",\"kind\":\"" << n.kind << "\"";
+        if (!n.name.empty()) {
+            os << ",\"name\":\"" << n.name << "\"";
+        }
+        if (n.x) {
+            os << ",\"x\":" << n.x;
+        }
+        if (n.y) {
+            os << ",\"y\":" << n.y;
+        }
+        if (n.field) {
+            os << ",\"field\":" << n.field;
+        }
+        if (n.value || n.kind == "const_int") {
+            os << ",\"value\":" << n.value;
+        }
+        if (n.cond) {
+            os << ",\"cond\":" << n.cond;
+        }
+        if (n.then_id) {
+            os << ",\"then\":" << n.then_id;
+        }
+        if (n.else_id) {
+            os << ",\"else\":" << n.else_id;
+        }
+        os << "}";
+        if (i + 1 < builder.nodes.size()) {
+            os << ",";
+        }
+        os << "\n";
+    }
+    os << "  ],\n";
+    os << "  \"edges\": [";
+    for (size_t i = 0; i < edges.size(); ++i) {
+        os << "[" << edges[i].first << "," << edges[i].second << "]";
+        if (i + 1 < edges.size()) {
+            os << ",";
         }
+    }
+    os << "],\n";
+    os << "  \"output\": " << outputId << "\n";
+    os << "}\n";
+}
 
+static bool writeGraph(const std::string& outDir, const Function& F, const GraphBuilder& builder, int outputId) {
+    std::string path = (Twine(outDir) + "/" + F.getName() + ".json").str();
+    return writeFileAtomic(path, [&](raw_ostream& os) { writeGraphJson(os, F, builder, outputId); });
+}
+
+static void writeStringList(raw_ostream& os, const std::vector<std::string>& items) {
+    os << "[";
+    for (size_t i = 0; i < items.size(); ++i) {
+        os << (i ? "," : "") << "\"" << items[i] << "\"";
+    }
+    os << "]";
+}
+
+/* One entry per graph written, with the graph path relative to
+   GRAPH_OUT_DIR; the driver takes its kernel list from here. */
+static bool writeManifest(const std::string& path, const std::vector<KernelInfo>& kernels) {
+    return writeFileAtomic(path, [&](raw_ostream& os) {
         os << "{\n";
-        os << "  \"function\": \"" << F.getName() << "\",\n";
-        os << "  \"nodes\": [\n";
-        for (size_t i = 0; i < builder.nodes.size(); ++i) {
-            const Node& n = builder.nodes[i];
-            os << "    {\"id\":" << n.id << ",\"kind\":\"" << n.kind << "\"";
-            if (!n.name.empty()) {
-                os << ",\"name\":\"" << n.name << "\"";
-            }
-            if (n.x) {
-                os << ",\"x\":" << n.x;
-            }
-            if (n.y) {
-                os << ",\"y\":" << n.y;
+        os << "  \"kernels\": [\n";
+        for (size_t i = 0; i < kernels.size(); ++i) {
+            const KernelInfo& k = kernels[i];
+            os << "    {\"name\":\"" << k.name << "\",\"graph\":\"" << k.name << ".json\",\"inputs\":";
+            writeStringList(os, k.inputs);
+            os << ",\"fields\":[";
+            for (size_t j = 0; j < k.fields.size(); ++j) {
+                os << (j ? "," : "") << k.fields[j];
             }
-            if (n.field) {
-                os << ",\"field\":" << n.field;
+            os << "],\"hash\":\"" << k.hash << "\"}";
+            if (i + 1 < kernels.size()) {
+                os << ",";
             }
-            if (n.value || n.kind == "const_int") {
-                os << ",\"value\":" << n.value;
+            os << "\n";
+        }
+        os << "  ]\n";
+        os << "}\n";
+    });
+}
+
+/* Entries of an earlier manifest that carry a hash and whose graph is still
+   in outDir, by kernel name. */
+static std::map<std::string, KernelInfo> loadCachedKernels(const std::string& path, const std::string& outDir) {
+    std::map<std::string, KernelInfo> cached;
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buf = MemoryBuffer::getFile(path);
+    if (!buf) {
+        return cached;
+    }
+    Expected<json::Value> root = json::parse((*buf)->getBuffer());
+    if (!root) {
+        consumeError(root.takeError());
+        return cached;
+    }
+    const json::Object* obj = root->getAsObject();
+    const json::Array* kernels = obj ? obj->getArray("kernels") : nullptr;
+    if (!kernels) {
+        return cached;
+    }
+    for (const json::Value& v : *kernels) {
+        const json::Object* k = v.getAsObject();
+        if (!k) {
+            continue;
+        }
+        Optional<StringRef> name = k->getString("name");
+        Optional<StringRef> hash = k->getString("hash");
+        if (!name || !hash || !sys::fs::exists(outDir + "/" + *name + ".json")) {
+            continue;
+        }
+        KernelInfo info;
+        info.name = name->str();
+        info.hash = hash->str();
+        if (const json::Array* inputs = k->getArray("inputs")) {
+            for (const json::Value& in : *inputs) {
+                if (Optional<StringRef> s = in.getAsString()) {
+                    info.inputs.push_back(s->str());
+                }
             }
-            if (n.cond) {
-                os << ",\"cond\":" << n.cond;
+        }
+        if (const json::Array* fields = k->getArray("fields")) {
+            for (const json::Value& f : *fields) {
+                if (Optional<int64_t> n = f.getAsInteger()) {
+                    info.fields.push_back((int)*n);
+                }
             }
-            if (n.then_id) {
-                os << ",\"then\":" << n.then_id;
+        }
+        cached[info.name] = info;
+    }
+    return cached;
+}
+
+static bool envFlag(const char* name) {
+    const char* v = std::getenv(name);
+    return v && *v && std::string(v) != "0";
+}
+
+struct GuardedGraphPass : PassInfoMixin<GuardedGraphPass> {
+    PreservedAnalyses run(Module& M, ModuleAnalysisManager& MAM) {
+        std::vector<Function*> kernels = discoverKernels(M);
+        std::vector<KernelInfo> infos;
+        /* GRAPH_INCREMENTAL=1 reuses graphs listed with a matching hash in
+           the manifest being replaced, and writes the manifest even when the
+           module has no kernels so stale entries go away */
+        bool incremental = envFlag("GRAPH_INCREMENTAL");
+        if (kernels.empty() && !incremental) {
+            return PreservedAnalyses::all();
+        }
+
+        std::string outDir = "out";
+        if (const char* env = std::getenv("GRAPH_OUT_DIR")) {
+            outDir = env;
+        }
+        sys::fs::create_directories(outDir);
+        std::string manifest = outDir + "/manifest.json";
+        if (const char* env = std::getenv("GRAPH_MANIFEST")) {
+            manifest = env;
+        }
+        std::map<std::string, KernelInfo> cached;
+        if (incremental) {
+            cached = loadCachedKernels(manifest, outDir);
+        }
+
+        FunctionAnalysisManager& FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        ModuleSlotTracker MST(&M);
+        int reused = 0;
+        for (Function* F : kernels) {
+            std::string hash = kernelHash(*F, MST);
+            auto it = cached.find(F->getName().str());
+            if (it != cached.end() && it->second.hash == hash) {
+                infos.push_back(it->second);
+                reused++;
+                continue;
             }
-            if (n.else_id) {
-                os << ",\"else\":" << n.else_id;
+            GraphBuilder builder;
+            GraphExtractor extractor(*F, builder, FAM.getResult<DominatorTreeAnalysis>(*F),
+                                     FAM.getResult<PostDominatorTreeAnalysis>(*F), FAM.getResult<LoopAnalysis>(*F),
+                                     FAM.getResult<ScalarEvolutionAnalysis>(*F));
+            int outputId = extractor.run();
+            if (!extractor.unsupported.empty()) {
+                errs() << "guarded-graph: skipping " << F->getName() << ": " << extractor.unsupported << "\n";
+                continue;
             }
-            os << "}";
-            if (i + 1 < builder.nodes.size()) {
-                os << ",";
+            if (writeGraph(outDir, *F, builder, outputId)) {
+                KernelInfo info = describeKernel(*F, builder);
+                info.hash = hash;
+                infos.push_back(info);
             }
-            os << "\n";
         }
-        os << "  ],\n";
-        os << "  \"edges\": [";
-        for (size_t i = 0; i < edges.size(); ++i) {
-            os << "[" << edges[i].first << "," << edges[i].second << "]";
-            if (i + 1 < edges.size()) {
-                os << ",";
-            }
+        if (incremental) {
+            errs() << "guarded-graph: " << M.getModuleIdentifier() << ": " << infos.size() - reused
+                   << " extracted, " << reused << " cached\n";
         }
-        os << "],\n";
-        os << "  \"output\": " << outputId << "\n";
-        os << "}\n";
 
+        writeManifest(manifest, infos);
         return PreservedAnalyses::all();
     }
 };
@@ -377,11 +1140,17 @@ struct GuardedGraphPass : PassInfoMixin<GuardedGraphPass> {
 extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
     return {LLVM_PLUGIN_API_VERSION, "GuardedGraphPass", "0.1",
             [](PassBuilder& PB) {
+                /* also run at the end of the default pipelines, so
+                   clang -O2 -fpass-plugin=... extracts while compiling */
+                PB.registerOptimizerLastEPCallback(
+                    [](ModulePassManager& MPM, OptimizationLevel) {
+                        MPM.addPass(GuardedGraphPass());
+                    });
                 PB.registerPipelineParsingCallback(
-                    [](StringRef Name, FunctionPassManager& FPM,
+                    [](StringRef Name, ModulePassManager& MPM,
                        ArrayRef<PassBuilder::PipelineElement>) {
                         if (Name == "guarded-graph") {
-                            FPM.addPass(GuardedGraphPass());
+                            MPM.addPass(GuardedGraphPass());
                             return true;
                         }
                         return false;
@@ -0,0 +1,897 @@
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/* Mirrors runtime/checked_ptr.h and runtime/heap_gen.h. */
+enum { ERR_NULL = 1, ERR_INVALID = 2, ERR_TYPE = 3, ERR_MISSING_FIELD = 4 };
+static const int kMaxFields = 3;
+static const int kHeapCompactIndex = 5;
+/* loop_chain nodes up to this many loads are unrolled, longer ones become a loop */
+static const int kUnrollChain = 4;
+
+struct GNode {
+    std::string kind;
+    std::string name;
+    int x = 0;
+    int y = 0;
+    int field = 0;
+    int value = 0;
+    int cond = 0;
+    int then_id = 0;
+    int else_id = 0;
+};
+
+struct Graph {
+    std::vector<GNode> nodes; /* by id, nodes[0] unused */
+    int output = 0;
+};
+
+static std::string outDir() {
+    if (const char* env = std::getenv("GRAPH_OUT_DIR")) {
+        return env;
+    }
+    return "out";
+}
+
+static int intField(const json::Object& o, StringRef key) {
+    if (Optional<int64_t> v = o.getInteger(key)) {
+        return (int)*v;
+    }
+    return 0;
+}
+
+/* Operands must name earlier nodes, which also rules out cycles. */
+static bool loadGraph(const std::string& path, Graph& g) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buf = MemoryBuffer::getFile(path);
+    if (!buf) {
+        return false;
+    }
+    Expected<json::Value> root = json::parse((*buf)->getBuffer());
+    if (!root) {
+        consumeError(root.takeError());
+        return false;
+    }
+    const json::Object* obj = root->getAsObject();
+    const json::Array* nodes = obj ? obj->getArray("nodes") : nullptr;
+    if (!nodes) {
+        return false;
+    }
+    g.nodes.assign(nodes->size() + 1, GNode());
+    for (const json::Value& v : *nodes) {
+        const json::Object* o = v.getAsObject();
+        if (!o) {
+            return false;
+        }
+        int id = intField(*o, "id");
+        if (id <= 0 || id >= (int)g.nodes.size()) {
+            return false;
+        }
+        GNode& n = g.nodes[id];
+        if (Optional<StringRef> kind = o->getString("kind")) {
+            n.kind = kind->str();
+        }
+        if (Optional<StringRef> name = o->getString("name")) {
+            n.name = name->str();
+        }
+        n.x = intField(*o, "x");
+        n.y = intField(*o, "y");
+        n.field = intField(*o, "field");
+        n.value = intField(*o, "value");
+        n.cond = intField(*o, "cond");
+        n.then_id = intField(*o, "then");
+        n.else_id = intField(*o, "else");
+        for (int operand : {n.x, n.y, n.cond, n.then_id, n.else_id}) {
+            if (operand < 0 || operand >= id) {
+                return false;
+            }
+        }
+    }
+    g.output = intField(*obj, "output");
+    return g.output > 0 && g.output < (int)g.nodes.size();
+}
+
+static bool isLoad(const GNode& n) {
+    return n.kind == "getfield" || n.kind == "getfield_int" || n.kind == "loop_chain";
+}
+
+/* Rebuilds a graph in id order with hash-consing, so equal nodes collapse
+   (CSE) and every rewrite sees operands that are already simplified. */
+struct GraphRewriter {
+    Graph out;
+    std::vector<int> remap;
+    std::map<std::tuple<std::string, std::string, int, int, int, int, int, int, int>, int> table;
+
+    explicit GraphRewriter(const Graph& g) : remap(g.nodes.size(), 0) {
+        out.nodes.resize(1);
+    }
+
+    int intern(const GNode& n) {
+        auto key = std::make_tuple(n.kind, n.name, n.x, n.y, n.field, n.value, n.cond, n.then_id, n.else_id);
+        auto it = table.find(key);
+        if (it != table.end()) {
+            return it->second;
+        }
+        out.nodes.push_back(n);
+        int id = (int)out.nodes.size() - 1;
+        table[key] = id;
+        return id;
+    }
+
+    const GNode& node(int id) const {
+        return out.nodes[id];
+    }
+};
+
+/* Canonical forms, guard merging and CSE:
+   - load_ptr/load_int are getfield/getfield_int on field 0;
+   - a load checks type and null itself, so guard_ptr/guard_nonnull in front
+     of a load is dropped, and stacked guards keep the strongest;
+   - loop_chain of 0 loads is its operand;
+   - a select on a constant is the arm it picks. */
+static Graph simplifyGuards(const Graph& g) {
+    GraphRewriter rw(g);
+    for (size_t id = 1; id < g.nodes.size(); ++id) {
+        GNode n = g.nodes[id];
+        n.x = rw.remap[n.x];
+        n.y = rw.remap[n.y];
+        n.cond = rw.remap[n.cond];
+        n.then_id = rw.remap[n.then_id];
+        n.else_id = rw.remap[n.else_id];
+        if (n.kind == "load_ptr" || n.kind == "load_int") {
+            n.kind = n.kind == "load_ptr" ? "getfield" : "getfield_int";
+            n.field = 0;
+        }
+        if (isLoad(n)) {
+            while (n.x && (rw.node(n.x).kind == "guard_ptr" || rw.node(n.x).kind == "guard_nonnull")) {
+                n.x = rw.node(n.x).x;
+            }
+        }
+        if (n.kind == "loop_chain" && n.value == 0) {
+            rw.remap[id] = n.x;
+            continue;
+        }
+        if (n.kind == "guard_ptr" || n.kind == "guard_nonnull") {
+            const GNode& x = rw.node(n.x);
+            if (x.kind == "guard_nonnull" || (x.kind == "guard_ptr" && n.kind == "guard_ptr")) {
+                rw.remap[id] = n.x;
+                continue;
+            }
+            if (x.kind == "guard_ptr") {
+                n.x = x.x;
+            }
+        }
+        if (n.kind == "select" && rw.node(n.cond).kind == "const_int") {
+            rw.remap[id] = rw.node(n.cond).value ? n.then_id : n.else_id;
+            continue;
+        }
+        rw.remap[id] = rw.intern(n);
+    }
+    rw.out.output = rw.remap[g.output];
+    return rw.out;
+}
+
+static void countUses(const Graph& g, int id, std::vector<int>& uses, std::vector<char>& seen) {
+    if (!id || seen[id]) {
+        return;
+    }
+    seen[id] = 1;
+    const GNode& n = g.nodes[id];
+    for (int operand : {n.x, n.y, n.cond, n.then_id, n.else_id}) {
+        if (operand) {
+            uses[operand]++;
+            countUses(g, operand, uses, seen);
+        }
+    }
+}
+
+/* Chain fusion: a getfield or loop_chain whose operand is a getfield or
+   loop_chain on the same field, used nowhere else, becomes one loop_chain
+   over both. Only nodes reachable from the output are kept. */
+static Graph fuseChains(const Graph& g) {
+    std::vector<int> uses(g.nodes.size(), 0);
+    std::vector<char> seen(g.nodes.size(), 0);
+    countUses(g, g.output, uses, seen);
+
+    GraphRewriter rw(g);
+    for (size_t id = 1; id < g.nodes.size(); ++id) {
+        if (!seen[id]) {
+            continue;
+        }
+        GNode n = g.nodes[id];
+        int oldX = n.x;
+        n.x = rw.remap[n.x];
+        n.y = rw.remap[n.y];
+        n.cond = rw.remap[n.cond];
+        n.then_id = rw.remap[n.then_id];
+        n.else_id = rw.remap[n.else_id];
+        if ((n.kind == "getfield" || n.kind == "loop_chain") && uses[oldX] == 1) {
+            const GNode& x = rw.node(n.x);
+            if ((x.kind == "getfield" || x.kind == "loop_chain") && x.field == n.field) {
+                int loads = (n.kind == "loop_chain" ? n.value : 1) + (x.kind == "loop_chain" ? x.value : 1);
+                GNode fused;
+                fused.kind = "loop_chain";
+                fused.x = x.x;
+                fused.field = n.field;
+                fused.value = loads;
+                n = fused;
+            }
+        }
+        rw.remap[id] = rw.intern(n);
+    }
+    rw.out.output = rw.remap[g.output];
+    return rw.out;
+}
+
+/* Count of nodes reachable from the output. */
+static int liveNodes(const Graph& g) {
+    std::vector<int> uses(g.nodes.size(), 0);
+    std::vector<char> seen(g.nodes.size(), 0);
+    countUses(g, g.output, uses, seen);
+    int n = 0;
+    for (char s : seen) {
+        n += s;
+    }
+    return n;
+}
+
+/* How the function returns its Eval: {i64 ok|err<<32, i32 value} as clang
+   passes a 12-byte struct on x86-64, or the struct itself. */
+enum EvalAbi { ABI_NONE, ABI_PAIR, ABI_STRUCT };
+
+static EvalAbi evalAbi(Type* ty, const DataLayout& DL) {
+    auto* st = dyn_cast<StructType>(ty);
+    if (!st || !DL.isLittleEndian()) {
+        return ABI_NONE;
+    }
+    if (st->getNumElements() == 2 && st->getElementType(0)->isIntegerTy(64) &&
+        st->getElementType(1)->isIntegerTy(32)) {
+        return ABI_PAIR;
+    }
+    if (st->getNumElements() == 3 && st->getElementType(0)->isIntegerTy(32) &&
+        st->getElementType(1)->isIntegerTy(32) && st->getElementType(2)->isIntegerTy(32)) {
+        return ABI_STRUCT;
+    }
+    return ABI_NONE;
+}
+
+/* A lowered node: its tagged value on the success path, plus what is known
+   about it there. */
+struct Lowered {
+    Value* v = nullptr;
+    Value* flag = nullptr; /* the i1 behind a tagged 0/1 */
+    bool isInt = false;    /* a tagged int */
+    bool isPtr = false;    /* a non-null pointer */
+    bool isObj = false;    /* a pointer to an object of the heap */
+};
+
+/* Where a failing check branches, with the phi collecting the error code
+   (null when nobody reads it, as for truthy). */
+struct ErrorTarget {
+    BasicBlock* bb = nullptr;
+    PHINode* err = nullptr;
+};
+
+/* Emits a graph as straight-line checks. Every node is evaluated where it is
+   first demanded, in operand order, and a failing check branches to the
+   current error target, so the first check to fail decides the error code
+   exactly as the strict ck_* calls do. Select arms and truthy operands are
+   emitted in their own scope: values (and facts such as "this pointer
+   already loaded fine") found there are forgotten after the join. */
+struct Lowering {
+    Function& F;
+    const Graph& g;
+    const std::map<std::string, Value*>& inputs;
+    IRBuilder<> B;
+    StructType* objTy = nullptr;
+    Value* numObjs = nullptr;
+    Value* objs = nullptr;
+    ErrorTarget target;
+    std::map<int, Lowered> memo;
+    std::vector<std::pair<int, Lowered>> undo; /* entries replaced in inner scopes */
+    std::vector<size_t> scopes;
+
+    Lowering(Function& F, const Graph& g, const std::map<std::string, Value*>& inputs)
+        : F(F), g(g), inputs(inputs), B(F.getContext()) {}
+
+    void remember(int id, const Lowered& l) {
+        auto it = memo.find(id);
+        undo.emplace_back(id, it == memo.end() ? Lowered() : it->second);
+        memo[id] = l;
+    }
+
+    void enterScope() {
+        scopes.push_back(undo.size());
+    }
+
+    void leaveScope() {
+        size_t mark = scopes.back();
+        scopes.pop_back();
+        while (undo.size() > mark) {
+            std::pair<int, Lowered> entry = undo.back();
+            undo.pop_back();
+            if (entry.second.v) {
+                memo[entry.first] = entry.second;
+            } else {
+                memo.erase(entry.first);
+            }
+        }
+    }
+
+    BasicBlock* newBlock(const Twine& name) {
+        return BasicBlock::Create(F.getContext(), name, &F);
+    }
+
+    void failIf(Value* cond, int err) {
+        if (auto* c = dyn_cast<ConstantInt>(cond)) {
+            if (c->isZero()) {
+                return;
+            }
+        }
+        BasicBlock* next = newBlock("ck.ok");
+        B.CreateCondBr(cond, target.bb, next);
+        if (target.err) {
+            target.err->addIncoming(B.getInt32(err), B.GetInsertBlock());
+        }
+        B.SetInsertPoint(next);
+    }
+
+    Value* isIntTag(Value* v) {
+        return B.CreateICmpNE(B.CreateAnd(v, 1), B.getInt32(0));
+    }
+
+    Value* untag(Value* v) {
+        return B.CreateAShr(v, 1);
+    }
+
+    Lowered tagBool(Value* b) {
+        Lowered r;
+        r.v = B.CreateOr(B.CreateShl(B.CreateZExt(b, B.getInt32Ty()), 1), 1);
+        r.flag = b;
+        r.isInt = true;
+        return r;
+    }
+
+    void requirePtr(const Lowered& x) {
+        if (!x.isPtr) {
+            failIf(isIntTag(x.v), ERR_TYPE);
+        }
+    }
+
+    /* load_field in runtime/checked_ptr.c on a plain heap; xid (when not 0)
+       is the node x came from, known to be a live object afterwards. */
+    Lowered loadField(const Lowered& x, int field, bool requireInt, int xid) {
+        Lowered r;
+        Value* idx;
+        if (!x.isPtr) {
+            failIf(isIntTag(x.v), ERR_TYPE);
+            failIf(B.CreateICmpEQ(x.v, B.getInt32(0)), ERR_NULL);
+        }
+        /* addr - 1 < num_objs as unsigned covers addr <= 0 too */
+        idx = B.CreateSub(untag(x.v), B.getInt32(1));
+        if (!x.isObj) {
+            failIf(B.CreateICmpUGE(idx, numObjs), ERR_INVALID);
+        }
+        if (field < 0 || field >= kMaxFields) {
+            failIf(B.getTrue(), ERR_MISSING_FIELD);
+            r.v = B.getInt32(0);
+            return r;
+        }
+        Value* obj = B.CreateInBoundsGEP(objTy, objs, B.CreateZExt(idx, B.getInt64Ty()));
+        /* Obj: {int has_field[MAX_FIELDS]; int value[MAX_FIELDS]} */
+        Value* has = B.CreateLoad(B.getInt32Ty(), B.CreateInBoundsGEP(objTy, obj, {B.getInt32(0), B.getInt32(0), B.getInt32(field)}));
+        failIf(B.CreateICmpEQ(has, B.getInt32(0)), ERR_MISSING_FIELD);
+        r.v = B.CreateLoad(B.getInt32Ty(), B.CreateInBoundsGEP(objTy, obj, {B.getInt32(0), B.getInt32(1), B.getInt32(field)}));
+        if (requireInt) {
+            failIf(B.CreateNot(isIntTag(r.v)), ERR_TYPE);
+            r.isInt = true;
+        }
+        if (xid) {
+            Lowered known = x;
+            known.isPtr = true;
+            known.isObj = true;
+            remember(xid, known);
+        }
+        return r;
+    }
+
+    /* n.value checked loads of n.field starting at x (n.x). */
+    Lowered checkedChain(const Lowered& x, const GNode& n) {
+        Lowered cur = x;
+        int k;
+        if (n.value <= kUnrollChain) {
+            for (k = 0; k < n.value; ++k) {
+                cur = loadField(cur, n.field, false, k == 0 ? n.x : 0);
+            }
+            return cur;
+        }
+        /* first load checks what is known about x, the rest run in a loop */
+        cur = loadField(cur, n.field, false, n.x);
+        BasicBlock* pre = B.GetInsertBlock();
+        BasicBlock* loop = newBlock("chain");
+        B.CreateBr(loop);
+        B.SetInsertPoint(loop);
+        PHINode* i = B.CreatePHI(B.getInt32Ty(), 2, "chain.i");
+        PHINode* v = B.CreatePHI(B.getInt32Ty(), 2, "chain.v");
+        i->addIncoming(B.getInt32(0), pre);
+        v->addIncoming(cur.v, pre);
+        Lowered vl;
+        vl.v = v;
+        Lowered step = loadField(vl, n.field, false, 0);
+        Value* next = B.CreateAdd(i, B.getInt32(1));
+        BasicBlock* latch = B.GetInsertBlock();
+        BasicBlock* exit = newBlock("chain.end");
+        B.CreateCondBr(B.CreateICmpEQ(next, B.getInt32(n.value - 1)), exit, loop);
+        i->addIncoming(next, latch);
+        v->addIncoming(step.v, latch);
+        B.SetInsertPoint(exit);
+        return step;
+    }
+
+    /* One unchecked step of a speculative chain: v = objs[addr - 1].value[field]
+       with the address clamped to object 1 when out of range, and every
+       check that would have failed or-ed into bad. */
+    Value* specStep(Value* v, Value*& bad, int field) {
+        Value* idx = B.CreateSub(untag(v), B.getInt32(1));
+        Value* in = B.CreateICmpULT(idx, numObjs);
+        bad = B.CreateOr(bad, B.CreateOr(isIntTag(v), B.CreateOr(B.CreateICmpEQ(v, B.getInt32(0)), B.CreateNot(in))));
+        Value* safe = B.CreateZExt(B.CreateSelect(in, idx, B.getInt32(0)), B.getInt64Ty());
+        Value* obj = B.CreateInBoundsGEP(objTy, objs, safe);
+        Value* has = B.CreateLoad(B.getInt32Ty(), B.CreateInBoundsGEP(objTy, obj, {B.getInt32(0), B.getInt32(0), B.getInt32(field)}));
+        bad = B.CreateOr(bad, B.CreateICmpEQ(has, B.getInt32(0)));
+        return B.CreateLoad(B.getInt32Ty(), B.CreateInBoundsGEP(objTy, obj, {B.getInt32(0), B.getInt32(1), B.getInt32(field)}));
+    }
+
+    /* Chains of two or more loads are speculated like ck_load_chain: the
+       whole chain runs with one branch on the combined checks at the end,
+       and only a failure (or an empty heap) takes the checked chain, which
+       finds the error code. */
+    Lowered loopChain(const GNode& n) {
+        Lowered x = emit(n.x);
+        if (n.value < 2 || n.field < 0 || n.field >= kMaxFields) {
+            return checkedChain(x, n);
+        }
+        BasicBlock* spec = newBlock("spec");
+        BasicBlock* slow = newBlock("spec.fail");
+        BasicBlock* join = newBlock("spec.end");
+        B.CreateCondBr(B.CreateICmpEQ(numObjs, B.getInt32(0)), slow, spec);
+
+        B.SetInsertPoint(spec);
+        Value* v = x.v;
+        Value* bad = B.getFalse();
+        if (n.value <= kUnrollChain) {
+            for (int k = 0; k < n.value; ++k) {
+                v = specStep(v, bad, n.field);
+            }
+        } else {
+            BasicBlock* loop = newBlock("spec.loop");
+            B.CreateBr(loop);
+            B.SetInsertPoint(loop);
+            PHINode* i = B.CreatePHI(B.getInt32Ty(), 2, "spec.i");
+            PHINode* pv = B.CreatePHI(B.getInt32Ty(), 2, "spec.v");
+            PHINode* pbad = B.CreatePHI(B.getInt1Ty(), 2, "spec.bad");
+            i->addIncoming(B.getInt32(0), spec);
+            pv->addIncoming(v, spec);
+            pbad->addIncoming(bad, spec);
+            bad = pbad;
+            v = specStep(pv, bad, n.field);
+            Value* next = B.CreateAdd(i, B.getInt32(1));
+            BasicBlock* done = newBlock("spec.done");
+            B.CreateCondBr(B.CreateICmpEQ(next, B.getInt32(n.value)), done, loop);
+            i->addIncoming(next, loop);
+            pv->addIncoming(v, loop);
+            pbad->addIncoming(bad, loop);
+            B.SetInsertPoint(done);
+        }
+        BasicBlock* specEnd = B.GetInsertBlock();
+        B.CreateCondBr(bad, slow, join);
+
+        B.SetInsertPoint(slow);
+        enterScope();
+        Lowered checked = checkedChain(x, n);
+        leaveScope();
+        BasicBlock* slowEnd = B.GetInsertBlock();
+        B.CreateBr(join);
+
+        B.SetInsertPoint(join);
+        PHINode* phi = B.CreatePHI(B.getInt32Ty(), 2);
+        phi->addIncoming(v, specEnd);
+        phi->addIncoming(checked.v, slowEnd);
+        /* both ways, x was loaded from */
+        Lowered known = x;
+        known.isPtr = true;
+        known.isObj = true;
+        remember(n.x, known);
+        Lowered r;
+        r.v = phi;
+        return r;
+    }
+
+    Lowered select(const GNode& n) {
+        Lowered c = emit(n.cond);
+        if (!c.isInt) {
+            failIf(B.CreateNot(isIntTag(c.v)), ERR_TYPE);
+        }
+        Value* taken = c.flag ? c.flag : B.CreateICmpNE(untag(c.v), B.getInt32(0));
+        if (auto* k = dyn_cast<ConstantInt>(taken)) {
+            return emit(k->isZero() ? n.else_id : n.then_id);
+        }
+        BasicBlock* thenBB = newBlock("sel.then");
+        BasicBlock* elseBB = newBlock("sel.else");
+        BasicBlock* join = newBlock("sel.join");
+        B.CreateCondBr(taken, thenBB, elseBB);
+        Lowered arms[2];
+        BasicBlock* ends[2];
+        int ids[2] = {n.then_id, n.else_id};
+        BasicBlock* starts[2] = {thenBB, elseBB};
+        int guarded = nonNullTested(n.cond);
+        for (int a = 0; a < 2; ++a) {
+            B.SetInsertPoint(starts[a]);
+            enterScope();
+            if (a == 0 && guarded) {
+                Lowered known = emit(guarded);
+                known.isPtr = true;
+                remember(guarded, known);
+            }
+            arms[a] = emit(ids[a]);
+            leaveScope();
+            ends[a] = B.GetInsertBlock();
+            B.CreateBr(join);
+        }
+        B.SetInsertPoint(join);
+        PHINode* phi = B.CreatePHI(B.getInt32Ty(), 2);
+        phi->addIncoming(arms[0].v, ends[0]);
+        phi->addIncoming(arms[1].v, ends[1]);
+        Lowered r;
+        r.v = phi;
+        r.isInt = arms[0].isInt && arms[1].isInt;
+        r.isPtr = arms[0].isPtr && arms[1].isPtr;
+        r.isObj = arms[0].isObj && arms[1].isObj;
+        return r;
+    }
+
+    /* x when cond is truthy(is_nonnull(x)) and x's value is available in
+       the arms (an input, or emitted before the test), else 0. */
+    int nonNullTested(int cond) {
+        const GNode& c = g.nodes[cond];
+        if (c.kind != "truthy" || g.nodes[c.x].kind != "is_nonnull") {
+            return 0;
+        }
+        int x = g.nodes[c.x].x;
+        return g.nodes[x].kind == "input" || memo.count(x) ? x : 0;
+    }
+
+    /* ck_truthy: any error of x means 0 */
+    Lowered truthy(const GNode& n) {
+        ErrorTarget saved = target;
+        BasicBlock* falseBB = newBlock("truthy.err");
+        target = ErrorTarget();
+        target.bb = falseBB;
+        enterScope();
+        Lowered x = emit(n.x);
+        Value* t = x.flag ? x.flag : B.CreateICmpNE(untag(x.v), B.getInt32(0));
+        if (!x.isInt) {
+            t = B.CreateAnd(isIntTag(x.v), t);
+        }
+        leaveScope();
+        target = saved;
+        BasicBlock* okEnd = B.GetInsertBlock();
+        BasicBlock* cont = newBlock("truthy.end");
+        B.CreateBr(cont);
+        B.SetInsertPoint(cont);
+        if (pred_empty(falseBB)) {
+            falseBB->eraseFromParent();
+            return tagBool(t);
+        }
+        IRBuilder<>(falseBB).CreateBr(cont);
+        PHINode* phi = B.CreatePHI(B.getInt1Ty(), 2);
+        phi->addIncoming(t, okEnd);
+        phi->addIncoming(B.getFalse(), falseBB);
+        return tagBool(phi);
+    }
+
+    Lowered emit(int id) {
+        auto it = memo.find(id);
+        if (it != memo.end()) {
+            return it->second;
+        }
+        const GNode& n = g.nodes[id];
+        Lowered r;
+        if (n.kind == "input") {
+            r.v = inputs.at(n.name);
+        } else if (n.kind == "const_int") {
+            r.v = B.getInt32((uint32_t)n.value * 2u + 1u);
+            r.isInt = true;
+        } else if (n.kind == "const_null") {
+            r.v = B.getInt32(0);
+        } else if (n.kind == "is_nonnull") {
+            Lowered x = emit(n.x);
+            requirePtr(x);
+            r = tagBool(x.isPtr ? B.getTrue() : B.CreateICmpNE(x.v, B.getInt32(0)));
+        } else if (n.kind == "guard_ptr" || n.kind == "guard_nonnull") {
+            Lowered x = emit(n.x);
+            requirePtr(x);
+            r = x;
+            r.flag = nullptr;
+            if (n.kind == "guard_nonnull" && !x.isPtr) {
+                failIf(B.CreateICmpEQ(x.v, B.getInt32(0)), ERR_NULL);
+                r.isPtr = true;
+            }
+        } else if (n.kind == "guard_eq") {
+            Lowered a = emit(n.x);
+            Lowered b = emit(n.y);
+            r = tagBool(B.CreateICmpEQ(a.v, b.v));
+        } else if (n.kind == "add") {
+            Lowered a = emit(n.x);
+            Lowered b = emit(n.y);
+            if (!a.isInt || !b.isInt) {
+                failIf(B.CreateNot(B.CreateAnd(isIntTag(a.v), isIntTag(b.v))), ERR_TYPE);
+            }
+            r.v = B.CreateOr(B.CreateShl(B.CreateAdd(untag(a.v), untag(b.v)), 1), 1);
+            r.isInt = true;
+        } else if (n.kind == "getfield" || n.kind == "getfield_int") {
+            Lowered x = emit(n.x);
+            r = loadField(x, n.field, n.kind == "getfield_int", n.x);
+        } else if (n.kind == "loop_chain") {
+            r = loopChain(n);
+        } else if (n.kind == "select") {
+            r = select(n);
+        } else if (n.kind == "truthy") {
+            r = truthy(n);
+        } else {
+            report_fatal_error(Twine("lower-guarded-graph: unknown node kind ") + n.kind);
+        }
+        remember(id, r);
+        return r;
+    }
+};
+
+static bool graphReadsHeap(const Graph& g) {
+    std::vector<int> uses(g.nodes.size(), 0);
+    std::vector<char> seen(g.nodes.size(), 0);
+    countUses(g, g.output, uses, seen);
+    for (size_t id = 1; id < g.nodes.size(); ++id) {
+        if (seen[id] && isLoad(g.nodes[id])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* const kKnownKinds[] = {"input", "const_int", "const_null", "is_nonnull", "guard_ptr",
+                                          "guard_nonnull", "guard_eq", "add", "load_ptr", "load_int", "getfield", "getfield_int",
+                                          "loop_chain", "select", "truthy"};
+
+/* Input name -> the argument or constant F passes to ck_input. */
+static bool collectInputs(Function& F, std::map<std::string, Value*>& inputs) {
+    for (Instruction& I : instructions(F)) {
+        auto* call = dyn_cast<CallInst>(&I);
+        Function* callee = call ? call->getCalledFunction() : nullptr;
+        if (!callee || callee->getName() != "ck_input" || call->arg_size() != 2) {
+            continue;
+        }
+        StringRef name;
+        Value* v = call->getArgOperand(1);
+        if (!getConstantStringInfo(call->getArgOperand(0), name) || !(isa<Argument>(v) || isa<Constant>(v))) {
+            return false;
+        }
+        inputs[name.str()] = v;
+    }
+    return true;
+}
+
+static std::string whyNotLowerable(Function& F, const Graph& g, std::map<std::string, Value*>& inputs) {
+    if (evalAbi(F.getReturnType(), F.getParent()->getDataLayout()) == ABI_NONE) {
+        return "unsupported Eval return type";
+    }
+    if (F.arg_size() < 1 || !F.getArg(0)->getType()->isPointerTy()) {
+        return "first argument is not the heap";
+    }
+    if (!collectInputs(F, inputs)) {
+        return "ck_input of a computed value";
+    }
+    std::set<std::string> known(std::begin(kKnownKinds), std::end(kKnownKinds));
+    for (size_t id = 1; id < g.nodes.size(); ++id) {
+        const GNode& n = g.nodes[id];
+        if (n.kind.empty()) {
+            continue;
+        }
+        if (!known.count(n.kind)) {
+            return "node kind " + n.kind;
+        }
+        if (n.kind == "input" && !inputs.count(n.name)) {
+            return "input " + n.name + " not passed to ck_input";
+        }
+    }
+    return "";
+}
+
+static Value* buildEval(IRBuilder<>& B, Type* retTy, EvalAbi abi, Value* ok, Value* err, Value* value) {
+    Value* r = UndefValue::get(retTy);
+    if (abi == ABI_PAIR) {
+        Value* lo = B.CreateOr(B.CreateZExt(ok, B.getInt64Ty()), B.CreateShl(B.CreateZExt(err, B.getInt64Ty()), 32));
+        r = B.CreateInsertValue(r, lo, 0);
+        return B.CreateInsertValue(r, value, 1);
+    }
+    r = B.CreateInsertValue(r, ok, 0);
+    r = B.CreateInsertValue(r, err, 1);
+    return B.CreateInsertValue(r, value, 2);
+}
+
+/* Replace F's body with the lowered graph. Compact heap views and a null
+   heap go to F's original body, kept as <name>.checked. */
+static void lowerKernel(Function& F, const Graph& g, const std::map<std::string, Value*>& inputs) {
+    LLVMContext& ctx = F.getContext();
+    const DataLayout& DL = F.getParent()->getDataLayout();
+    Type* retTy = F.getReturnType();
+    EvalAbi abi = evalAbi(retTy, DL);
+    bool readsHeap = graphReadsHeap(g);
+
+    Function* checked = nullptr;
+    if (readsHeap) {
+        ValueToValueMapTy vmap;
+        checked = CloneFunction(&F, vmap);
+        checked->setName(F.getName() + ".checked");
+        checked->setLinkage(GlobalValue::InternalLinkage);
+        checked->removeFnAttr("guarded_kernel");
+    }
+    for (BasicBlock& BB : F) {
+        BB.dropAllReferences();
+    }
+    while (!F.empty()) {
+        F.begin()->eraseFromParent();
+    }
+
+    Lowering L(F, g, inputs);
+    IRBuilder<>& B = L.B;
+    BasicBlock* entry = L.newBlock("entry");
+    BasicBlock* errBB = L.newBlock("ck.error");
+    B.SetInsertPoint(errBB);
+    L.target.bb = errBB;
+    L.target.err = B.CreatePHI(B.getInt32Ty(), 4, "err");
+    B.CreateRet(buildEval(B, retTy, abi, B.getInt32(0), L.target.err, B.getInt32(0)));
+
+    B.SetInsertPoint(entry);
+    if (readsHeap) {
+        /* Heap: {int num_objs; Obj* objs; HeapPages pages; int locked;
+           size_t map_bytes; const CompactHeap* compact}; runtime/checked_ptr.c
+           fails to build if the struct stops matching this */
+        Type* i32 = B.getInt32Ty();
+        L.objTy = StructType::get(ctx, {ArrayType::get(i32, kMaxFields), ArrayType::get(i32, kMaxFields)});
+        StructType* heapTy = StructType::get(ctx, {i32, PointerType::getUnqual(L.objTy), i32, i32,
+                                                   DL.getIntPtrType(ctx), B.getInt8PtrTy()});
+        Value* heap = B.CreatePointerCast(F.getArg(0), PointerType::getUnqual(heapTy));
+        BasicBlock* plain = L.newBlock("heap");
+        BasicBlock* fast = L.newBlock("fast");
+        BasicBlock* slow = L.newBlock("checked");
+        B.CreateCondBr(B.CreateIsNull(heap), slow, plain);
+
+        B.SetInsertPoint(plain);
+        Value* compact = B.CreateLoad(B.getInt8PtrTy(), B.CreateStructGEP(heapTy, heap, kHeapCompactIndex));
+        B.CreateCondBr(B.CreateIsNotNull(compact), slow, fast);
+
+        B.SetInsertPoint(slow);
+        std::vector<Value*> args;
+        for (Argument& arg : F.args()) {
+            args.push_back(&arg);
+        }
+        CallInst* call = B.CreateCall(checked, args);
+        call->setTailCall();
+        B.CreateRet(call);
+
+        B.SetInsertPoint(fast);
+        L.numObjs = B.CreateLoad(i32, B.CreateStructGEP(heapTy, heap, 0), "num_objs");
+        L.objs = B.CreateLoad(PointerType::getUnqual(L.objTy), B.CreateStructGEP(heapTy, heap, 1), "objs");
+    }
+
+    Lowered out = L.emit(g.output);
+    B.CreateRet(buildEval(B, retTy, abi, B.getInt32(1), B.getInt32(0), out.v));
+    if (pred_empty(errBB)) {
+        errBB->eraseFromParent();
+    }
+    if (verifyFunction(F, &errs())) {
+        report_fatal_error("lower-guarded-graph: broken IR for " + F.getName());
+    }
+}
+
+/* Kernel names from the guarded-graph manifest. */
+static std::vector<std::string> manifestKernels() {
+    std::vector<std::string> names;
+    std::string path = outDir() + "/manifest.json";
+    if (const char* env = std::getenv("GRAPH_MANIFEST")) {
+        path = env;
+    }
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buf = MemoryBuffer::getFile(path);
+    if (!buf) {
+        errs() << "lower-guarded-graph: no manifest at " << path << "\n";
+        return names;
+    }
+    Expected<json::Value> root = json::parse((*buf)->getBuffer());
+    if (!root) {
+        consumeError(root.takeError());
+        return names;
+    }
+    const json::Object* obj = root->getAsObject();
+    const json::Array* kernels = obj ? obj->getArray("kernels") : nullptr;
+    if (!kernels) {
+        return names;
+    }
+    for (const json::Value& v : *kernels) {
+        const json::Object* k = v.getAsObject();
+        if (k && k->getString("name")) {
+            names.push_back(k->getString("name")->str());
+        }
+    }
+    return names;
+}
+
+struct LowerGuardedGraphPass : PassInfoMixin<LowerGuardedGraphPass> {
+    PreservedAnalyses run(Module& M, ModuleAnalysisManager&) {
+        bool changed = false;
+        for (const std::string& name : manifestKernels()) {
+            Function* F = M.getFunction(name);
+            if (!F || F->isDeclaration()) {
+                continue;
+            }
+            Graph raw;
+            std::string path = outDir() + "/" + name + ".json";
+            if (!loadGraph(path, raw)) {
+                errs() << "lower-guarded-graph: skipping " << name << ": cannot read " << path << "\n";
+                continue;
+            }
+            std::map<std::string, Value*> inputs;
+            std::string why = whyNotLowerable(*F, raw, inputs);
+            if (!why.empty()) {
+                errs() << "lower-guarded-graph: skipping " << name << ": " << why << "\n";
+                continue;
+            }
+            Graph g = fuseChains(simplifyGuards(raw));
+            errs() << "lower-guarded-graph: " << name << ": " << liveNodes(raw) << " -> " << liveNodes(g)
+                   << " nodes\n";
+            lowerKernel(*F, g, inputs);
+            changed = true;
+        }
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+};
+
+} // namespace
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
+    return {LLVM_PLUGIN_API_VERSION, "LowerGuardedGraphPass", "0.1",
+            [](PassBuilder& PB) {
+                PB.registerPipelineParsingCallback(
+                    [](StringRef Name, ModulePassManager& MPM,
+                       ArrayRef<PassBuilder::PipelineElement>) {
+                        if (Name == "lower-guarded-graph") {
+                            MPM.addPass(LowerGuardedGraphPass());
+                            return true;
+                        }
+                        return false;
+                    });
+            }};
+}
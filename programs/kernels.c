@@ -1,6 +1,6 @@
 #include "checked_ptr.h"
 
-Eval triple_deref(Heap* heap, int p, int q) {
+CK_KERNEL Eval triple_deref(Heap* heap, int p, int q) {
     (void)q;
     Eval vp = ck_input("p", p);
     Eval v1 = ck_load_ptr(heap, vp);
@@ -9,7 +9,14 @@ Eval triple_deref(Heap* heap, int p, int q) {
     return v3;
 }
 
-Eval graph_walk(Heap* heap, int p, int q) {
+/* triple_deref as one speculative chain: a single check for all three loads
+   on the common path, the checked loads only when it fails. */
+CK_KERNEL Eval triple_deref_spec(Heap* heap, int p, int q) {
+    (void)q;
+    return ck_load_chain(heap, ck_input("p", p), FIELD_DEREF, 3);
+}
+
+CK_KERNEL Eval graph_walk(Heap* heap, int p, int q) {
     (void)q;
     Eval vp = ck_input("p", p);
     Eval v1 = ck_load_ptr(heap, vp);
@@ -19,7 +26,7 @@ Eval graph_walk(Heap* heap, int p, int q) {
     return v4;
 }
 
-Eval field_chain(Heap* heap, int p, int q) {
+CK_KERNEL Eval field_chain(Heap* heap, int p, int q) {
     (void)q;
     Eval vp = ck_input("p", p);
     Eval v1 = ck_getfield(heap, vp, FIELD_F);
@@ -27,7 +34,7 @@ Eval field_chain(Heap* heap, int p, int q) {
     return v2;
 }
 
-Eval guarded_chain(Heap* heap, int p, int q) {
+CK_KERNEL Eval guarded_chain(Heap* heap, int p, int q) {
     (void)q;
     Eval vp = ck_input("p", p);
     Eval cond = ck_guard_nonnull(vp);
@@ -36,7 +43,7 @@ Eval guarded_chain(Heap* heap, int p, int q) {
     return ck_select(cond, then_v, else_v);
 }
 
-Eval alias_branch(Heap* heap, int p, int q) {
+CK_KERNEL Eval alias_branch(Heap* heap, int p, int q) {
     Eval vp = ck_input("p", p);
     Eval vq = ck_input("q", q);
     Eval cond = ck_guard_eq(vp, vq);
@@ -45,7 +52,7 @@ Eval alias_branch(Heap* heap, int p, int q) {
     return ck_select(cond, then_v, else_v);
 }
 
-Eval mixed_fields(Heap* heap, int p, int q) {
+CK_KERNEL Eval mixed_fields(Heap* heap, int p, int q) {
     (void)q;
     Eval vp = ck_input("p", p);
     Eval pf = ck_getfield(heap, vp, FIELD_F);
@@ -55,10 +62,45 @@ Eval mixed_fields(Heap* heap, int p, int q) {
     return ck_select(cond, then_v, else_v);
 }
 
-Eval add_two(Heap* heap, int p, int q) {
+CK_KERNEL Eval add_two(Heap* heap, int p, int q) {
     Eval vp = ck_input("p", p);
     Eval vq = ck_input("q", q);
     Eval lp = ck_load_ptr(heap, vp);
     Eval lq = ck_load_ptr(heap, vq);
     return ck_add(lp, lq);
 }
+
+/* Ordinary control flow: the pass turns the branches into selects. */
+CK_KERNEL Eval branch_chain(Heap* heap, int p, int q) {
+    (void)q;
+    Eval vp = ck_input("p", p);
+    if (!ck_truthy(ck_guard_nonnull(vp))) {
+        return ck_const_int(0);
+    }
+    return ck_load_ptr(heap, ck_load_ptr(heap, vp));
+}
+
+/* Follows up to three links, stopping at the first null or int. */
+CK_KERNEL Eval bounded_walk(Heap* heap, int p, int q) {
+    Eval cur = ck_input("p", p);
+    int i;
+    (void)q;
+    for (i = 0; i < 3; ++i) {
+        if (!ck_truthy(ck_guard_nonnull(cur))) {
+            break;
+        }
+        cur = ck_load_ptr(heap, cur);
+    }
+    return cur;
+}
+
+/* A counted loop over one field, extracted as a loop_chain node. */
+CK_KERNEL Eval deep_walk(Heap* heap, int p, int q) {
+    Eval cur = ck_input("p", p);
+    int i;
+    (void)q;
+    for (i = 0; i < 64; ++i) {
+        cur = ck_getfield(heap, cur, FIELD_F);
+    }
+    return cur;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "checked_ptr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef Eval (*KernelFn)(Heap*, int, int);
+
+typedef struct {
+    const char* name;
+    KernelFn fn;
+    int fields[MAX_FIELDS];
+    int num_fields;
+    int use_p;
+    int use_q;
+} Kernel;
+
+Eval triple_deref(Heap* heap, int p, int q);
+Eval triple_deref_spec(Heap* heap, int p, int q);
+Eval graph_walk(Heap* heap, int p, int q);
+Eval field_chain(Heap* heap, int p, int q);
+Eval guarded_chain(Heap* heap, int p, int q);
+Eval alias_branch(Heap* heap, int p, int q);
+Eval mixed_fields(Heap* heap, int p, int q);
+Eval add_two(Heap* heap, int p, int q);
+Eval branch_chain(Heap* heap, int p, int q);
+Eval bounded_walk(Heap* heap, int p, int q);
+Eval deep_walk(Heap* heap, int p, int q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
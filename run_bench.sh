@@ -7,12 +7,26 @@ BUILD_DIR="${BUILD_DIR:-$ROOT/build}"
 BUILD_LLVM_DIR="${BUILD_LLVM_DIR:-$ROOT/build_llvm}"
 CLANG_BIN="${CLANG:-clang}"
 OPT_BIN="${OPT:-opt}"
-ITERS="${ITERS:-10000000}"
-RUNS="${RUNS:-5}"
-WARMUP="${WARMUP:-1}"
+SAMPLES="${SAMPLES:-50}"
+WARMUP_MS="${WARMUP_MS:-200}"
+SAMPLE_MS="${SAMPLE_MS:-20}"
+CPU="${CPU:--1}"
 DATA_PATH="${DATA_PATH:-$ROOT/viz/bench_data.js}"
 RUN_SSA="${RUN_SSA:-1}"
 SSA_DATA_PATH="${SSA_DATA_PATH:-$ROOT/viz/bench_data_ssa.js}"
+RUN_MATRIX="${RUN_MATRIX:-1}"
+MATRIX_DATA_PATH="${MATRIX_DATA_PATH:-$ROOT/viz/bench_matrix.js}"
+RECORD_HISTORY="${RECORD_HISTORY:-1}"
+RUN_PATHS="${RUN_PATHS:-1}"
+RUN_PAGES="${RUN_PAGES:-1}"
+PAGES_OBJS="${PAGES_OBJS:-16777216}"
+PAGES_KINDS="${PAGES_KINDS:-4k thp 2m 1g}"
+PERF="${PERF:-0}"
+BUILD_ONLY="${BUILD_ONLY:-0}"
+HARNESS_FLAGS="--samples $SAMPLES --warmup_ms $WARMUP_MS --sample_ms $SAMPLE_MS --cpu $CPU"
+if [ "$PERF" -ne 0 ]; then
+  HARNESS_FLAGS="$HARNESS_FLAGS --perf"
+fi
 
 mkdir -p "$OUT_DIR"
 
@@ -22,9 +36,14 @@ cmake --build "$BUILD_LLVM_DIR" --config Release
 cmake -S "$ROOT" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release
 cmake --build "$BUILD_DIR" --config Release
 
-"$CLANG_BIN" -S -emit-llvm -O0 -g -fno-discard-value-names -fno-inline -Xclang -disable-O0-optnone \
-  -I "$ROOT/runtime" -I "$ROOT/programs" \
-  "$ROOT/programs/kernels.c" -o "$BUILD_DIR/kernels.ll"
+# only re-emit kernels.ll when its sources changed; extract_graphs.sh skips
+# it (and, inside, every unchanged kernel) the same way
+KERNEL_SRCS=("$ROOT/programs/kernels.c" "$ROOT/programs/kernels.h" "$ROOT/runtime/checked_ptr.h")
+if [ ! -f "$BUILD_DIR/kernels.ll" ] || [ -n "$(find "${KERNEL_SRCS[@]}" -newer "$BUILD_DIR/kernels.ll")" ]; then
+  "$CLANG_BIN" -S -emit-llvm -O2 -fno-discard-value-names \
+    -I "$ROOT/runtime" -I "$ROOT/programs" \
+    "$ROOT/programs/kernels.c" -o "$BUILD_DIR/kernels.ll"
+fi
 
 GRAPH_PASS="$BUILD_LLVM_DIR/libGuardedGraphPass.so"
 if [ ! -f "$GRAPH_PASS" ]; then
@@ -36,8 +55,8 @@ if [ ! -f "$COLLAPSE_PASS" ]; then
   COLLAPSE_PASS="$BUILD_LLVM_DIR/libCollapseDerefsPass.dylib"
 fi
 
-GRAPH_OUT_DIR="$OUT_DIR" "$OPT_BIN" -load-pass-plugin "$GRAPH_PASS" \
-  -passes="guarded-graph" -disable-output "$BUILD_DIR/kernels.ll"
+OUT_DIR="$OUT_DIR" OPT="$OPT_BIN" PASS_LIB="$GRAPH_PASS" \
+  bash "$ROOT/extract_graphs.sh" "$BUILD_DIR/kernels.ll"
 
 BASE_BIN="$BUILD_DIR/bench_triple_deref"
 
@@ -48,7 +67,7 @@ BASE_BIN="$BUILD_DIR/bench_triple_deref"
 GRAPH_OUT_DIR="$OUT_DIR" "$OPT_BIN" -load-pass-plugin "$COLLAPSE_PASS" \
   -passes="collapse-deref" -S "$BUILD_DIR/bench.ll" -o "$BUILD_DIR/bench_opt.ll"
 
-"$CLANG_BIN" -O3 "$BUILD_DIR/bench_opt.ll" -L "$BUILD_DIR" -lkernels -lruntime \
+"$CLANG_BIN" -O3 "$BUILD_DIR/bench_opt.ll" -L "$BUILD_DIR" -lkernels -lruntime -lbenchutil -lm -lpthread \
   -o "$BUILD_DIR/bench_triple_deref_opt"
 
 SSA_BIN="$BUILD_DIR/bench_triple_deref_ssa"
@@ -61,49 +80,35 @@ if [ "$RUN_SSA" -ne 0 ]; then
   GRAPH_OUT_DIR="$OUT_DIR" "$OPT_BIN" -load-pass-plugin "$COLLAPSE_PASS" \
     -passes="collapse-deref" -S "$BUILD_DIR/bench_ssa.ll" -o "$BUILD_DIR/bench_ssa_opt.ll"
 
-  "$CLANG_BIN" -O3 "$BUILD_DIR/bench_ssa_opt.ll" -L "$BUILD_DIR" -lkernels -lruntime \
+  "$CLANG_BIN" -O3 "$BUILD_DIR/bench_ssa_opt.ll" -L "$BUILD_DIR" -lkernels -lruntime -lbenchutil -lm -lpthread \
     -o "$SSA_OPT_BIN"
 fi
 
-BASE_CALLS=$(grep -c "call.*@triple_deref" "$BUILD_DIR/bench.ll" || true)
-OPT_CALLS=$(grep -c "call.*@triple_deref" "$BUILD_DIR/bench_opt.ll" || true)
-echo "IR call count (triple_deref): baseline=$BASE_CALLS optimized=$OPT_CALLS"
-if [ "$RUN_SSA" -ne 0 ]; then
-  SSA_BASE_CALLS=$(grep -c "call.*@triple_deref" "$BUILD_DIR/bench_ssa.ll" || true)
-  SSA_OPT_CALLS=$(grep -c "call.*@triple_deref" "$BUILD_DIR/bench_ssa_opt.ll" || true)
-  echo "IR call count (triple_deref, SSA): baseline=$SSA_BASE_CALLS optimized=$SSA_OPT_CALLS"
+# BUILD_ONLY=1 stops once the collapsed benchmark binaries are linked.
+if [ "$BUILD_ONLY" -ne 0 ]; then
+  echo "built $BUILD_DIR/bench_triple_deref_opt$([ "$RUN_SSA" -ne 0 ] && echo " and $SSA_OPT_BIN")"
+  exit 0
 fi
 
-stats() {
-  local prec="${1:-0}"
-  sort -n | awk -v prec="$prec" '{
-      a[NR]=$1; sum+=$1;
-    }
-    END{
-      if (NR==0) { print "n/a"; exit 0 }
-      min=a[1]; max=a[NR];
-      if (NR % 2) {
-        med=a[(NR+1)/2];
-      } else {
-        med=(a[NR/2] + a[NR/2+1]) / 2;
-      }
-      mean=sum/NR;
-      for (i=1;i<=NR;i++) { d=a[i]-mean; ss+=d*d; }
-      stdev=sqrt(ss/NR);
-      printf "mean=%.*f median=%.*f min=%.*f max=%.*f stdev=%.*f", prec, mean, prec, med, prec, min, prec, max, prec, stdev;
-    }'
-}
-
-ns_per_iter() {
-  awk -v t="$1" -v it="$2" 'BEGIN { if (it>0) printf "%.3f", t/it; else print "n/a"; }'
+# Calls to a kernel in an IR file: ir_calls <function> <file.ll>
+ir_calls() {
+  grep -c "call.*@$1(" "$2" || true
 }
 
-extract_time() {
-  echo "$1" | awk -F'time_ns=' '{print $2}' | awk '{print $1}'
-}
+BASE_CALLS=$(ir_calls triple_deref "$BUILD_DIR/bench.ll")
+OPT_CALLS=$(ir_calls triple_deref "$BUILD_DIR/bench_opt.ll")
+echo "IR call count (triple_deref): baseline=$BASE_CALLS optimized=$OPT_CALLS"
+if [ "$RUN_SSA" -ne 0 ]; then
+  SSA_BASE_CALLS=$(ir_calls triple_deref "$BUILD_DIR/bench_ssa.ll")
+  SSA_OPT_CALLS=$(ir_calls triple_deref "$BUILD_DIR/bench_ssa_opt.ll")
+  echo "IR call count (triple_deref, SSA): baseline=$SSA_BASE_CALLS optimized=$SSA_OPT_CALLS"
+fi
 
-echo "bench config: iters=$ITERS runs=$RUNS warmup=$WARMUP"
+echo "bench config: samples=$SAMPLES warmup_ms=$WARMUP_MS sample_ms=$SAMPLE_MS cpu=$CPU perf=$PERF"
 
+# Each binary warms up, calibrates, samples and rejects outliers in-process
+# (driver/bench_harness.c); bench_compare turns the two JSON results into the
+# viz record with a bootstrap CI on the speedup.
 run_variant() {
   local label="$1"
   local base_bin="$2"
@@ -112,149 +117,122 @@ run_variant() {
   local data_var="$5"
   local base_calls="$6"
   local opt_calls="$7"
+  local base_json="$BUILD_DIR/${label}_baseline.json"
+  local opt_json="$BUILD_DIR/${label}_optimized.json"
 
-  local -a base_times=()
-  local -a opt_times=()
-  local -a speedups=()
-  local -a base_nspi_list=()
-  local -a opt_nspi_list=()
+  echo "[$label] baseline: $("$base_bin" $HARNESS_FLAGS --json "$base_json")"
+  echo "[$label] optimized: $("$opt_bin" $HARNESS_FLAGS --json "$opt_json")"
 
-  # Warmup to stabilize caches/CPU frequency
-  for ((i=0; i<WARMUP; i++)); do
-    "$base_bin" --iters "$ITERS" >/dev/null
-    "$opt_bin" --iters "$ITERS" >/dev/null
-  done
+  mkdir -p "$(dirname "$data_path")"
+  "$BUILD_DIR/bench_compare" "$base_json" "$opt_json" --out "$data_path" --var "$data_var" \
+    --base_calls "$base_calls" --opt_calls "$opt_calls"
+}
 
-  for ((i=1; i<=RUNS; i++)); do
-    local base_out
-    local opt_out
-    local base_time
-    local opt_time
-    local speedup
-    local base_nspi
-    local opt_nspi
+run_variant "base" "$BASE_BIN" "$BUILD_DIR/bench_triple_deref_opt" "$DATA_PATH" "BENCH_DATA" "$BASE_CALLS" "$OPT_CALLS"
+if [ "$RUN_SSA" -ne 0 ]; then
+  run_variant "ssa" "$SSA_BIN" "$SSA_OPT_BIN" "$SSA_DATA_PATH" "BENCH_DATA_SSA" "$SSA_BASE_CALLS" "$SSA_OPT_CALLS"
+fi
 
-    base_out=$("$base_bin" --iters "$ITERS")
-    opt_out=$("$opt_bin" --iters "$ITERS")
+# Benchmark matrix: every kernel as native, CollapseDerefs-collapsed,
+# interpreted graph and compiled graph, each on its own heap configuration.
+if [ "$RUN_MATRIX" -ne 0 ]; then
+  "$CLANG_BIN" -S -emit-llvm -O3 \
+    -I "$ROOT/runtime" -I "$ROOT/programs" -I "$ROOT/checker" -I "$ROOT/driver" \
+    "$ROOT/driver/bench_matrix.c" -o "$BUILD_DIR/bench_matrix.ll"
 
-    base_time=$(extract_time "$base_out")
-    opt_time=$(extract_time "$opt_out")
-    speedup=$(awk -v b="$base_time" -v o="$opt_time" 'BEGIN { if (o>0) printf "%.3f", b/o; else print "n/a"; }')
+  COLLAPSE_FUNCS="*" GRAPH_OUT_DIR="$OUT_DIR" "$OPT_BIN" -load-pass-plugin "$COLLAPSE_PASS" \
+    -passes="collapse-deref" -S "$BUILD_DIR/bench_matrix.ll" -o "$BUILD_DIR/bench_matrix_opt.ll"
 
-    base_nspi=$(ns_per_iter "$base_time" "$ITERS")
-    opt_nspi=$(ns_per_iter "$opt_time" "$ITERS")
+  "$CLANG_BIN" -O3 "$BUILD_DIR/bench_matrix_opt.ll" -L "$BUILD_DIR" -lkernels -lchecker -lruntime -lbenchutil -lm -lpthread \
+    -o "$BUILD_DIR/bench_matrix_opt"
 
-    base_times+=("$base_time")
-    opt_times+=("$opt_time")
-    speedups+=("$speedup")
-    base_nspi_list+=("$base_nspi")
-    opt_nspi_list+=("$opt_nspi")
+  "$BUILD_DIR/bench_matrix" $HARNESS_FLAGS --graph_dir "$OUT_DIR" --json "$BUILD_DIR/matrix.json"
+  "$BUILD_DIR/bench_matrix_opt" $HARNESS_FLAGS --forms native --native_label collapsed \
+    --json "$BUILD_DIR/matrix_collapsed.json"
 
-    echo "[$label] run $i: baseline time_ns=$base_time ns/iter=$base_nspi | optimized time_ns=$opt_time ns/iter=$opt_nspi | speedup=${speedup}x"
+  KERNEL_NAMES=$(python3 -c 'import json,sys; print(" ".join(dict.fromkeys(r["kernel"] for r in json.load(open(sys.argv[1]))["rows"])))' "$BUILD_DIR/matrix.json")
+  MATRIX_CALLS=""
+  for k in $KERNEL_NAMES; do
+    MATRIX_CALLS="$MATRIX_CALLS $k=$(ir_calls "$k" "$BUILD_DIR/bench_matrix.ll"),$(ir_calls "$k" "$BUILD_DIR/bench_matrix_opt.ll")"
   done
 
-  local base_stat
-  local opt_stat
-  local spd_stat
-
-  base_stat=$(printf "%s\n" "${base_times[@]}" | stats 0)
-  opt_stat=$(printf "%s\n" "${opt_times[@]}" | stats 0)
-  spd_stat=$(printf "%s\n" "${speedups[@]}" | stats 3)
-  echo "[$label] baseline stats (time_ns): $base_stat"
-  echo "[$label] optimized stats (time_ns): $opt_stat"
-  echo "[$label] speedup stats (x): $spd_stat"
-
-  local base_times_csv
-  local opt_times_csv
-  local base_nspi_csv
-  local opt_nspi_csv
-  local speedups_csv
-
-  base_times_csv=$(IFS=,; echo "${base_times[*]}")
-  opt_times_csv=$(IFS=,; echo "${opt_times[*]}")
-  base_nspi_csv=$(IFS=,; echo "${base_nspi_list[*]}")
-  opt_nspi_csv=$(IFS=,; echo "${opt_nspi_list[*]}")
-  speedups_csv=$(IFS=,; echo "${speedups[*]}")
-
-  BASE_TIMES_CSV="$base_times_csv" OPT_TIMES_CSV="$opt_times_csv" \
-  BASE_NSPI_CSV="$base_nspi_csv" OPT_NSPI_CSV="$opt_nspi_csv" \
-  SPEEDUPS_CSV="$speedups_csv" \
-  BASE_CALLS="$base_calls" OPT_CALLS="$opt_calls" \
-  ITERS="$ITERS" RUNS="$RUNS" WARMUP="$WARMUP" DATA_PATH="$data_path" DATA_VAR="$data_var" \
-  python3 - <<'PY'
-import json, math, os, time
-
-def parse_csv(s):
-    if not s:
-        return []
-    return [float(x) for x in s.split(",") if x]
-
-def stats(arr):
-    if not arr:
-        return {}
-    arr_sorted = sorted(arr)
-    n = len(arr_sorted)
-    mean = sum(arr_sorted) / n
-    median = arr_sorted[n // 2] if n % 2 else (arr_sorted[n//2 - 1] + arr_sorted[n//2]) / 2
-    var = sum((x - mean) ** 2 for x in arr_sorted) / n
-    return {
-        "mean": mean,
-        "median": median,
-        "min": arr_sorted[0],
-        "max": arr_sorted[-1],
-        "stdev": math.sqrt(var),
-    }
+  MATRIX_CALLS="$MATRIX_CALLS" DATA_PATH="$MATRIX_DATA_PATH" \
+  python3 - "$BUILD_DIR/matrix.json" "$BUILD_DIR/matrix_collapsed.json" <<'PY'
+import json, os, sys, time
+
+rows = []
+for path in sys.argv[1:]:
+    with open(path, encoding="utf-8") as f:
+        rows.extend(json.load(f)["rows"])
+
+calls = {}
+for pair in os.environ.get("MATRIX_CALLS", "").split():
+    name, _, counts = pair.partition("=")
+    base, _, opt = counts.partition(",")
+    calls[name] = {"native": int(base or 0), "collapsed": int(opt or 0)}
 
 data = {
     "timestamp": time.strftime("%Y-%m-%d %H:%M:%S %Z"),
-    "config": {
-        "iters": int(os.environ.get("ITERS", "0")),
-        "runs": int(os.environ.get("RUNS", "0")),
-        "warmup": int(os.environ.get("WARMUP", "0")),
-    },
-    "ir_call_count": {
-        "baseline": int(os.environ.get("BASE_CALLS", "0") or 0),
-        "optimized": int(os.environ.get("OPT_CALLS", "0") or 0),
-    },
+    "forms": ["native", "collapsed", "interp", "compiled"],
+    "kernels": list(dict.fromkeys(r["kernel"] for r in rows)),
+    "rows": rows,
+    "ir_call_count": calls,
 }
+with open(os.environ["DATA_PATH"], "w", encoding="utf-8") as f:
+    f.write("window.BENCH_MATRIX = ")
+    json.dump(data, f, indent=2)
+    f.write(";\n")
+PY
+  echo "benchmark matrix written to $MATRIX_DATA_PATH"
+fi
 
-base_times = parse_csv(os.environ.get("BASE_TIMES_CSV", ""))
-opt_times = parse_csv(os.environ.get("OPT_TIMES_CSV", ""))
-base_nspi = parse_csv(os.environ.get("BASE_NSPI_CSV", ""))
-opt_nspi = parse_csv(os.environ.get("OPT_NSPI_CSV", ""))
-speedups = parse_csv(os.environ.get("SPEEDUPS_CSV", ""))
-
-data["baseline"] = {
-    "times_ns": base_times,
-    "ns_per_iter": base_nspi,
-    "stats_time_ns": stats(base_times),
-    "stats_ns_per_iter": stats(base_nspi),
-}
-data["optimized"] = {
-    "times_ns": opt_times,
-    "ns_per_iter": opt_nspi,
-    "stats_time_ns": stats(opt_times),
-    "stats_ns_per_iter": stats(opt_nspi),
-}
-data["speedup"] = {
-    "values": speedups,
-    "stats": stats(speedups),
-}
+# C kernels against the same paths as ck_path.hpp templates (checked equal
+# first, then timed).
+if [ "$RUN_PATHS" -ne 0 ]; then
+  "$BUILD_DIR/bench_paths" $HARNESS_FLAGS --json "$OUT_DIR/bench_paths.json"
+fi
 
-out_path = os.environ.get("DATA_PATH")
-data_var = os.environ.get("DATA_VAR", "BENCH_DATA")
-if out_path:
-    os.makedirs(os.path.dirname(out_path), exist_ok=True)
-    with open(out_path, "w", encoding="utf-8") as f:
-        f.write(f"window.{data_var} = ")
-        json.dump(data, f, indent=2)
-        f.write(";\n")
+# Page size comparison: dependent chain-chasing over a PAGES_OBJS-object heap
+# (384 MB by default) backed by each page kind, against 4K pages. Hugetlb kinds
+# need pages reserved in /proc/sys/vm/nr_hugepages and are skipped otherwise.
+if [ "$RUN_PAGES" -ne 0 ]; then
+  PAGES_JSON=""
+  for kind in $PAGES_KINDS; do
+    if "$BUILD_DIR/bench_throughput" $HARNESS_FLAGS --mode latency --objs "$PAGES_OBJS" \
+        --pages "$kind" --strict_pages --prefault --json "$BUILD_DIR/pages_$kind.json" >/dev/null; then
+      PAGES_JSON="$PAGES_JSON $BUILD_DIR/pages_$kind.json"
+    else
+      echo "[pages] $kind unavailable, skipped"
+    fi
+  done
+  # shellcheck disable=SC2086
+  python3 - "$OUT_DIR/bench_pages.json" $PAGES_JSON <<'PY'
+import json, sys
+
+rows = []
+for path in sys.argv[2:]:
+    with open(path, encoding="utf-8") as f:
+        data = json.load(f)
+    row = data["rows"][0]
+    rows.append({"pages": data["pages"], "ns_per_eval": row["ns_per_eval"],
+                 "derefs_per_sec": row["derefs_per_sec"]})
+base = next((r["ns_per_eval"] for r in rows if r["pages"] == "4k"), None)
+for r in rows:
+    r["speedup_vs_4k"] = base / r["ns_per_eval"] if base else None
+    spd = f"{r['speedup_vs_4k']:.2f}x" if base else "n/a"
+    print(f"[pages] {r['pages']:<4} {r['ns_per_eval']:9.2f} ns/eval  {spd} vs 4k")
+with open(sys.argv[1], "w", encoding="utf-8") as f:
+    json.dump({"rows": rows}, f, indent=2)
+    f.write("\n")
 PY
-}
+fi
 
-run_variant "base" "$BASE_BIN" "$BUILD_DIR/bench_triple_deref_opt" "$DATA_PATH" "BENCH_DATA" "$BASE_CALLS" "$OPT_CALLS"
-if [ "$RUN_SSA" -ne 0 ]; then
-  run_variant "ssa" "$SSA_BIN" "$SSA_OPT_BIN" "$SSA_DATA_PATH" "BENCH_DATA_SSA" "$SSA_BASE_CALLS" "$SSA_OPT_CALLS"
+# Append this run to the local history and check it against earlier runs;
+# a flagged regression is reported but does not fail the benchmark run.
+if [ "$RECORD_HISTORY" -ne 0 ]; then
+  python3 "$ROOT/benchmarks/bench_history.py" record --cc "$CLANG_BIN"
+  python3 "$ROOT/benchmarks/bench_history.py" compare || echo "performance regression flagged against benchmarks/history"
+  python3 "$ROOT/benchmarks/bench_history.py" export
 fi
 
 BASE_LINE=$(grep -n "call .*@triple_deref" "$BUILD_DIR/bench.ll" | head -n 1 | cut -d: -f1 || true)
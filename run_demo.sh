@@ -16,16 +16,33 @@ cmake --build "$BUILD_LLVM_DIR" --config Release
 cmake -S "$ROOT" -B "$BUILD_DIR"
 cmake --build "$BUILD_DIR" --config Release
 
-"$CLANG_BIN" -S -emit-llvm -O0 -g -fno-discard-value-names -fno-inline -Xclang -disable-O0-optnone \
-  -I "$ROOT/runtime" -I "$ROOT/programs" \
-  "$ROOT/programs/kernels.c" -o "$BUILD_DIR/kernels.ll"
-
-PASS_LIB="$BUILD_LLVM_DIR/libGuardedGraphPass.so"
-if [ ! -f "$PASS_LIB" ]; then
-  PASS_LIB="$BUILD_LLVM_DIR/libGuardedGraphPass.dylib"
+# only re-emit kernels.ll when its sources changed; extract_graphs.sh skips
+# it (and, inside, every unchanged kernel) the same way
+KERNEL_SRCS=("$ROOT/programs/kernels.c" "$ROOT/programs/kernels.h" "$ROOT/runtime/checked_ptr.h")
+if [ ! -f "$BUILD_DIR/kernels.ll" ] || [ -n "$(find "${KERNEL_SRCS[@]}" -newer "$BUILD_DIR/kernels.ll")" ]; then
+  "$CLANG_BIN" -S -emit-llvm -O2 -fno-discard-value-names \
+    -I "$ROOT/runtime" -I "$ROOT/programs" \
+    "$ROOT/programs/kernels.c" -o "$BUILD_DIR/kernels.ll"
 fi
 
-GRAPH_OUT_DIR="$OUT_DIR" "$OPT_BIN" -load-pass-plugin "$PASS_LIB" \
-  -passes="guarded-graph" -disable-output "$BUILD_DIR/kernels.ll"
+OUT_DIR="$OUT_DIR" BUILD_LLVM_DIR="$BUILD_LLVM_DIR" OPT="$OPT_BIN" \
+  bash "$ROOT/extract_graphs.sh" "$BUILD_DIR/kernels.ll"
 
 "$BUILD_DIR/driver" --trials 200 --seed 1234 --graph_dir "$OUT_DIR" --out_dir "$OUT_DIR"
+
+# Lower every graph back into its kernel (inline checks, one error exit) and
+# check the lowered kernels against the same graphs. Their .checked copies
+# call ck_* from the driver, which exports them.
+LOWER_LIB="$BUILD_LLVM_DIR/libLowerGuardedGraphPass.so"
+SHARED_FLAGS="-shared -fPIC"
+if [ ! -f "$LOWER_LIB" ]; then
+  LOWER_LIB="$BUILD_LLVM_DIR/libLowerGuardedGraphPass.dylib"
+  SHARED_FLAGS="$SHARED_FLAGS -undefined dynamic_lookup"
+fi
+GRAPH_OUT_DIR="$OUT_DIR" "$OPT_BIN" -load-pass-plugin "$LOWER_LIB" \
+  -passes="lower-guarded-graph,function(instcombine,simplifycfg)" \
+  -S "$BUILD_DIR/kernels.ll" -o "$BUILD_DIR/kernels_lowered.ll"
+"$CLANG_BIN" -O2 $SHARED_FLAGS "$BUILD_DIR/kernels_lowered.ll" -o "$BUILD_DIR/libkernels_lowered.so"
+mkdir -p "$OUT_DIR/lowered"
+"$BUILD_DIR/driver" --trials 200 --seed 1234 --graph_dir "$OUT_DIR" --out_dir "$OUT_DIR/lowered" \
+  --kernel_lib "$BUILD_DIR/libkernels_lowered.so"
@@ -1,4 +1,27 @@
 #include "checked_ptr.h"
+#include "heap_compact.h"
+
+#include <stddef.h>
+
+/* LowerGuardedGraphPass (llvm_pass/LowerGuardedGraphPass.cpp) reads Heap
+   through its own heapTy {i32, Obj*, i32, i32, intptr, i8*} and picks the
+   compact field by kHeapCompactIndex. This is that layout; the build stops
+   here if Heap drifts from it, so update the pass along with the struct. */
+typedef struct {
+    int num_objs;
+    Obj* objs;
+    int pages;
+    int locked;
+    size_t map_bytes;
+    const void* compact;
+} LoweredHeapPrefix;
+
+#define CK_LAYOUT_CHECK(name, cond) typedef char ck_layout_##name[(cond) ? 1 : -1]
+CK_LAYOUT_CHECK(pages_is_i32, sizeof(HeapPages) == sizeof(int));
+CK_LAYOUT_CHECK(num_objs, offsetof(Heap, num_objs) == offsetof(LoweredHeapPrefix, num_objs));
+CK_LAYOUT_CHECK(objs, offsetof(Heap, objs) == offsetof(LoweredHeapPrefix, objs));
+CK_LAYOUT_CHECK(compact, offsetof(Heap, compact) == offsetof(LoweredHeapPrefix, compact));
+CK_LAYOUT_CHECK(obj, sizeof(Obj) == 2 * MAX_FIELDS * sizeof(int));
 
 static Eval eval_ok(int tagged) {
     Eval e;
@@ -75,6 +98,10 @@ Eval ck_add(Eval a, Eval b) {
     return eval_ok(VAL_INT(VAL_INT_VALUE(a.value) + VAL_INT_VALUE(b.value)));
 }
 
+int ck_truthy(Eval cond) {
+    return cond.ok && VAL_IS_INT(cond.value) && VAL_INT_VALUE(cond.value) != 0;
+}
+
 static Eval load_field(Heap* heap, Eval ptr, int field, int require_int) {
     Obj* obj;
     int value;
@@ -89,12 +116,31 @@ static Eval load_field(Heap* heap, Eval ptr, int field, int require_int) {
         return eval_err(ERR_NULL);
     }
 
-    obj = heap_get_obj(heap, VAL_PTR_ADDR(ptr.value));
-    if (!obj) {
-        return eval_err(ERR_INVALID);
-    }
-    if (!heap_get_field(obj, field, &value)) {
-        return eval_err(ERR_MISSING_FIELD);
+    if (heap && heap->trusted) {
+        /* heap_trust vouched for the address. The field check stays: it
+           folds away where load_field inlines with a constant field
+           (ck_load_ptr, ck_load_int) */
+        const Obj* o = &heap->objs[VAL_PTR_ADDR(ptr.value) - 1];
+        if ((unsigned)field >= MAX_FIELDS || !o->has_field[field]) {
+            return eval_err(ERR_MISSING_FIELD);
+        }
+        value = o->value[field];
+    } else if (heap && heap->compact) {
+        int found = compact_heap_get_field(heap->compact, VAL_PTR_ADDR(ptr.value), field, &value);
+        if (found < 0) {
+            return eval_err(ERR_INVALID);
+        }
+        if (!found) {
+            return eval_err(ERR_MISSING_FIELD);
+        }
+    } else {
+        obj = heap_get_obj(heap, VAL_PTR_ADDR(ptr.value));
+        if (!obj) {
+            return eval_err(ERR_INVALID);
+        }
+        if (!heap_get_field(obj, field, &value)) {
+            return eval_err(ERR_MISSING_FIELD);
+        }
     }
     if (require_int && !VAL_IS_INT(value)) {
         return eval_err(ERR_TYPE);
@@ -116,4 +162,31 @@ Eval ck_getfield(Heap* heap, Eval ptr, int field) {
 
 Eval ck_getfield_int(Heap* heap, Eval ptr, int field) {
     return load_field(heap, ptr, field, 1);
+}
+
+Eval ck_load_chain(Heap* heap, Eval ptr, int field, int n) {
+    Eval e = ptr;
+    int k;
+    if (ptr.ok && heap && heap->objs && heap->num_objs > 0 && field >= 0 && field < MAX_FIELDS) {
+        const Obj* objs = heap->objs;
+        unsigned num = (unsigned)heap->num_objs;
+        int v = ptr.value;
+        int bad = 0;
+        for (k = 0; k < n; ++k) {
+            unsigned idx = (unsigned)VAL_PTR_ADDR(v) - 1u;
+            unsigned in = idx < num;
+            const Obj* obj;
+            bad |= (v & 1) | (v == VAL_NULL) | (int)!in;
+            obj = &objs[idx & (0u - in)];
+            bad |= !obj->has_field[field];
+            v = obj->value[field];
+        }
+        if (!bad) {
+            return eval_ok(v);
+        }
+    }
+    for (k = 0; k < n; ++k) {
+        e = load_field(heap, e, field, 0);
+    }
+    return e;
 }
\ No newline at end of file
@@ -24,6 +24,15 @@ typedef struct {
 #define VAL_INT_VALUE(v) ((v) >> 1)
 #define VAL_PTR_ADDR(v) ((v) >> 1)
 
+/* Marks a function for the guarded-graph pass (llvm_pass/GuardedGraphPass.cpp),
+   which extracts a graph for every marked kernel and lists it in the manifest
+   the driver runs from. Only clang records the annotation. */
+#if defined(__clang__)
+#define CK_KERNEL __attribute__((annotate("guarded_kernel")))
+#else
+#define CK_KERNEL
+#endif
+
 Eval ck_input(const char* name, int tagged);
 Eval ck_const_int(int value);
 Eval ck_const_null(void);
@@ -32,11 +41,23 @@ Eval ck_guard_nonnull(Eval v);
 Eval ck_guard_eq(Eval a, Eval b);
 Eval ck_select(Eval cond, Eval then_v, Eval else_v);
 Eval ck_add(Eval a, Eval b);
+/* For branching in C: 1 when cond is ok and a nonzero int, 0 otherwise
+   (errors included). The pass turns each test into a "truthy" node and the
+   branches it guards into selects. */
+int ck_truthy(Eval cond);
 
+/* On a heap with heap->trusted set (heap_stats.h: heap_trust) the loads
+   index objs without the address range check; null, type and missing-field
+   errors are unchanged. */
 Eval ck_load_ptr(Heap* heap, Eval ptr); /* field 0 */
 Eval ck_load_int(Heap* heap, Eval ptr);
 Eval ck_getfield(Heap* heap, Eval ptr, int field);
 Eval ck_getfield_int(Heap* heap, Eval ptr, int field);
+/* n ck_getfield(heap, ., field) in a row, with the same result. On a plain
+   heap it first follows the chain with no per-step branches (out-of-range
+   addresses are clamped to object 1 and every check is or-ed into one flag)
+   and redoes the chain checked only when that flag is set, to get the error. */
+Eval ck_load_chain(Heap* heap, Eval ptr, int field, int n);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,146 @@
+#ifndef CK_PATH_HPP
+#define CK_PATH_HPP
+
+#include "checked_ptr.h"
+#include "heap_compact.h"
+
+/* Field paths known at compile time, for C++ callers of the C runtime.
+
+     ck::Path<FIELD_F, FIELD_G>::load(heap, p)   ck_getfield F, then G
+     ck::Deref<3>::load(heap, p)                 three ck_load_ptr
+     ck::Chain<FIELD_G, 5>::load(heap, p)        five ck_getfield G
+
+   Each step is the checked load of ck_getfield with its field a template
+   argument, inlined into the caller: same results and the same first error
+   as the C calls, on plain and compact heaps alike, but with no call and no
+   field range check per step. load_int() also requires the last value to be
+   an int, like ck_getfield_int. ck::kernel<P> has the KernelFn signature,
+   so a path can stand in for a hand-written kernel. */
+
+namespace ck {
+
+namespace detail {
+
+inline Eval ok(int tagged) {
+    Eval e;
+    e.ok = 1;
+    e.err = OK;
+    e.value = tagged;
+    return e;
+}
+
+inline Eval err(Err code) {
+    Eval e;
+    e.ok = 0;
+    e.err = code;
+    e.value = 0;
+    return e;
+}
+
+template <int Field, bool RequireInt>
+inline Eval load(const Heap* heap, Eval ptr) {
+    static_assert(Field >= 0 && Field < MAX_FIELDS, "field out of range");
+    int value;
+    if (!ptr.ok) {
+        return ptr;
+    }
+    if (VAL_IS_INT(ptr.value)) {
+        return err(ERR_TYPE);
+    }
+    if (ptr.value == VAL_NULL) {
+        return err(ERR_NULL);
+    }
+    if (heap && heap->compact) {
+        int found = compact_heap_get_field(heap->compact, VAL_PTR_ADDR(ptr.value), Field, &value);
+        if (found < 0) {
+            return err(ERR_INVALID);
+        }
+        if (!found) {
+            return err(ERR_MISSING_FIELD);
+        }
+    } else {
+        /* one unsigned compare covers addr <= 0 and addr > num_objs */
+        unsigned idx = (unsigned)VAL_PTR_ADDR(ptr.value) - 1u;
+        const Obj* obj;
+        if (!heap || idx >= (unsigned)heap->num_objs) {
+            return err(ERR_INVALID);
+        }
+        obj = &heap->objs[idx];
+        if (!obj->has_field[Field]) {
+            return err(ERR_MISSING_FIELD);
+        }
+        value = obj->value[Field];
+    }
+    if (RequireInt && !VAL_IS_INT(value)) {
+        return err(ERR_TYPE);
+    }
+    return ok(value);
+}
+
+} // namespace detail
+
+template <int... Fields>
+struct Path;
+
+/* The empty path: load and load_int both return ptr as it is (load_int
+   checks the int on the last real step). */
+template <>
+struct Path<> {
+    static Eval load(const Heap* heap, Eval ptr) {
+        (void)heap;
+        return ptr;
+    }
+    static Eval load_int(const Heap* heap, Eval ptr) {
+        (void)heap;
+        return ptr;
+    }
+};
+
+template <int Field, int... Rest>
+struct Path<Field, Rest...> {
+    static Eval load(const Heap* heap, Eval ptr) {
+        return Path<Rest...>::load(heap, detail::load<Field, false>(heap, ptr));
+    }
+    static Eval load_int(const Heap* heap, Eval ptr) {
+        return Path<Rest...>::load_int(heap, detail::load<Field, sizeof...(Rest) == 0>(heap, ptr));
+    }
+};
+
+/* N loads of one field. */
+template <int Field, int N>
+struct Chain {
+    static_assert(N >= 0, "negative chain length");
+    static Eval load(const Heap* heap, Eval ptr) {
+        return Chain<Field, N - 1>::load(heap, detail::load<Field, false>(heap, ptr));
+    }
+    static Eval load_int(const Heap* heap, Eval ptr) {
+        return Chain<Field, N - 1>::load_int(heap, detail::load<Field, N == 1>(heap, ptr));
+    }
+};
+
+template <int Field>
+struct Chain<Field, 0> {
+    static Eval load(const Heap* heap, Eval ptr) {
+        (void)heap;
+        return ptr;
+    }
+    static Eval load_int(const Heap* heap, Eval ptr) {
+        (void)heap;
+        return ptr;
+    }
+};
+
+template <int N>
+using Deref = Chain<FIELD_DEREF, N>;
+
+/* P::load from input p, as a kernel: kernel<Deref<3>> computes what
+   triple_deref does. q is unused. */
+template <class P>
+Eval kernel(Heap* heap, int p, int q) {
+    (void)q;
+    return P::load(heap, detail::ok(p)); /* ck_input, inlined */
+}
+
+} // namespace ck
+
+#endif
\ No newline at end of file
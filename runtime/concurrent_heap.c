@@ -0,0 +1,320 @@
+#include "concurrent_heap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+#define RETIRE_BATCH 64
+
+enum { OBJ_FREE = 0, OBJ_LIVE, OBJ_RETIRED };
+
+/* 0 while the thread is outside a read section, else (epoch << 1) | 1 */
+typedef struct {
+    unsigned long long word;
+    char pad[CACHE_LINE - sizeof(unsigned long long)];
+} EpochSlot;
+
+typedef struct {
+    int addr;
+    unsigned long long epoch;
+} Retired;
+
+struct ConcHeap {
+    Heap heap;
+    unsigned char* state;
+    int* next_free; /* intrusive free stack, indexed by addr - 1 */
+    int free_top;   /* addr, 0 when empty */
+    Retired* retired;
+    int num_retired;
+    int cap_retired;
+    int lock;
+    int num_threads;
+    unsigned long long epoch;
+    ConcHeapStats stats;
+    EpochSlot slots[CONC_HEAP_MAX_THREADS];
+};
+
+static Eval eval_ok(int tagged) {
+    Eval e;
+    e.ok = 1;
+    e.err = OK;
+    e.value = tagged;
+    return e;
+}
+
+static Eval eval_err(Err err) {
+    Eval e;
+    e.ok = 0;
+    e.err = err;
+    e.value = 0;
+    return e;
+}
+
+static void lock(ConcHeap* ch) {
+    while (__atomic_exchange_n(&ch->lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&ch->lock, __ATOMIC_RELAXED)) {
+        }
+    }
+}
+
+static void unlock(ConcHeap* ch) {
+    __atomic_store_n(&ch->lock, 0, __ATOMIC_RELEASE);
+}
+
+static int live_obj(const ConcHeap* ch, int addr) {
+    return addr > 0 && addr <= ch->heap.num_objs && ch->state[addr - 1] == OBJ_LIVE;
+}
+
+ConcHeap* conc_heap_create(int capacity) {
+    ConcHeap* ch;
+    int i;
+    if (capacity < 1) {
+        return NULL;
+    }
+    ch = (ConcHeap*)calloc(1, sizeof(ConcHeap));
+    if (!ch) {
+        return NULL;
+    }
+    ch->heap.num_objs = capacity;
+    ch->heap.objs = (Obj*)calloc((size_t)capacity, sizeof(Obj));
+    ch->state = (unsigned char*)calloc((size_t)capacity, 1);
+    ch->next_free = (int*)malloc((size_t)capacity * sizeof(int));
+    ch->cap_retired = RETIRE_BATCH * 4;
+    ch->retired = (Retired*)malloc((size_t)ch->cap_retired * sizeof(Retired));
+    if (!ch->heap.objs || !ch->state || !ch->next_free || !ch->retired) {
+        conc_heap_free(ch);
+        return NULL;
+    }
+    /* hand out low addresses first */
+    for (i = 0; i < capacity; ++i) {
+        ch->next_free[i] = i + 2 <= capacity ? i + 2 : 0;
+    }
+    ch->free_top = 1;
+    ch->epoch = 1;
+    return ch;
+}
+
+void conc_heap_free(ConcHeap* ch) {
+    if (!ch) {
+        return;
+    }
+    free(ch->heap.objs);
+    free(ch->state);
+    free(ch->next_free);
+    free(ch->retired);
+    free(ch);
+}
+
+Heap* conc_heap_view(ConcHeap* ch) {
+    return ch ? &ch->heap : NULL;
+}
+
+/* Move the epoch forward if every reader inside a read section has seen
+   the current one. Called with the lock held. */
+static int try_advance(ConcHeap* ch) {
+    unsigned long long e = __atomic_load_n(&ch->epoch, __ATOMIC_RELAXED);
+    int n = __atomic_load_n(&ch->num_threads, __ATOMIC_ACQUIRE);
+    int t;
+    for (t = 0; t < n; ++t) {
+        unsigned long long w = __atomic_load_n(&ch->slots[t].word, __ATOMIC_SEQ_CST);
+        if ((w & 1) && (w >> 1) != e) {
+            return 0;
+        }
+    }
+    __atomic_store_n(&ch->epoch, e + 1, __ATOMIC_SEQ_CST);
+    ch->stats.epoch = e + 1;
+    return 1;
+}
+
+/* An object retired in epoch e may still be reachable by readers that
+   entered in e - 1 or e; once the epoch is e + 2 none of them remain.
+   Called with the lock held. */
+static int reclaim_locked(ConcHeap* ch) {
+    unsigned long long e = __atomic_load_n(&ch->epoch, __ATOMIC_RELAXED);
+    int kept = 0;
+    int done = 0;
+    int i;
+    for (i = 0; i < ch->num_retired; ++i) {
+        Retired r = ch->retired[i];
+        if (r.epoch + 2 <= e) {
+            Obj* obj = &ch->heap.objs[r.addr - 1];
+            int f;
+            for (f = 0; f < MAX_FIELDS; ++f) {
+                __atomic_store_n(&obj->has_field[f], 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&obj->value[f], 0, __ATOMIC_RELAXED);
+            }
+            ch->state[r.addr - 1] = OBJ_FREE;
+            ch->next_free[r.addr - 1] = ch->free_top;
+            ch->free_top = r.addr;
+            done++;
+        } else {
+            ch->retired[kept++] = r;
+        }
+    }
+    ch->num_retired = kept;
+    ch->stats.reclaimed += (unsigned long long)done;
+    ch->stats.pending = kept;
+    return done;
+}
+
+int conc_heap_reclaim(ConcHeap* ch) {
+    int done;
+    if (!ch) {
+        return 0;
+    }
+    lock(ch);
+    try_advance(ch);
+    done = reclaim_locked(ch);
+    unlock(ch);
+    return done;
+}
+
+int conc_heap_alloc(ConcHeap* ch) {
+    int addr;
+    int tries;
+    if (!ch) {
+        return 0;
+    }
+    lock(ch);
+    /* two advances are enough for everything retired before this call,
+       unless a reader is still inside an old read section */
+    for (tries = 0; !ch->free_top && ch->num_retired > 0 && tries < 2; ++tries) {
+        try_advance(ch);
+        reclaim_locked(ch);
+    }
+    addr = ch->free_top;
+    if (addr) {
+        ch->free_top = ch->next_free[addr - 1];
+        ch->state[addr - 1] = OBJ_LIVE;
+        ch->stats.allocs++;
+        ch->stats.live++;
+    }
+    unlock(ch);
+    return addr;
+}
+
+int conc_heap_release(ConcHeap* ch, int addr) {
+    if (!ch) {
+        return 0;
+    }
+    lock(ch);
+    if (!live_obj(ch, addr)) {
+        unlock(ch);
+        return 0;
+    }
+    if (ch->num_retired == ch->cap_retired) {
+        Retired* grown = (Retired*)realloc(ch->retired, (size_t)ch->cap_retired * 2 * sizeof(Retired));
+        if (!grown) {
+            unlock(ch);
+            return 0;
+        }
+        ch->retired = grown;
+        ch->cap_retired *= 2;
+    }
+    ch->state[addr - 1] = OBJ_RETIRED;
+    ch->retired[ch->num_retired].addr = addr;
+    ch->retired[ch->num_retired].epoch = __atomic_load_n(&ch->epoch, __ATOMIC_RELAXED);
+    ch->num_retired++;
+    ch->stats.frees++;
+    ch->stats.live--;
+    ch->stats.pending = ch->num_retired;
+    if (ch->num_retired % RETIRE_BATCH == 0) {
+        try_advance(ch);
+        reclaim_locked(ch);
+    }
+    unlock(ch);
+    return 1;
+}
+
+/* The value is published before has_field, so a reader that sees the flag
+   also sees the value. */
+int conc_heap_set_field(ConcHeap* ch, int addr, int field, int tagged) {
+    Obj* obj;
+    if (!ch || field < 0 || field >= MAX_FIELDS || !live_obj(ch, addr)) {
+        return 0;
+    }
+    obj = &ch->heap.objs[addr - 1];
+    __atomic_store_n(&obj->value[field], tagged, __ATOMIC_RELEASE);
+    __atomic_store_n(&obj->has_field[field], 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int conc_heap_clear_field(ConcHeap* ch, int addr, int field) {
+    if (!ch || field < 0 || field >= MAX_FIELDS || !live_obj(ch, addr)) {
+        return 0;
+    }
+    __atomic_store_n(&ch->heap.objs[addr - 1].has_field[field], 0, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void conc_heap_stats(ConcHeap* ch, ConcHeapStats* out) {
+    if (!ch || !out) {
+        return;
+    }
+    lock(ch);
+    *out = ch->stats;
+    out->epoch = __atomic_load_n(&ch->epoch, __ATOMIC_RELAXED);
+    unlock(ch);
+}
+
+int conc_heap_register(ConcHeap* ch) {
+    int tid;
+    if (!ch) {
+        return -1;
+    }
+    tid = __atomic_fetch_add(&ch->num_threads, 1, __ATOMIC_ACQ_REL);
+    if (tid >= CONC_HEAP_MAX_THREADS) {
+        __atomic_fetch_sub(&ch->num_threads, 1, __ATOMIC_ACQ_REL);
+        return -1;
+    }
+    return tid;
+}
+
+/* Announce the epoch, then re-check it: if a writer advanced in between it
+   may not have seen the announcement, so announce the newer one. */
+void conc_heap_enter(ConcHeap* ch, int tid) {
+    EpochSlot* slot = &ch->slots[tid];
+    unsigned long long e = __atomic_load_n(&ch->epoch, __ATOMIC_SEQ_CST);
+    for (;;) {
+        unsigned long long now;
+        __atomic_store_n(&slot->word, (e << 1) | 1, __ATOMIC_SEQ_CST);
+        now = __atomic_load_n(&ch->epoch, __ATOMIC_SEQ_CST);
+        if (now == e) {
+            return;
+        }
+        e = now;
+    }
+}
+
+void conc_heap_exit(ConcHeap* ch, int tid) {
+    __atomic_store_n(&ch->slots[tid].word, 0, __ATOMIC_RELEASE);
+}
+
+Eval conc_heap_getfield(ConcHeap* ch, Eval ptr, int field) {
+    Obj* obj;
+    int addr;
+    if (!ptr.ok) {
+        return ptr;
+    }
+    if (VAL_IS_INT(ptr.value)) {
+        return eval_err(ERR_TYPE);
+    }
+    if (ptr.value == VAL_NULL) {
+        return eval_err(ERR_NULL);
+    }
+    addr = VAL_PTR_ADDR(ptr.value);
+    if (!ch || addr <= 0 || addr > ch->heap.num_objs) {
+        return eval_err(ERR_INVALID);
+    }
+    if (field < 0 || field >= MAX_FIELDS) {
+        return eval_err(ERR_MISSING_FIELD);
+    }
+    obj = &ch->heap.objs[addr - 1];
+    if (!__atomic_load_n(&obj->has_field[field], __ATOMIC_ACQUIRE)) {
+        return eval_err(ERR_MISSING_FIELD);
+    }
+    return eval_ok(__atomic_load_n(&obj->value[field], __ATOMIC_ACQUIRE));
+}
+
+Eval conc_heap_load_ptr(ConcHeap* ch, Eval ptr) {
+    return conc_heap_getfield(ch, ptr, FIELD_DEREF);
+}
\ No newline at end of file
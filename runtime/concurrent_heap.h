@@ -0,0 +1,64 @@
+#ifndef CONCURRENT_HEAP_H
+#define CONCURRENT_HEAP_H
+
+#include "checked_ptr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A fixed-capacity heap that writers mutate while readers walk it.
+
+   The object array never moves, so conc_heap_view() is an ordinary Heap
+   that the ck_* loads and the kernels can read. Writers store fields
+   atomically and allocate/free through a small lock; a freed object is
+   only retired, and its slot is cleared and reused after every reader
+   that might still hold a pointer to it has left its read section
+   (epoch-based reclamation). Reads take no lock and never wait.
+
+   Readers register once per thread, then bracket each walk:
+       conc_heap_enter(ch, tid); ... conc_heap_load_ptr(ch, ...) ...; conc_heap_exit(ch, tid);
+   conc_heap_load_ptr/conc_heap_getfield are the ck_* loads with acquire
+   ordering and the same errors. The plain ck_* loads and kernels on the
+   view race with the writers' stores, so they are only safe while no
+   writer runs. */
+typedef struct ConcHeap ConcHeap;
+
+#define CONC_HEAP_MAX_THREADS 64
+
+typedef struct {
+    unsigned long long allocs;
+    unsigned long long frees;     /* retired */
+    unsigned long long reclaimed; /* cleared and back on the free list */
+    unsigned long long epoch;
+    int live;
+    int pending; /* retired, waiting for a grace period */
+} ConcHeapStats;
+
+/* All `capacity` objects start free; addresses are 1..capacity as in Heap. */
+ConcHeap* conc_heap_create(int capacity);
+void conc_heap_free(ConcHeap* ch);
+Heap* conc_heap_view(ConcHeap* ch);
+
+/* Writers. alloc returns 0 when the heap is full; free returns 0 if addr
+   is not live. */
+int conc_heap_alloc(ConcHeap* ch);
+int conc_heap_release(ConcHeap* ch, int addr);
+int conc_heap_set_field(ConcHeap* ch, int addr, int field, int tagged);
+int conc_heap_clear_field(ConcHeap* ch, int addr, int field);
+/* Try to advance the epoch and reclaim; returns the number reclaimed. */
+int conc_heap_reclaim(ConcHeap* ch);
+void conc_heap_stats(ConcHeap* ch, ConcHeapStats* out);
+
+/* Readers. register returns a slot id, or -1 when all slots are taken. */
+int conc_heap_register(ConcHeap* ch);
+void conc_heap_enter(ConcHeap* ch, int tid);
+void conc_heap_exit(ConcHeap* ch, int tid);
+Eval conc_heap_load_ptr(ConcHeap* ch, Eval ptr);
+Eval conc_heap_getfield(ConcHeap* ch, Eval ptr, int field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
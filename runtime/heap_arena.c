@@ -0,0 +1,179 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include "heap_arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#define ARENA_MMAP 1
+#endif
+
+struct HeapArena {
+    Heap heap;         /* num_objs is the bump pointer */
+    int max_objs;
+    int free_top;      /* addr, 0 when empty; next link lives in value[0] */
+    char* base;
+    size_t reserved;
+    size_t committed;
+    void* mapping;     /* what to unmap, including alignment slack */
+    size_t mapping_len;
+};
+
+static size_t round_up(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+#ifdef ARENA_MMAP
+/* Reserve without committing: PROT_NONE pages cost no memory until
+   commit_to makes them writable. Over-reserve by a slab to align. */
+static int reserve(HeapArena* arena, size_t bytes) {
+    size_t len = bytes + HEAP_ARENA_SLAB_BYTES;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void* p;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    p = mmap(NULL, len, PROT_NONE, flags, -1, 0);
+    if (p == MAP_FAILED) {
+        return 0;
+    }
+    arena->mapping = p;
+    arena->mapping_len = len;
+    arena->base = (char*)round_up((size_t)(uintptr_t)p, HEAP_ARENA_SLAB_BYTES);
+    arena->reserved = bytes;
+    return 1;
+}
+
+static int commit_to(HeapArena* arena, size_t bytes) {
+    size_t target = round_up(bytes, HEAP_ARENA_SLAB_BYTES);
+    char* start;
+    if (target > arena->reserved) {
+        target = arena->reserved;
+    }
+    if (target <= arena->committed) {
+        return 1;
+    }
+    start = arena->base + arena->committed;
+    if (mprotect(start, target - arena->committed, PROT_READ | PROT_WRITE) != 0) {
+        return 0;
+    }
+#ifdef MADV_HUGEPAGE
+    /* a hint only; slabs are 2 MB aligned so THP can back them */
+    madvise(start, target - arena->committed, MADV_HUGEPAGE);
+#endif
+    arena->committed = target;
+    return 1;
+}
+
+static void unreserve(HeapArena* arena) {
+    munmap(arena->mapping, arena->mapping_len);
+}
+#else
+static int reserve(HeapArena* arena, size_t bytes) {
+    arena->mapping = calloc(1, bytes);
+    arena->mapping_len = bytes;
+    arena->base = (char*)arena->mapping;
+    arena->reserved = bytes;
+    arena->committed = bytes;
+    return arena->mapping != NULL;
+}
+
+static int commit_to(HeapArena* arena, size_t bytes) {
+    return bytes <= arena->committed;
+}
+
+static void unreserve(HeapArena* arena) {
+    free(arena->mapping);
+}
+#endif
+
+HeapArena* heap_arena_create(int max_objs) {
+    HeapArena* arena;
+    if (max_objs < 1) {
+        return NULL;
+    }
+    arena = (HeapArena*)calloc(1, sizeof(HeapArena));
+    if (!arena) {
+        return NULL;
+    }
+    if (!reserve(arena, round_up((size_t)max_objs * sizeof(Obj), HEAP_ARENA_SLAB_BYTES))) {
+        free(arena);
+        return NULL;
+    }
+    arena->max_objs = max_objs;
+    arena->heap.objs = (Obj*)arena->base;
+    arena->heap.num_objs = 0;
+    return arena;
+}
+
+void heap_arena_destroy(HeapArena* arena) {
+    if (!arena) {
+        return;
+    }
+    unreserve(arena);
+    free(arena);
+}
+
+Heap* heap_arena_heap(HeapArena* arena) {
+    return arena ? &arena->heap : NULL;
+}
+
+int heap_arena_alloc_n(HeapArena* arena, int n) {
+    size_t end;
+    int first;
+    if (!arena || n < 1 || n > arena->max_objs - arena->heap.num_objs) {
+        return 0;
+    }
+    first = arena->heap.num_objs + 1;
+    end = (size_t)(arena->heap.num_objs + n) * sizeof(Obj);
+    if (end > arena->committed && !commit_to(arena, end)) {
+        return 0;
+    }
+    /* reset leaves old contents behind */
+    memset(&arena->heap.objs[first - 1], 0, (size_t)n * sizeof(Obj));
+    arena->heap.num_objs += n;
+    return first;
+}
+
+int heap_arena_alloc(HeapArena* arena) {
+    int addr;
+    if (!arena) {
+        return 0;
+    }
+    addr = arena->free_top;
+    if (!addr) {
+        return heap_arena_alloc_n(arena, 1);
+    }
+    arena->free_top = arena->heap.objs[addr - 1].value[0];
+    memset(&arena->heap.objs[addr - 1], 0, sizeof(Obj));
+    return addr;
+}
+
+int heap_arena_release(HeapArena* arena, int addr) {
+    Obj* obj;
+    if (!arena || !(obj = heap_get_obj(&arena->heap, addr))) {
+        return 0;
+    }
+    memset(obj, 0, sizeof(Obj));
+    obj->value[0] = arena->free_top;
+    arena->free_top = addr;
+    return 1;
+}
+
+void heap_arena_reset(HeapArena* arena) {
+    if (!arena) {
+        return;
+    }
+    arena->heap.num_objs = 0;
+    arena->free_top = 0;
+}
+
+size_t heap_arena_reserved_bytes(const HeapArena* arena) {
+    return arena ? arena->reserved : 0;
+}
+
+size_t heap_arena_committed_bytes(const HeapArena* arena) {
+    return arena ? arena->committed : 0;
+}
\ No newline at end of file
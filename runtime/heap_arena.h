@@ -0,0 +1,45 @@
+#ifndef HEAP_ARENA_H
+#define HEAP_ARENA_H
+
+#include "heap_gen.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A Heap whose objects are carved from one reserved address range.
+
+   The range for max_objs objects is reserved up front (2 MB aligned) and
+   committed in 2 MB slabs as the heap grows, so objs never moves and
+   addresses stay valid across growth. Allocation is a bump of num_objs
+   (or a pop from the free list); heap_arena_reset drops everything in
+   O(1) and keeps the slabs committed for the next build. Objects are
+   zeroed when handed out, not when reset. heap_arena_heap() is an ordinary
+   Heap for the ck_* loads and kernels; don't heap_free it. */
+typedef struct HeapArena HeapArena;
+
+#define HEAP_ARENA_SLAB_BYTES ((size_t)2 << 20)
+
+HeapArena* heap_arena_create(int max_objs);
+void heap_arena_destroy(HeapArena* arena);
+Heap* heap_arena_heap(HeapArena* arena);
+
+/* Returns the new object's address, or 0 when the arena is full. */
+int heap_arena_alloc(HeapArena* arena);
+/* n contiguous objects from the bump pointer (never the free list);
+   returns the first address, or 0. */
+int heap_arena_alloc_n(HeapArena* arena, int n);
+/* Put a live addr on the free list (once); it reads as an object with no
+   fields until it is handed out again. */
+int heap_arena_release(HeapArena* arena, int addr);
+void heap_arena_reset(HeapArena* arena);
+
+size_t heap_arena_reserved_bytes(const HeapArena* arena);
+size_t heap_arena_committed_bytes(const HeapArena* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
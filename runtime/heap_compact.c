@@ -0,0 +1,205 @@
+#include "heap_compact.h"
+#include "checked_ptr.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define TAG_SPECIAL 0
+#define TAG_INT 1
+#define TAG_PTR 2
+#define CODE_ABSENT 0
+#define CODE_NULL 4
+#define CODE_ESCAPE 8
+#define PAYLOAD_MIN (-8192)
+#define PAYLOAD_MAX 8191
+
+typedef struct {
+    uint32_t key; /* (addr * MAX_FIELDS + field) + 1, 0 = empty slot */
+    int value;
+} Escape;
+
+struct CompactHeap {
+    Heap view;
+    uint16_t* words; /* num_objs * MAX_FIELDS */
+    Escape* escapes;
+    int escape_cap;  /* power of two */
+    int num_escapes;
+};
+
+static uint16_t pack(int tag, int payload) {
+    return (uint16_t)(((unsigned)payload << 2) | (unsigned)tag);
+}
+
+/* arithmetic shift of the 16-bit word back to the signed payload */
+static int payload_of(uint16_t w) {
+    return (int)(int16_t)w >> 2;
+}
+
+static uint32_t escape_key(int addr, int field) {
+    return (uint32_t)addr * MAX_FIELDS + (uint32_t)field + 1u;
+}
+
+static int escape_slot(const CompactHeap* ch, uint32_t key) {
+    uint32_t mask = (uint32_t)ch->escape_cap - 1u;
+    uint32_t i = (key * 2654435761u) & mask;
+    while (ch->escapes[i].key && ch->escapes[i].key != key) {
+        i = (i + 1u) & mask;
+    }
+    return (int)i;
+}
+
+/* Encode one tagged value found at (addr, field); 0 means "escape". */
+static uint16_t encode_value(int addr, int v) {
+    if (v == VAL_NULL) {
+        return CODE_NULL;
+    }
+    if (VAL_IS_INT(v)) {
+        int x = VAL_INT_VALUE(v);
+        return x >= PAYLOAD_MIN && x <= PAYLOAD_MAX ? pack(TAG_INT, x) : 0;
+    } else {
+        long d = (long)VAL_PTR_ADDR(v) - addr;
+        return d >= PAYLOAD_MIN && d <= PAYLOAD_MAX ? pack(TAG_PTR, (int)d) : 0;
+    }
+}
+
+static int count_escapes(const Heap* heap) {
+    int n = 0;
+    int i;
+    int f;
+    for (i = 0; i < heap->num_objs; ++i) {
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            if (heap->objs[i].has_field[f] && !encode_value(i + 1, heap->objs[i].value[f])) {
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+CompactHeap* compact_heap_encode(const Heap* heap) {
+    CompactHeap* ch;
+    int escapes;
+    int i;
+    int f;
+
+    if (!heap || !heap->objs) {
+        return NULL;
+    }
+    ch = (CompactHeap*)calloc(1, sizeof(CompactHeap));
+    if (!ch) {
+        return NULL;
+    }
+    escapes = count_escapes(heap);
+    /* load factor <= 1/2 */
+    ch->escape_cap = 16;
+    while (ch->escape_cap < escapes * 2) {
+        ch->escape_cap *= 2;
+    }
+    ch->words = (uint16_t*)calloc((size_t)(heap->num_objs > 0 ? heap->num_objs : 1) * MAX_FIELDS, sizeof(uint16_t));
+    ch->escapes = (Escape*)calloc((size_t)ch->escape_cap, sizeof(Escape));
+    if (!ch->words || !ch->escapes) {
+        compact_heap_free(ch);
+        return NULL;
+    }
+
+    for (i = 0; i < heap->num_objs; ++i) {
+        const Obj* obj = &heap->objs[i];
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            uint16_t w;
+            if (!obj->has_field[f]) {
+                continue;
+            }
+            w = encode_value(i + 1, obj->value[f]);
+            if (!w) {
+                uint32_t key = escape_key(i + 1, f);
+                int slot = escape_slot(ch, key);
+                ch->escapes[slot].key = key;
+                ch->escapes[slot].value = obj->value[f];
+                ch->num_escapes++;
+                w = CODE_ESCAPE;
+            }
+            ch->words[(size_t)i * MAX_FIELDS + (size_t)f] = w;
+        }
+    }
+
+    ch->view.num_objs = heap->num_objs;
+    ch->view.objs = NULL;
+    ch->view.compact = ch;
+    return ch;
+}
+
+void compact_heap_free(CompactHeap* ch) {
+    if (!ch) {
+        return;
+    }
+    free(ch->words);
+    free(ch->escapes);
+    free(ch);
+}
+
+Heap* compact_heap_view(CompactHeap* ch) {
+    return ch ? &ch->view : NULL;
+}
+
+int compact_heap_get_field(const CompactHeap* ch, int addr, int field, int* out) {
+    uint16_t w;
+    if (addr <= 0 || addr > ch->view.num_objs) {
+        return -1;
+    }
+    if (field < 0 || field >= MAX_FIELDS) {
+        return 0;
+    }
+    w = ch->words[(size_t)(addr - 1) * MAX_FIELDS + (size_t)field];
+    switch (w & 3u) {
+        case TAG_INT:
+            *out = VAL_INT(payload_of(w));
+            return 1;
+        case TAG_PTR:
+            *out = VAL_PTR(addr + payload_of(w));
+            return 1;
+        default:
+            break;
+    }
+    if (w == CODE_NULL) {
+        *out = VAL_NULL;
+        return 1;
+    }
+    if (w == CODE_ESCAPE) {
+        *out = ch->escapes[escape_slot(ch, escape_key(addr, field))].value;
+        return 1;
+    }
+    return 0;
+}
+
+Heap* compact_heap_decode(const CompactHeap* ch) {
+    Heap* heap;
+    int i;
+    int f;
+    if (!ch) {
+        return NULL;
+    }
+    heap = heap_create(ch->view.num_objs);
+    if (!heap) {
+        return NULL;
+    }
+    for (i = 0; i < heap->num_objs; ++i) {
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            int v;
+            if (compact_heap_get_field(ch, i + 1, f, &v) == 1) {
+                heap->objs[i].has_field[f] = 1;
+                heap->objs[i].value[f] = v;
+            }
+        }
+    }
+    return heap;
+}
+
+int compact_heap_num_escapes(const CompactHeap* ch) {
+    return ch ? ch->num_escapes : 0;
+}
+
+size_t compact_heap_bytes(const CompactHeap* ch) {
+    if (!ch) {
+        return 0;
+    }
+    return (size_t)ch->view.num_objs * MAX_FIELDS * sizeof(uint16_t) + (size_t)ch->escape_cap * sizeof(Escape);
+}
\ No newline at end of file
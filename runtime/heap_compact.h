@@ -0,0 +1,41 @@
+#ifndef HEAP_COMPACT_H
+#define HEAP_COMPACT_H
+
+#include "heap_gen.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A read-only heap with 16-bit fields (6 bytes per object instead of 24).
+
+   Each field word holds a 2-bit tag and a signed 14-bit payload:
+     tag 1  small int, the payload is the int (-8192..8191)
+     tag 2  pointer, the payload is target - addr (so chains laid out by
+            heap_relayout encode as +1)
+     tag 0  0 absent, 4 null, 8 escaped: the full tagged value lives in a
+            hash side table keyed by (addr, field)
+   compact_heap_view() is a Heap whose ck_* loads decode on the fly, so the
+   kernels, graph_eval and heap_write_json work on it unchanged; code that
+   touches heap->objs directly (heap_get_obj, heap_clone) does not. */
+typedef struct CompactHeap CompactHeap;
+
+CompactHeap* compact_heap_encode(const Heap* heap);
+void compact_heap_free(CompactHeap* ch);
+Heap* compact_heap_view(CompactHeap* ch);
+/* Back to a plain heap; absent fields come back as value 0. */
+Heap* compact_heap_decode(const CompactHeap* ch);
+
+/* -1 for an address outside the heap, 0 for an absent field, 1 with the
+   tagged value in *out. */
+int compact_heap_get_field(const CompactHeap* ch, int addr, int field, int* out);
+
+int compact_heap_num_escapes(const CompactHeap* ch);
+size_t compact_heap_bytes(const CompactHeap* ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
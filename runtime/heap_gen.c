@@ -1,6 +1,16 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include "heap_gen.h"
 #include "checked_ptr.h"
+#include "heap_compact.h"
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#define HEAP_MMAP 1
+#endif
 
 void rng_seed(Rng* rng, unsigned seed) {
     rng->state = seed ? seed : 1u;
@@ -26,35 +36,156 @@ int rng_chance(Rng* rng, int percent) {
     return (int)(rng_next(rng) % 100u) < percent;
 }
 
-Heap* heap_create(int num_objs) {
+#ifdef HEAP_MMAP
+#define HUGE_2M ((size_t)2 << 20)
+#define HUGE_1G ((size_t)1 << 30)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+static size_t round_up(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+/* mmap'd object storage for the non-default page kinds; sets heap->pages
+   to what was obtained. */
+static Obj* map_objs(Heap* heap, size_t bytes, const HeapAllocOptions* opts) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    HeapPages pages = opts->pages;
+    void* p = MAP_FAILED;
+    size_t len = 0;
+
+#ifdef MAP_HUGETLB
+    if (pages == HEAP_PAGES_2M || pages == HEAP_PAGES_1G) {
+        size_t page = pages == HEAP_PAGES_1G ? HUGE_1G : HUGE_2M;
+        int shift = pages == HEAP_PAGES_1G ? 30 : 21;
+        len = round_up(bytes, page);
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+    }
+#endif
+    if (p == MAP_FAILED && (pages == HEAP_PAGES_2M || pages == HEAP_PAGES_1G)) {
+        if (!opts->fallback) {
+            return NULL;
+        }
+        pages = HEAP_PAGES_THP;
+    }
+    if (p == MAP_FAILED) {
+        /* THP wants 2 MB aligned extents; 4K maps are rounded the same way
+           so the two compare like for like */
+        len = round_up(bytes, HUGE_2M);
+        p = mmap(NULL, len + HUGE_2M, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED) {
+            return NULL;
+        }
+        {
+            char* base = (char*)p;
+            char* aligned = (char*)round_up((size_t)(uintptr_t)base, HUGE_2M);
+            if (aligned > base) {
+                munmap(base, (size_t)(aligned - base));
+            }
+            munmap(aligned + len, (size_t)(base + HUGE_2M - aligned));
+            p = aligned;
+        }
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        madvise(p, len, pages == HEAP_PAGES_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+    }
+    heap->pages = pages;
+    heap->map_bytes = len;
+    return (Obj*)p;
+}
+#endif
+
+void heap_alloc_options_default(HeapAllocOptions* opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->pages = HEAP_PAGES_DEFAULT;
+    opts->fallback = 1;
+}
+
+Heap* heap_create_ex(int num_objs, const HeapAllocOptions* opts) {
     Heap* heap = (Heap*)calloc(1, sizeof(Heap));
+    size_t bytes = (size_t)num_objs * sizeof(Obj);
     int i, f;
     if (!heap) {
         return NULL;
     }
     heap->num_objs = num_objs;
-    heap->objs = (Obj*)calloc((size_t)num_objs, sizeof(Obj));
+    heap->pages = HEAP_PAGES_DEFAULT;
+#ifdef HEAP_MMAP
+    if (opts && opts->pages != HEAP_PAGES_DEFAULT && num_objs > 0) {
+        /* anonymous mappings are already zero */
+        heap->objs = map_objs(heap, bytes, opts);
+        if (!heap->objs) {
+            free(heap);
+            return NULL;
+        }
+    }
+#endif
     if (!heap->objs) {
-        free(heap);
-        return NULL;
+        heap->objs = (Obj*)calloc((size_t)num_objs, sizeof(Obj));
+        if (!heap->objs) {
+            free(heap);
+            return NULL;
+        }
+        for (i = 0; i < num_objs; ++i) {
+            for (f = 0; f < MAX_FIELDS; ++f) {
+                heap->objs[i].has_field[f] = 0;
+                heap->objs[i].value[f] = 0;
+            }
+        }
     }
-    for (i = 0; i < num_objs; ++i) {
-        for (f = 0; f < MAX_FIELDS; ++f) {
-            heap->objs[i].has_field[f] = 0;
-            heap->objs[i].value[f] = 0;
+    if (opts && opts->prefault) {
+        /* one write per 4K page faults in the whole range */
+        volatile char* base = (volatile char*)heap->objs;
+        size_t len = heap->map_bytes ? heap->map_bytes : bytes;
+        size_t off;
+        for (off = 0; off < len; off += 4096) {
+            base[off] = base[off];
         }
     }
+#ifdef HEAP_MMAP
+    if (opts && opts->mlock && bytes > 0) {
+        heap->locked = mlock(heap->objs, heap->map_bytes ? heap->map_bytes : bytes) == 0;
+    }
+#endif
     return heap;
 }
 
+Heap* heap_create(int num_objs) {
+    return heap_create_ex(num_objs, NULL);
+}
+
 void heap_free(Heap* heap) {
     if (!heap) {
         return;
     }
+#ifdef HEAP_MMAP
+    if (heap->map_bytes) {
+        munmap(heap->objs, heap->map_bytes);
+        free(heap);
+        return;
+    }
+    if (heap->locked) {
+        munlock(heap->objs, (size_t)heap->num_objs * sizeof(Obj));
+    }
+#endif
     free(heap->objs);
     free(heap);
 }
 
+Heap* heap_clone(const Heap* heap) {
+    Heap* copy;
+    if (!heap) {
+        return NULL;
+    }
+    copy = heap_create(heap->num_objs);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy->objs, heap->objs, (size_t)heap->num_objs * sizeof(Obj));
+    return copy;
+}
+
 Obj* heap_get_obj(Heap* heap, int addr) {
     if (!heap || addr <= 0 || addr > heap->num_objs) {
         return NULL;
@@ -133,6 +264,190 @@ void env_randomize(Env* env, int num_objs, Rng* rng, int use_p, int use_q) {
     }
 }
 
+static const char* const shape_names[] = {
+    "uniform", "list", "tree", "dag", "cycle", "powerlaw"
+};
+
+void heap_gen_config_default(HeapGenConfig* cfg, HeapShape shape) {
+    if (!cfg) {
+        return;
+    }
+    cfg->shape = shape;
+    cfg->null_pct = 5;
+    cfg->int_pct = 10;
+    cfg->missing_pct = 0;
+    cfg->share_pct = 25;
+    cfg->fanout = 2;
+    cfg->int_max = 9;
+}
+
+int heap_shape_parse(const char* name, HeapShape* out) {
+    int i;
+    if (!name) {
+        return 0;
+    }
+    for (i = 0; i < (int)(sizeof(shape_names) / sizeof(shape_names[0])); ++i) {
+        if (strcmp(name, shape_names[i]) == 0) {
+            if (out) {
+                *out = (HeapShape)i;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* heap_shape_name(HeapShape shape) {
+    if ((int)shape < 0 || (int)shape >= (int)(sizeof(shape_names) / sizeof(shape_names[0]))) {
+        return "unknown";
+    }
+    return shape_names[shape];
+}
+
+static const char* const pages_names[] = {"default", "4k", "thp", "2m", "1g"};
+
+int heap_pages_parse(const char* name, HeapPages* out) {
+    int i;
+    if (!name) {
+        return 0;
+    }
+    for (i = 0; i < (int)(sizeof(pages_names) / sizeof(pages_names[0])); ++i) {
+        if (strcmp(name, pages_names[i]) == 0) {
+            if (out) {
+                *out = (HeapPages)i;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* heap_pages_name(HeapPages pages) {
+    if ((int)pages < 0 || (int)pages >= (int)(sizeof(pages_names) / sizeof(pages_names[0]))) {
+        return "unknown";
+    }
+    return pages_names[pages];
+}
+
+/* Pick the pointer target for field slot j of object addr (1-based).
+   Returns 0 when the shape has no target there (list tail, tree leaf). */
+static int shape_target(const HeapGenConfig* cfg, int n, int addr, int j, int num_fields,
+                        int* popular, int* num_popular, Rng* rng) {
+    int target = 0;
+    switch (cfg->shape) {
+        case HEAP_SHAPE_LIST:
+            target = addr < n ? addr + 1 : 0;
+            break;
+        case HEAP_SHAPE_TREE: {
+            int fanout = cfg->fanout > 0 ? cfg->fanout : 2;
+            int child = num_fields >= fanout ? j % fanout : rng_range(rng, 0, fanout - 1);
+            long first = (long)fanout * (addr - 1) + 2;
+            target = first + child <= n ? (int)(first + child) : 0;
+            break;
+        }
+        case HEAP_SHAPE_DAG:
+            if (addr >= n) {
+                target = 0;
+            } else if (*num_popular && popular[0] > addr && rng_chance(rng, cfg->share_pct)) {
+                target = popular[0];
+            } else {
+                target = rng_range(rng, addr + 1, n);
+                popular[0] = target;
+                *num_popular = 1;
+            }
+            break;
+        case HEAP_SHAPE_CYCLE:
+            if (rng_chance(rng, cfg->share_pct)) {
+                target = rng_range(rng, 1, addr);
+            } else {
+                target = addr < n ? addr + 1 : 1;
+            }
+            break;
+        case HEAP_SHAPE_POWERLAW:
+            /* sampling from the list of previous targets is proportional to in-degree */
+            if (*num_popular && rng_chance(rng, cfg->share_pct)) {
+                target = popular[rng_range(rng, 0, *num_popular - 1)];
+            } else {
+                target = rng_range(rng, 1, n);
+            }
+            popular[(*num_popular)++] = target;
+            break;
+        case HEAP_SHAPE_UNIFORM:
+        default:
+            target = rng_range(rng, 1, n);
+            break;
+    }
+    return target;
+}
+
+static int pct_valid(int pct) {
+    return pct >= 0 && pct <= 100;
+}
+
+int heap_gen_config_valid(const HeapGenConfig* cfg) {
+    return cfg && pct_valid(cfg->null_pct) && pct_valid(cfg->int_pct) && pct_valid(cfg->missing_pct) &&
+           pct_valid(cfg->share_pct) && cfg->null_pct + cfg->int_pct + cfg->missing_pct <= 100;
+}
+
+int heap_generate(Heap* heap, const int* fields, int num_fields, const HeapGenConfig* cfg, Rng* rng) {
+    int i, j;
+    int* popular;
+    int num_popular = 0;
+    int missing_cut, null_cut, int_cut;
+    if (!heap || !rng || heap->num_objs <= 0 || !heap_gen_config_valid(cfg)) {
+        return 0;
+    }
+    popular = (int*)malloc((size_t)heap->num_objs * (size_t)(num_fields > 0 ? num_fields : 1) * sizeof(int));
+    if (!popular) {
+        return 0;
+    }
+    missing_cut = cfg->missing_pct;
+    null_cut = missing_cut + cfg->null_pct;
+    int_cut = null_cut + cfg->int_pct;
+    for (i = 0; i < heap->num_objs; ++i) {
+        Obj* obj = &heap->objs[i];
+        for (j = 0; j < num_fields; ++j) {
+            int field = fields[j];
+            int roll = rng_range(rng, 0, 99);
+            int value;
+            if (roll < missing_cut) {
+                obj->has_field[field] = 0;
+                obj->value[field] = 0;
+                continue;
+            }
+            if (roll < null_cut) {
+                value = VAL_NULL;
+            } else if (roll < int_cut) {
+                value = VAL_INT(rng_range(rng, 0, cfg->int_max > 0 ? cfg->int_max : 0));
+            } else {
+                int target = shape_target(cfg, heap->num_objs, i + 1, j, num_fields,
+                                          popular, &num_popular, rng);
+                value = target ? VAL_PTR(target) : VAL_NULL;
+            }
+            obj->has_field[field] = 1;
+            obj->value[field] = value;
+        }
+    }
+    free(popular);
+    return 1;
+}
+
+Heap* heap_create_shaped(int num_objs, HeapShape shape, const int* fields, int num_fields, unsigned seed) {
+    HeapGenConfig cfg;
+    Rng rng;
+    Heap* heap = heap_create(num_objs);
+    if (!heap) {
+        return NULL;
+    }
+    heap_gen_config_default(&cfg, shape);
+    rng_seed(&rng, seed);
+    if (!heap_generate(heap, fields, num_fields, &cfg, &rng)) {
+        heap_free(heap);
+        return NULL;
+    }
+    return heap;
+}
+
 static void write_obj_json(const Obj* obj, FILE* f) {
     int field;
     int first = 1;
@@ -158,7 +473,17 @@ void heap_write_json(const Heap* heap, FILE* f) {
         if (i) {
             fprintf(f, ",");
         }
-        write_obj_json(&heap->objs[i], f);
+        if (heap->compact) {
+            /* decode into a scratch Obj so both forms print the same */
+            Obj obj;
+            int field;
+            for (field = 0; field < MAX_FIELDS; ++field) {
+                obj.has_field[field] = compact_heap_get_field(heap->compact, i + 1, field, &obj.value[field]) == 1;
+            }
+            write_obj_json(&obj, f);
+        } else {
+            write_obj_json(&heap->objs[i], f);
+        }
     }
     fprintf(f, "]}");
 }
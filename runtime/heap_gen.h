@@ -17,9 +17,30 @@ typedef struct {
     int value[MAX_FIELDS]; /* tagged values */
 } Obj;
 
+/* page backing for heap_create_ex */
+typedef enum {
+    HEAP_PAGES_DEFAULT = 0, /* calloc, whatever the allocator and THP policy give */
+    HEAP_PAGES_4K,          /* mmap with transparent huge pages disabled */
+    HEAP_PAGES_THP,         /* mmap, 2 MB aligned, MADV_HUGEPAGE */
+    HEAP_PAGES_2M,          /* MAP_HUGETLB 2 MB pages from the reserved pool */
+    HEAP_PAGES_1G           /* MAP_HUGETLB 1 GB pages from the reserved pool */
+} HeapPages;
+
+typedef struct {
+    HeapPages pages;
+    int prefault; /* touch every page before returning */
+    int mlock;    /* mlock the objects; failure leaves the heap unlocked */
+    int fallback; /* hugetlb unavailable: use HEAP_PAGES_THP instead of failing */
+} HeapAllocOptions;
+
 typedef struct {
     int num_objs;
     Obj* objs;
+    HeapPages pages;  /* backing actually obtained */
+    int locked;
+    size_t map_bytes; /* mmap length, 0 when objs came from calloc */
+    const struct CompactHeap* compact; /* compact_heap_view(): objs is NULL, fields decode from here */
+    int trusted; /* every pointer the ck_* loads will see is in range: they skip the address check (heap_trust) */
 } Heap;
 
 typedef struct {
@@ -31,19 +52,59 @@ typedef struct {
     unsigned state;
 } Rng;
 
+/* heap shape presets for heap_generate */
+typedef enum {
+    HEAP_SHAPE_UNIFORM = 0, /* pointer targets drawn uniformly from the heap */
+    HEAP_SHAPE_LIST,        /* i -> i+1, tail -> null */
+    HEAP_SHAPE_TREE,        /* i -> a child in a complete fanout-ary tree, leaves -> null */
+    HEAP_SHAPE_DAG,         /* i -> some j > i, with shared children */
+    HEAP_SHAPE_CYCLE,       /* ring i -> i+1, n -> 1, with back edges */
+    HEAP_SHAPE_POWERLAW     /* preferential attachment, power-law in-degree */
+} HeapShape;
+
+typedef struct {
+    HeapShape shape;
+    int null_pct;    /* percent of field slots holding null */
+    int int_pct;     /* percent of field slots holding an int */
+    int missing_pct; /* percent of field slots left absent */
+    int share_pct;   /* DAG/cycle/powerlaw: percent of links reusing a popular target */
+    int fanout;      /* tree: children per node */
+    int int_max;     /* ints are drawn from [0, int_max] */
+} HeapGenConfig;
+
 void rng_seed(Rng* rng, unsigned seed);
 unsigned rng_next(Rng* rng);
 int rng_range(Rng* rng, int lo, int hi);
 int rng_chance(Rng* rng, int percent);
 
 Heap* heap_create(int num_objs);
+/* opts may be NULL (same as heap_create). */
+Heap* heap_create_ex(int num_objs, const HeapAllocOptions* opts);
 void heap_free(Heap* heap);
+Heap* heap_clone(const Heap* heap);
 Obj* heap_get_obj(Heap* heap, int addr);
 int heap_get_field(const Obj* obj, int field, int* out_value);
 
 void heap_randomize(Heap* heap, const int* fields, int num_fields, Rng* rng);
 void env_randomize(Env* env, int num_objs, Rng* rng, int use_p, int use_q);
 
+void heap_gen_config_default(HeapGenConfig* cfg, HeapShape shape);
+int heap_shape_parse(const char* name, HeapShape* out);
+const char* heap_shape_name(HeapShape shape);
+void heap_alloc_options_default(HeapAllocOptions* opts);
+int heap_pages_parse(const char* name, HeapPages* out);
+const char* heap_pages_name(HeapPages pages);
+/* 1 when every percentage is in 0..100 and null + int + missing <= 100. */
+int heap_gen_config_valid(const HeapGenConfig* cfg);
+/* Fill the given fields of every object; the remaining percent of slots
+   (100 - null - int - missing) become pointers laid out by cfg->shape.
+   Returns 0, leaving the heap untouched, on an invalid cfg or allocation
+   failure. */
+int heap_generate(Heap* heap, const int* fields, int num_fields, const HeapGenConfig* cfg, Rng* rng);
+/* A num_objs-object heap generated with shape's default config from seed;
+   NULL on failure. */
+Heap* heap_create_shaped(int num_objs, HeapShape shape, const int* fields, int num_fields, unsigned seed);
+
 void heap_write_json(const Heap* heap, FILE* f);
 void env_write_json(const Env* env, FILE* f);
 
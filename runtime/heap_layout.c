@@ -0,0 +1,165 @@
+#include "heap_layout.h"
+#include "checked_ptr.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int all_fields[MAX_FIELDS] = {FIELD_DEREF, FIELD_F, FIELD_G};
+
+/* Pointer target of addr's field, or 0. */
+static int field_target(const Heap* heap, int addr, int field) {
+    const Obj* obj = &heap->objs[addr - 1];
+    int v;
+    if (field < 0 || field >= MAX_FIELDS || !obj->has_field[field]) {
+        return 0;
+    }
+    v = obj->value[field];
+    if (!VAL_IS_PTR(v) || (unsigned)VAL_PTR_ADDR(v) - 1u >= (unsigned)heap->num_objs) {
+        return 0;
+    }
+    return VAL_PTR_ADDR(v);
+}
+
+/* Number everything reachable from root that is still unnumbered.
+   work holds num_objs entries and serves as the DFS stack or BFS queue. */
+static int visit(const Heap* heap, int root, const int* fields, int num_fields, HeapOrder order,
+                 int* remap, int* work, int next) {
+    int head = 0;
+    int tail = 0;
+    int j;
+
+    if (remap[root]) {
+        return next;
+    }
+    if (order == HEAP_ORDER_BFS) {
+        remap[root] = next++;
+        work[tail++] = root;
+        while (head < tail) {
+            int addr = work[head++];
+            for (j = 0; j < num_fields; ++j) {
+                int t = field_target(heap, addr, fields[j]);
+                if (t && !remap[t]) {
+                    remap[t] = next++;
+                    work[tail++] = t;
+                }
+            }
+        }
+        return next;
+    }
+
+    /* DFS: number on pop, push fields in reverse so the first field is
+       taken next and a chain comes out contiguous. Each object is pushed
+       at most once (marked with -1), which bounds the stack. */
+    remap[root] = -1;
+    work[tail++] = root;
+    while (tail > 0) {
+        int addr = work[--tail];
+        remap[addr] = next++;
+        for (j = num_fields - 1; j >= 0; --j) {
+            int t = field_target(heap, addr, fields[j]);
+            if (t && !remap[t]) {
+                remap[t] = -1;
+                work[tail++] = t;
+            }
+        }
+    }
+    return next;
+}
+
+Heap* heap_relayout(const Heap* heap, const int* roots, int num_roots, const int* fields, int num_fields,
+                    HeapOrder order, int* remap) {
+    HeapAllocOptions opts;
+    Heap* out;
+    int* map;
+    int* work;
+    int next = 1;
+    int i;
+    int f;
+
+    if (!heap) {
+        return NULL;
+    }
+    if (!fields) {
+        fields = all_fields;
+        num_fields = MAX_FIELDS;
+    }
+    map = (int*)calloc((size_t)heap->num_objs + 1, sizeof(int));
+    work = (int*)malloc(((size_t)heap->num_objs + 1) * sizeof(int));
+    /* keep the page backing of the source */
+    heap_alloc_options_default(&opts);
+    opts.pages = heap->pages;
+    out = heap_create_ex(heap->num_objs, &opts);
+    if (!map || !work || !out) {
+        free(map);
+        free(work);
+        heap_free(out);
+        return NULL;
+    }
+
+    for (i = 0; i < num_roots; ++i) {
+        if (VAL_IS_PTR(roots[i]) && (unsigned)VAL_PTR_ADDR(roots[i]) - 1u < (unsigned)heap->num_objs) {
+            next = visit(heap, VAL_PTR_ADDR(roots[i]), fields, num_fields, order, map, work, next);
+        }
+    }
+    for (i = 1; i <= heap->num_objs; ++i) {
+        if (!map[i]) {
+            map[i] = next++;
+        }
+    }
+
+    for (i = 1; i <= heap->num_objs; ++i) {
+        const Obj* src = &heap->objs[i - 1];
+        Obj* dst = &out->objs[map[i] - 1];
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            dst->has_field[f] = src->has_field[f];
+            dst->value[f] = src->has_field[f] ? heap_remap_value(map, heap->num_objs, src->value[f]) : src->value[f];
+        }
+    }
+
+    if (remap) {
+        memcpy(remap, map, ((size_t)heap->num_objs + 1) * sizeof(int));
+    }
+    free(map);
+    free(work);
+    return out;
+}
+
+int heap_remap_value(const int* remap, int num_objs, int tagged) {
+    /* one unsigned compare leaves negative addresses alone too */
+    if (!remap || !VAL_IS_PTR(tagged) || (unsigned)VAL_PTR_ADDR(tagged) - 1u >= (unsigned)num_objs) {
+        return tagged;
+    }
+    return VAL_PTR(remap[VAL_PTR_ADDR(tagged)]);
+}
+
+void env_remap(Env* env, const int* remap, int num_objs) {
+    if (!env) {
+        return;
+    }
+    env->p = heap_remap_value(remap, num_objs, env->p);
+    env->q = heap_remap_value(remap, num_objs, env->q);
+}
+
+static const char* const order_names[] = {"dfs", "bfs"};
+
+int heap_order_parse(const char* name, HeapOrder* out) {
+    int i;
+    if (!name) {
+        return 0;
+    }
+    for (i = 0; i < (int)(sizeof(order_names) / sizeof(order_names[0])); ++i) {
+        if (strcmp(name, order_names[i]) == 0) {
+            if (out) {
+                *out = (HeapOrder)i;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char* heap_order_name(HeapOrder order) {
+    if ((int)order < 0 || (int)order >= (int)(sizeof(order_names) / sizeof(order_names[0]))) {
+        return "unknown";
+    }
+    return order_names[order];
+}
\ No newline at end of file
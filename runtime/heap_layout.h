@@ -0,0 +1,40 @@
+#ifndef HEAP_LAYOUT_H
+#define HEAP_LAYOUT_H
+
+#include "heap_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HEAP_ORDER_DFS = 0, /* each chain ends up contiguous, fields in order */
+    HEAP_ORDER_BFS      /* objects at the same depth end up together */
+} HeapOrder;
+
+/* Copy `heap` with objects renumbered in traversal order, so what a kernel
+   walks from the hot entry points sits in consecutive addresses.
+
+   roots are tagged values (ints and null are ignored), visited in the
+   given order, each traversal following `fields` (NULL: all fields) and
+   only claiming objects no earlier root reached. Unreachable objects keep
+   their relative order after the reachable ones. Every pointer field is
+   rewritten. remap, if not NULL, must hold num_objs + 1 entries and
+   receives old address -> new address (remap[0] = 0). Returns NULL on
+   allocation failure. */
+Heap* heap_relayout(const Heap* heap, const int* roots, int num_roots, const int* fields, int num_fields,
+                    HeapOrder order, int* remap);
+
+/* Translate a tagged value through a remap table; ints, null and
+   out-of-range pointers pass through unchanged. */
+int heap_remap_value(const int* remap, int num_objs, int tagged);
+void env_remap(Env* env, const int* remap, int num_objs);
+
+int heap_order_parse(const char* name, HeapOrder* out);
+const char* heap_order_name(HeapOrder order);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
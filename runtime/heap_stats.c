@@ -0,0 +1,457 @@
+#include "heap_stats.h"
+#include "heap_compact.h"
+#include "checked_ptr.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HEAP_STATS_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* below this many objects per thread, starting a thread costs more than it saves */
+#define MIN_OBJS_PER_THREAD (1 << 16)
+
+typedef struct {
+    const Heap* heap;
+    int lo; /* object indices [lo, hi) */
+    int hi;
+    int simd;
+    HeapFieldStats fields[MAX_FIELDS];
+} ScanJob;
+
+static void count_value(HeapFieldStats* fs, int v, unsigned num_objs) {
+    fs->present++;
+    if (v == VAL_NULL) {
+        fs->nulls++;
+    } else if (VAL_IS_INT(v)) {
+        fs->ints++;
+    } else if ((unsigned)VAL_PTR_ADDR(v) - 1u >= num_objs) {
+        fs->dangling++;
+    } else {
+        fs->ptrs++;
+    }
+}
+
+static void scan_scalar(const Obj* objs, int lo, int hi, unsigned num_objs, HeapFieldStats* out) {
+    int i;
+    int f;
+    for (i = lo; i < hi; ++i) {
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            if (objs[i].has_field[f]) {
+                count_value(&out[f], objs[i].value[f], num_objs);
+            }
+        }
+    }
+}
+
+static void scan_compact(const CompactHeap* ch, int lo, int hi, unsigned num_objs, HeapFieldStats* out) {
+    int i;
+    int f;
+    for (i = lo; i < hi; ++i) {
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            int v;
+            if (compact_heap_get_field(ch, i + 1, f, &v) == 1) {
+                count_value(&out[f], v, num_objs);
+            }
+        }
+    }
+}
+
+#ifdef HEAP_STATS_AVX2
+static int have_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static long long sum_lanes(__m256i v) __attribute__((target("avx2")));
+static long long sum_lanes(__m256i v) {
+    int lanes[8];
+    long long sum = 0;
+    int k;
+    _mm256_storeu_si256((__m256i*)lanes, v);
+    for (k = 0; k < 8; ++k) {
+        sum += (unsigned)lanes[k];
+    }
+    return sum;
+}
+
+/* Eight objects per step: one gather each for has_field[f] and value[f]
+   (Obj is 2 * MAX_FIELDS ints), classified with compares into lane
+   counters that subtract the -1 masks. ptrs is what remains of present. */
+static void scan_avx2(const Obj* objs, int lo, int hi, unsigned num_objs, HeapFieldStats* out)
+    __attribute__((target("avx2")));
+static void scan_avx2(const Obj* objs, int lo, int hi, unsigned num_objs, HeapFieldStats* out) {
+    /* lane k reads object i + k: k * sizeof(Obj) / sizeof(int) ints on */
+    const __m256i stride = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                              _mm256_set1_epi32((int)(sizeof(Obj) / sizeof(int))));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i bias = _mm256_set1_epi32(INT_MIN);
+    /* unsigned (addr - 1) >= num_objs as a signed compare on biased values */
+    const __m256i limit = _mm256_set1_epi32((int)((num_objs - 1u) ^ 0x80000000u));
+    __m256i present[MAX_FIELDS];
+    __m256i nulls[MAX_FIELDS];
+    __m256i ints[MAX_FIELDS];
+    __m256i dangling[MAX_FIELDS];
+    int i = lo;
+    int f;
+
+    for (f = 0; f < MAX_FIELDS; ++f) {
+        present[f] = nulls[f] = ints[f] = dangling[f] = zero;
+    }
+    for (; i + 8 <= hi; i += 8) {
+        const int* base = (const int*)(objs + i);
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            __m256i has = _mm256_i32gather_epi32(base + f, stride, 4);
+            __m256i v = _mm256_i32gather_epi32(base + MAX_FIELDS + f, stride, 4);
+            __m256i is_present = _mm256_xor_si256(_mm256_cmpeq_epi32(has, zero), _mm256_set1_epi32(-1));
+            __m256i is_null = _mm256_and_si256(is_present, _mm256_cmpeq_epi32(v, zero));
+            __m256i is_int = _mm256_and_si256(is_present, _mm256_cmpeq_epi32(_mm256_and_si256(v, one), one));
+            __m256i idx = _mm256_sub_epi32(_mm256_srai_epi32(v, 1), one);
+            __m256i out_of_range = _mm256_cmpgt_epi32(_mm256_xor_si256(idx, bias), limit);
+            __m256i is_dangling = _mm256_andnot_si256(_mm256_or_si256(is_null, is_int),
+                                                      _mm256_and_si256(is_present, out_of_range));
+            present[f] = _mm256_sub_epi32(present[f], is_present);
+            nulls[f] = _mm256_sub_epi32(nulls[f], is_null);
+            ints[f] = _mm256_sub_epi32(ints[f], is_int);
+            dangling[f] = _mm256_sub_epi32(dangling[f], is_dangling);
+        }
+    }
+    for (f = 0; f < MAX_FIELDS; ++f) {
+        long long p = sum_lanes(present[f]);
+        long long n = sum_lanes(nulls[f]);
+        long long k = sum_lanes(ints[f]);
+        long long d = sum_lanes(dangling[f]);
+        out[f].present += p;
+        out[f].nulls += n;
+        out[f].ints += k;
+        out[f].dangling += d;
+        out[f].ptrs += p - n - k - d;
+    }
+    scan_scalar(objs, i, hi, num_objs, out);
+}
+#endif
+
+static void* scan_main(void* arg) {
+    ScanJob* job = (ScanJob*)arg;
+    const Heap* heap = job->heap;
+    unsigned num_objs = (unsigned)heap->num_objs;
+    if (heap->compact) {
+        scan_compact(heap->compact, job->lo, job->hi, num_objs, job->fields);
+        return NULL;
+    }
+#ifdef HEAP_STATS_AVX2
+    if (job->simd) {
+        scan_avx2(heap->objs, job->lo, job->hi, num_objs, job->fields);
+        return NULL;
+    }
+#endif
+    scan_scalar(heap->objs, job->lo, job->hi, num_objs, job->fields);
+    return NULL;
+}
+
+static int pick_threads(int threads, int num_objs) {
+    int most = num_objs / MIN_OBJS_PER_THREAD;
+#ifdef _WIN32
+    (void)most;
+    (void)threads;
+    return 1;
+#else
+    if (threads <= 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+#else
+        threads = 1;
+#endif
+    }
+    if (threads > most) {
+        threads = most;
+    }
+    return threads < 1 ? 1 : threads;
+#endif
+}
+
+/* The field counts of heap_stats and heap_validate; 0 on allocation failure. */
+static int scan_fields(const Heap* heap, int threads, HeapStats* out) {
+    ScanJob* jobs;
+    int simd = 0;
+    int started = 0;
+    int t;
+    int f;
+#ifndef _WIN32
+    pthread_t* tids;
+#endif
+
+    memset(out, 0, sizeof(*out));
+    out->num_objs = heap->num_objs;
+    if (heap->num_objs <= 0 || (!heap->objs && !heap->compact)) {
+        out->threads = 1;
+        return 1;
+    }
+#ifdef HEAP_STATS_AVX2
+    simd = !heap->compact && sizeof(Obj) == 2 * MAX_FIELDS * sizeof(int) && have_avx2();
+#endif
+    threads = pick_threads(threads, heap->num_objs);
+    jobs = (ScanJob*)calloc((size_t)threads, sizeof(ScanJob));
+    if (!jobs) {
+        return 0;
+    }
+    for (t = 0; t < threads; ++t) {
+        jobs[t].heap = heap;
+        jobs[t].lo = (int)((long long)heap->num_objs * t / threads);
+        jobs[t].hi = (int)((long long)heap->num_objs * (t + 1) / threads);
+        jobs[t].simd = simd;
+    }
+#ifndef _WIN32
+    tids = (pthread_t*)calloc((size_t)threads, sizeof(pthread_t));
+    if (!tids) {
+        free(jobs);
+        return 0;
+    }
+    /* a slice whose thread fails to start is scanned on this one */
+    for (t = 1; t < threads; ++t) {
+        if (pthread_create(&tids[started], NULL, scan_main, &jobs[t]) == 0) {
+            started++;
+        } else {
+            scan_main(&jobs[t]);
+        }
+    }
+#endif
+    scan_main(&jobs[0]);
+#ifndef _WIN32
+    for (t = 0; t < started; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+    free(tids);
+#endif
+
+    for (t = 0; t < threads; ++t) {
+        for (f = 0; f < MAX_FIELDS; ++f) {
+            HeapFieldStats* acc = &out->fields[f];
+            const HeapFieldStats* s = &jobs[t].fields[f];
+            acc->present += s->present;
+            acc->nulls += s->nulls;
+            acc->ints += s->ints;
+            acc->ptrs += s->ptrs;
+            acc->dangling += s->dangling;
+        }
+    }
+    for (f = 0; f < MAX_FIELDS; ++f) {
+        out->dangling += out->fields[f].dangling;
+    }
+    out->threads = started + 1;
+    out->simd = simd;
+    free(jobs);
+    return 1;
+}
+
+/* Address `field` of `addr` points to, 0 when it is absent, not a
+   pointer or out of range. */
+static int field_target(const Heap* heap, int addr, int field) {
+    int v;
+    if (heap->compact) {
+        if (compact_heap_get_field(heap->compact, addr, field, &v) != 1) {
+            return 0;
+        }
+    } else {
+        const Obj* obj = &heap->objs[addr - 1];
+        if (!obj->has_field[field]) {
+            return 0;
+        }
+        v = obj->value[field];
+    }
+    if (!VAL_IS_PTR(v) || VAL_PTR_ADDR(v) < 1 || VAL_PTR_ADDR(v) > heap->num_objs) {
+        return 0;
+    }
+    return VAL_PTR_ADDR(v);
+}
+
+/* One field is a function from objects to objects: walk from every
+   unvisited object, stamping it with the start address, and a walk that
+   runs into its own stamp has found a new cycle. */
+static long long count_on_cycle(const Heap* heap, int field, int* stamp) {
+    long long on_cycle = 0;
+    int s;
+    memset(stamp, 0, ((size_t)heap->num_objs + 1) * sizeof(int));
+    for (s = 1; s <= heap->num_objs; ++s) {
+        int a = s;
+        while (a && !stamp[a]) {
+            stamp[a] = s;
+            a = field_target(heap, a, field);
+        }
+        if (a && stamp[a] == s) {
+            int b = a;
+            do {
+                on_cycle++;
+                b = field_target(heap, b, field);
+            } while (b != a);
+        }
+    }
+    return on_cycle;
+}
+
+#define MARK_WHITE 0
+#define MARK_GREY 1  /* on the DFS stack */
+#define MARK_ENDS 2  /* every path from here ends */
+#define MARK_LOOPS 3 /* some path from here reaches a cycle */
+#define CURSOR_LOOPS 0x80
+
+/* Iterative DFS over all pointer fields: an edge into a grey object closes
+   a cycle, and an object loops when any successor does. cursor holds the
+   next field to try, with CURSOR_LOOPS set once a successor looped. */
+static long long count_looping(const Heap* heap, int* stack, unsigned char* mark, unsigned char* cursor) {
+    long long looping = 0;
+    int r;
+    memset(mark, MARK_WHITE, (size_t)heap->num_objs + 1);
+    memset(cursor, 0, (size_t)heap->num_objs + 1);
+    for (r = 1; r <= heap->num_objs; ++r) {
+        int depth = 0;
+        if (mark[r] != MARK_WHITE) {
+            continue;
+        }
+        stack[depth++] = r;
+        mark[r] = MARK_GREY;
+        while (depth > 0) {
+            int a = stack[depth - 1];
+            int f = cursor[a] & ~CURSOR_LOOPS;
+            if (f < MAX_FIELDS) {
+                int t = field_target(heap, a, f);
+                cursor[a]++;
+                if (!t) {
+                    continue;
+                }
+                if (mark[t] == MARK_WHITE) {
+                    mark[t] = MARK_GREY;
+                    stack[depth++] = t;
+                } else if (mark[t] != MARK_ENDS) {
+                    cursor[a] |= CURSOR_LOOPS;
+                }
+                continue;
+            }
+            depth--;
+            if (cursor[a] & CURSOR_LOOPS) {
+                mark[a] = MARK_LOOPS;
+                looping++;
+                if (depth > 0) {
+                    cursor[stack[depth - 1]] |= CURSOR_LOOPS;
+                }
+            } else {
+                mark[a] = MARK_ENDS;
+            }
+        }
+    }
+    return looping;
+}
+
+int heap_stats(const Heap* heap, int threads, HeapStats* out) {
+    int* ints;
+    unsigned char* bytes;
+    int f;
+    if (!heap || !out || !scan_fields(heap, threads, out)) {
+        return 0;
+    }
+    if (heap->num_objs <= 0 || (!heap->objs && !heap->compact)) {
+        return 1;
+    }
+    ints = (int*)malloc(((size_t)heap->num_objs + 1) * sizeof(int));
+    bytes = (unsigned char*)malloc(((size_t)heap->num_objs + 1) * 2);
+    if (!ints || !bytes) {
+        free(ints);
+        free(bytes);
+        return 0;
+    }
+    for (f = 0; f < MAX_FIELDS; ++f) {
+        if (out->fields[f].ptrs) {
+            out->fields[f].on_cycle = count_on_cycle(heap, f, ints);
+        }
+    }
+    out->looping = count_looping(heap, ints, bytes, bytes + heap->num_objs + 1);
+    free(ints);
+    free(bytes);
+    return 1;
+}
+
+int heap_validate(const Heap* heap, int threads, HeapStats* stats) {
+    HeapStats local;
+    HeapStats* s = stats ? stats : &local;
+    if (!heap || !scan_fields(heap, threads, s)) {
+        return 0;
+    }
+    return s->dangling == 0;
+}
+
+int heap_trust(Heap* heap, int threads, const int* inputs, int num_inputs) {
+    HeapStats stats;
+    if (!heap) {
+        return 0;
+    }
+    heap->trusted = 0;
+    if (!heap->objs || heap->compact || !heap_validate(heap, threads, &stats)) {
+        return 0;
+    }
+    return heap_trust_stats(heap, &stats, inputs, num_inputs);
+}
+
+int heap_trust_stats(Heap* heap, const HeapStats* stats, const int* inputs, int num_inputs) {
+    int i;
+    if (!heap) {
+        return 0;
+    }
+    heap->trusted = 0;
+    if (!heap->objs || heap->compact || !stats || stats->num_objs != heap->num_objs || stats->dangling != 0) {
+        return 0;
+    }
+    for (i = 0; i < num_inputs; ++i) {
+        if (VAL_IS_PTR(inputs[i]) && (unsigned)VAL_PTR_ADDR(inputs[i]) - 1u >= (unsigned)heap->num_objs) {
+            return 0;
+        }
+    }
+    heap->trusted = 1;
+    return 1;
+}
+
+void heap_stats_add(HeapStats* acc, const HeapStats* s) {
+    int f;
+    acc->num_objs += s->num_objs;
+    for (f = 0; f < MAX_FIELDS; ++f) {
+        acc->fields[f].present += s->fields[f].present;
+        acc->fields[f].nulls += s->fields[f].nulls;
+        acc->fields[f].ints += s->fields[f].ints;
+        acc->fields[f].ptrs += s->fields[f].ptrs;
+        acc->fields[f].dangling += s->fields[f].dangling;
+        acc->fields[f].on_cycle += s->fields[f].on_cycle;
+    }
+    acc->dangling += s->dangling;
+    acc->looping += s->looping;
+    if (s->threads > acc->threads) {
+        acc->threads = s->threads;
+    }
+    acc->simd |= s->simd;
+}
+
+static double pct(long long part, long long whole) {
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+void heap_stats_write(const HeapStats* s, const int* fields, int num_fields, const char* indent, FILE* f) {
+    static const int all_fields[MAX_FIELDS] = {FIELD_DEREF, FIELD_F, FIELD_G};
+    int i;
+    if (!fields) {
+        fields = all_fields;
+        num_fields = MAX_FIELDS;
+    }
+    for (i = 0; i < num_fields; ++i) {
+        const HeapFieldStats* fs = &s->fields[fields[i]];
+        fprintf(f, "%sfield %d: present=%lld null=%.1f%% int=%.1f%% ptr=%.1f%% dangling=%lld on_cycle=%lld\n",
+                indent, fields[i], fs->present, pct(fs->nulls, fs->present), pct(fs->ints, fs->present),
+                pct(fs->ptrs, fs->present), fs->dangling, fs->on_cycle);
+    }
+    fprintf(f, "%sobjs=%lld dangling=%lld looping=%lld (%.1f%%) threads=%d simd=%s\n", indent, s->num_objs,
+            s->dangling, s->looping, pct(s->looping, s->num_objs), s->threads, s->simd ? "avx2" : "scalar");
+}
\ No newline at end of file
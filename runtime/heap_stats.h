@@ -0,0 +1,69 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include "heap_gen.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What one field holds across the heap. Every present field is exactly one
+   of null, int, ptr (address in 1..num_objs) or dangling (any other
+   address). */
+typedef struct {
+    long long present;
+    long long nulls;
+    long long ints;
+    long long ptrs;
+    long long dangling;
+    long long on_cycle; /* objects on a cycle of this field alone (heap_stats only) */
+} HeapFieldStats;
+
+typedef struct {
+    long long num_objs;
+    HeapFieldStats fields[MAX_FIELDS];
+    long long dangling; /* over all fields */
+    long long looping;  /* objects some path of pointer fields never leaves (heap_stats only) */
+    int threads;        /* threads the field scan ran on */
+    int simd;           /* 1 when the AVX2 scan ran */
+} HeapStats;
+
+/* Count every field of the heap, plain or compact. The scan runs 8 objects
+   at a time with AVX2 gathers when the CPU has them (scalar otherwise), and
+   large heaps are split across `threads` threads (<= 0: one per online CPU;
+   small heaps use fewer). heap_stats then walks the pointer graph once for
+   cycles, on the calling thread. Returns 0 on a NULL heap or allocation
+   failure. */
+int heap_stats(const Heap* heap, int threads, HeapStats* out);
+
+/* 1 when every pointer field is null or in range, i.e. no load from this
+   heap can fail with ERR_INVALID except through an input pointer. Only the
+   field scan runs; stats, if not NULL, receives its counts (cycle counts
+   left 0). */
+int heap_validate(const Heap* heap, int threads, HeapStats* stats);
+
+/* Set heap->trusted when heap_validate passes and every value in inputs
+   (tagged, e.g. the kernel's p and q) is null, an int or in range; clear it
+   otherwise. Returns the flag. A trusted heap may only be evaluated with
+   inputs like these, and whoever stores a pointer into it afterwards must
+   keep it in range or clear the flag: a ck_* load from an out-of-range
+   address reads outside objs instead of failing with ERR_INVALID. Compact
+   views are never trusted. Code that builds a heap with every pointer in
+   range may also set the flag itself. */
+int heap_trust(Heap* heap, int threads, const int* inputs, int num_inputs);
+/* heap_trust without the scan: stats is a heap_stats or heap_validate
+   result for the heap as it is now. */
+int heap_trust_stats(Heap* heap, const HeapStats* stats, const int* inputs, int num_inputs);
+
+/* acc += s, for totals over many heaps. */
+void heap_stats_add(HeapStats* acc, const HeapStats* s);
+/* One line per field in `fields` (NULL: all fields), with percentages of
+   the present fields, then the dangling and looping totals. */
+void heap_stats_write(const HeapStats* s, const int* fields, int num_fields, const char* indent, FILE* f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+const historyList = document.getElementById("history-list");
+const historyMeta = document.getElementById("history-meta");
+const historyRuns = document.getElementById("history-runs");
+const historyFlagged = document.getElementById("history-flagged");
+
+const CHART_W = 640;
+const CHART_H = 140;
+const PAD = 28;
+const SVG_NS = "http://www.w3.org/2000/svg";
+
+function svgEl(name, attrs) {
+  const el = document.createElementNS(SVG_NS, name);
+  Object.entries(attrs).forEach(([k, v]) => el.setAttribute(k, v));
+  return el;
+}
+
+function runLabel(run) {
+  if (!run) return "";
+  const commit = run.commit ? run.commit.slice(0, 8) : "no-git";
+  return `${run.timestamp || ""} ${commit}${run.dirty ? "+" : ""}`;
+}
+
+function renderSeries(name, points, data) {
+  const runs = data.runs || [];
+  const card = document.createElement("div");
+  card.className = "bench-card";
+  const title = document.createElement("span");
+  title.className = "bench-label";
+  title.textContent = name;
+  card.appendChild(title);
+
+  const last = points[points.length - 1];
+  const foot = document.createElement("span");
+  foot.className = "bench-foot";
+  const change = last?.change === null || last?.change === undefined ? "" : ` (${(last.change * 100).toFixed(2)}% vs window)`;
+  foot.textContent = `latest ${Number(last?.median ?? 0).toFixed(3)} ns/iter${change}`;
+
+  const lo = Math.min(...points.map((p) => p.median - (p.mad || 0)));
+  const hi = Math.max(...points.map((p) => p.median + (p.mad || 0)));
+  const span = hi - lo || 1;
+  const maxRun = Math.max(1, runs.length - 1);
+  const x = (run) => PAD + (run / maxRun) * (CHART_W - 2 * PAD);
+  const y = (v) => CHART_H - PAD - ((v - lo) / span) * (CHART_H - 2 * PAD);
+
+  const svg = svgEl("svg", { viewBox: `0 0 ${CHART_W} ${CHART_H}`, width: "100%", role: "img" });
+  const upper = points.map((p) => `${x(p.run)},${y(p.median + (p.mad || 0))}`);
+  const lower = points.map((p) => `${x(p.run)},${y(p.median - (p.mad || 0))}`).reverse();
+  svg.appendChild(svgEl("polygon", { points: upper.concat(lower).join(" "), fill: "rgba(214,162,58,0.18)" }));
+  svg.appendChild(svgEl("polyline", {
+    points: points.map((p) => `${x(p.run)},${y(p.median)}`).join(" "),
+    fill: "none",
+    stroke: "#d6a23a",
+    "stroke-width": "2",
+  }));
+  points.forEach((p) => {
+    const color = p.status === "regression" ? "#c0392b" : p.status === "improvement" ? "#2e8b57" : "#d6a23a";
+    const dot = svgEl("circle", { cx: x(p.run), cy: y(p.median), r: p.status === "ok" ? "2.5" : "4", fill: color });
+    const tip = svgEl("title", {});
+    tip.textContent = `${runLabel(runs[p.run])}\n${Number(p.median).toFixed(3)} ns/iter ± ${Number(p.mad || 0).toFixed(3)} • ${p.status}`;
+    dot.appendChild(tip);
+    svg.appendChild(dot);
+  });
+  const axis = svgEl("text", { x: PAD, y: CHART_H - 6, "font-size": "10", fill: "currentColor" });
+  axis.textContent = `${lo.toFixed(2)} – ${hi.toFixed(2)} ns/iter`;
+  svg.appendChild(axis);
+
+  card.appendChild(svg);
+  card.appendChild(foot);
+  return card;
+}
+
+function populateHistory() {
+  if (typeof window.BENCH_HISTORY === "undefined") {
+    return;
+  }
+  const data = window.BENCH_HISTORY;
+  const series = data.series || {};
+  const runs = data.runs || [];
+  let flagged = 0;
+
+  historyList.innerHTML = "";
+  Object.keys(series).sort().forEach((name) => {
+    const points = series[name];
+    if (!points.length) return;
+    flagged += points.filter((p) => p.status === "regression").length;
+    historyList.appendChild(renderSeries(name, points, data));
+  });
+
+  historyRuns.textContent = String(runs.length);
+  historyFlagged.textContent = String(flagged);
+  historyMeta.textContent = `threshold ${(data.threshold * 100).toFixed(1)}% • alpha ${data.alpha} • window ${data.window} • latest ${runLabel(runs[runs.length - 1])}`;
+}
+
+populateHistory();
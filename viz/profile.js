@@ -0,0 +1,147 @@
+const profileInput = document.getElementById("profile-input");
+const profileList = document.getElementById("profile-list");
+const profileEmpty = document.getElementById("profile-empty");
+
+const NODE_W = 150;
+const NODE_H = 58;
+const COL_GAP = 60;
+const ROW_GAP = 18;
+const PAD = 16;
+const SVG_NS = "http://www.w3.org/2000/svg";
+
+function layoutDepths(nodes, edges) {
+  const depth = new Map(nodes.map((n) => [n.id, 0]));
+  // node ids are emitted in topological order, so one pass settles the longest path
+  const sorted = [...edges].sort((a, b) => a[1] - b[1]);
+  sorted.forEach(([from, to]) => {
+    depth.set(to, Math.max(depth.get(to) || 0, (depth.get(from) || 0) + 1));
+  });
+  return depth;
+}
+
+function heat(share) {
+  const t = Math.min(1, Math.max(0, share));
+  const r = Math.round(255 - t * (255 - 214));
+  const g = Math.round(253 - t * (253 - 162));
+  const b = Math.round(248 - t * (248 - 58));
+  return `rgb(${r},${g},${b})`;
+}
+
+function svgEl(name, attrs) {
+  const el = document.createElementNS(SVG_NS, name);
+  Object.entries(attrs).forEach(([k, v]) => el.setAttribute(k, v));
+  return el;
+}
+
+function renderProfile(profile) {
+  const nodes = profile.nodes || [];
+  const edges = profile.edges || [];
+  const depth = layoutDepths(nodes, edges);
+  const totalCycles = nodes.reduce((sum, n) => sum + (n.self_cycles || 0), 0) || 1;
+  const evals = profile.evals || 0;
+
+  const columns = new Map();
+  nodes.forEach((n) => {
+    const d = depth.get(n.id) || 0;
+    if (!columns.has(d)) columns.set(d, []);
+    columns.get(d).push(n);
+  });
+  const pos = new Map();
+  let maxRows = 0;
+  columns.forEach((col, d) => {
+    maxRows = Math.max(maxRows, col.length);
+    col.forEach((n, row) => {
+      pos.set(n.id, {
+        x: PAD + d * (NODE_W + COL_GAP),
+        y: PAD + row * (NODE_H + ROW_GAP),
+      });
+    });
+  });
+
+  const width = PAD * 2 + columns.size * (NODE_W + COL_GAP) - COL_GAP;
+  const height = PAD * 2 + maxRows * (NODE_H + ROW_GAP) - ROW_GAP;
+  const svg = svgEl("svg", { width, height, viewBox: `0 0 ${width} ${height}` });
+
+  edges.forEach(([from, to]) => {
+    const a = pos.get(from);
+    const b = pos.get(to);
+    if (!a || !b) return;
+    svg.appendChild(svgEl("line", {
+      x1: a.x + NODE_W, y1: a.y + NODE_H / 2,
+      x2: b.x, y2: b.y + NODE_H / 2,
+      stroke: "#b9b1a3", "stroke-width": 1.5,
+    }));
+  });
+
+  nodes.forEach((n) => {
+    const p = pos.get(n.id);
+    const share = (n.self_cycles || 0) / totalCycles;
+    const errs = n.errors || {};
+    const origin = Object.entries(errs).filter(([, v]) => v > 0);
+    const g = svgEl("g", {});
+    g.appendChild(svgEl("rect", {
+      x: p.x, y: p.y, width: NODE_W, height: NODE_H, rx: 8,
+      fill: heat(share * 3), stroke: origin.length ? "#5a2020" : "#0f6f61", "stroke-width": 1.5,
+    }));
+    const label = n.name ? `${n.kind} ${n.name}` : (n.field !== undefined ? `${n.kind} f${n.field}` : n.kind);
+    const lines = [
+      `#${n.id} ${label}`,
+      `hits ${n.hits} • ${(share * 100).toFixed(1)}%`,
+      `${evals ? ((n.self_cycles || 0) / Math.max(1, n.hits)).toFixed(1) : "—"} ${profile.clock || "cyc"}/hit`,
+    ];
+    lines.forEach((text, i) => {
+      const t = svgEl("text", {
+        x: p.x + 8, y: p.y + 16 + i * 15,
+        "font-family": "JetBrains Mono, monospace", "font-size": 11, fill: "#1b1b1a",
+      });
+      t.textContent = text;
+      g.appendChild(t);
+    });
+    const title = svgEl("title", {});
+    title.textContent = origin.length
+      ? `error origins: ${origin.map(([k, v]) => `${k}=${v}`).join(", ")}`
+      : "no errors originate here";
+    g.appendChild(title);
+    if (origin.length) {
+      const badge = svgEl("text", {
+        x: p.x + NODE_W - 8, y: p.y + 14, "text-anchor": "end",
+        "font-family": "Space Grotesk, sans-serif", "font-size": 11, fill: "#5a2020",
+      });
+      badge.textContent = origin.map(([k, v]) => `${k}:${v}`).join(" ");
+      g.appendChild(badge);
+    }
+    svg.appendChild(g);
+  });
+
+  const card = document.createElement("article");
+  card.className = "bench-card";
+  const header = document.createElement("span");
+  header.className = "bench-label";
+  header.textContent = `${profile.function || "graph"} • ${evals} evals • output #${profile.output}`;
+  const wrap = document.createElement("div");
+  wrap.style.overflowX = "auto";
+  wrap.appendChild(svg);
+  card.appendChild(header);
+  card.appendChild(wrap);
+  profileList.appendChild(card);
+}
+
+profileInput.addEventListener("change", () => {
+  profileList.innerHTML = "";
+  const files = [...profileInput.files];
+  profileEmpty.hidden = files.length > 0;
+  files.forEach((file) => {
+    const reader = new FileReader();
+    reader.onload = () => {
+      try {
+        renderProfile(JSON.parse(reader.result));
+      } catch (err) {
+        const msg = document.createElement("p");
+        msg.className = "bench-sub";
+        msg.textContent = `${file.name}: ${err.message}`;
+        profileList.appendChild(msg);
+      }
+    };
+    reader.readAsText(file);
+  });
+});
@@ -151,6 +151,8 @@ const benchOptNspi = document.getElementById("bench-opt-nspi");
 const benchCallCount = document.getElementById("bench-call-count");
 const benchRows = document.getElementById("bench-rows");
 const benchSpark = document.getElementById("bench-spark");
+const matrixMeta = document.getElementById("matrix-meta");
+const matrixTable = document.getElementById("matrix-table");
 
 let currentLevel = levels[0].id;
 
@@ -310,7 +312,69 @@ function populateBench() {
     benchRows.appendChild(row);
   }
 
+  const basePerf = data.baseline?.perf || {};
+  const optPerf = data.optimized?.perf || {};
+  Object.keys(basePerf).forEach((key) => {
+    const row = document.createElement("div");
+    row.className = "bench-row";
+    const left = document.createElement("span");
+    left.textContent = key.replace(/_per_iter$/, "") + "/iter";
+    const right = document.createElement("span");
+    const base = basePerf[key]?.stats?.mean;
+    const opt = optPerf[key]?.stats?.mean;
+    const fmt = (v) => (v === undefined || v === null ? "—" : Number(v).toFixed(3));
+    right.textContent = `${fmt(base)} → ${fmt(opt)}`;
+    row.appendChild(left);
+    row.appendChild(right);
+    benchRows.appendChild(row);
+  });
+
   renderSparkline(speedups);
 }
 
+function populateMatrix() {
+  if (typeof window.BENCH_MATRIX === "undefined" || !matrixTable) {
+    return;
+  }
+  const data = window.BENCH_MATRIX;
+  const forms = data.forms || [];
+  const cells = {};
+  (data.rows || []).forEach((row) => {
+    cells[`${row.kernel}/${row.form}`] = row;
+  });
+
+  matrixMeta.textContent = `median ns/iter • ${data.timestamp || "latest"}`;
+  matrixTable.innerHTML = "";
+  const head = document.createElement("tr");
+  ["kernel", "heap", ...forms].forEach((label) => {
+    const th = document.createElement("th");
+    th.textContent = label;
+    head.appendChild(th);
+  });
+  matrixTable.appendChild(head);
+
+  (data.kernels || []).forEach((kernel) => {
+    const tr = document.createElement("tr");
+    const any = forms.map((f) => cells[`${kernel}/${f}`]).find((r) => r);
+    const heap = any?.heap;
+    [kernel, heap ? `${heap.shape}/${heap.objs}` : "—"].forEach((text) => {
+      const td = document.createElement("td");
+      td.textContent = text;
+      tr.appendChild(td);
+    });
+    forms.forEach((form) => {
+      const td = document.createElement("td");
+      const row = cells[`${kernel}/${form}`];
+      const median = row?.stats_ns_per_iter?.median;
+      td.textContent = median === undefined ? "—" : Number(median).toFixed(2);
+      if (row && row.outcome !== "ok") {
+        td.title = `outcome: ${row.outcome}`;
+      }
+      tr.appendChild(td);
+    });
+    matrixTable.appendChild(tr);
+  });
+}
+
 populateBench();
+populateMatrix();